@@ -1,5 +1,7 @@
 
 #include "6502.h"
+#include "6502_ops.h"
+#include "plugin.h"
 
 /*
  * An implementation of a 6502 cpu (i.e. that which is used in
@@ -47,19 +49,29 @@ void init_cpu_info(struct cpu_info *cpu, struct memory *mem){
   cpu->N = 0; cpu->V = 0; cpu->D=0; cpu->I = 0;
   cpu->Z = 0; cpu->C = 0;
   cpu->finished = 0;
+  cpu->stop_on_brk = 1;
+  cpu->has_decimal = 1;
   cpu->visual_dirty = 1;
   cpu->cycles = 0;
+  cpu->clock = 0;
+  cpu->debug = NULL;
+  cpu->instructions = 0;
+  cpu->counts = NULL;
+  cpu->heat = NULL;
+  cpu->plugins = NULL;
   // allocates 2kB of memory
   //cpu->mem = malloc(2048 * sizeof(uint8_t));
   cpu->mem = mem;
+  // use the core built for this memory, if it has one
+  cpu->core = mem->core_I ? mem->core_I : &generic_core;
 }
 
-/*
- * TODO: this will need to be remade to better fit the new memory interface
- */
+// loads up to 2k of the file at point, returning how much was read
 int load_file_to_mem(FILE *file, struct cpu_info *cpu, int point){
-  uint8_t *m = decode_address(cpu->mem, (uint16_t)point);
-  return fread(m, sizeof(uint8_t), 2048, file);
+  uint8_t buf[2048];
+  size_t len = fread(buf, sizeof(uint8_t), sizeof(buf), file);
+  mem_write_block(cpu->mem, (uint16_t)point, buf, len);
+  return len;
 }
 
 int print_registers(struct cpu_info *cpu){
@@ -71,26 +83,21 @@ int print_registers(struct cpu_info *cpu){
 
 
 void push8(uint8_t pushing, struct cpu_info *cpu){
-  write8(cpu->mem, 0x100|cpu->s, pushing);
-  cpu->s--;
+  PUSH8(cpu, pushing);
 }
 
 void push16(uint16_t pushing, struct cpu_info *cpu){
-  uint8_t h = pushing >> 8;
-  uint8_t l = pushing;
-  push8(h, cpu);
-  push8(l, cpu);
+  PUSH16(cpu, pushing);
 }
 
 uint8_t pull8(struct cpu_info *cpu){
-  cpu->s++;
-  return read8(cpu->mem, 0x100 | cpu->s);
+  return PULL8(cpu);
 }
 
 uint16_t pull16(struct cpu_info *cpu){
-  uint8_t l = pull8(cpu);
-  uint8_t h = pull8(cpu);
-  return (h << 8) | l;
+  uint16_t pulling;
+  PULL16(cpu, pulling);
+  return pulling;
 }
 
 
@@ -108,44 +115,29 @@ uint8_t rotl(uint8_t i, int n){
 
 
 void pull_status(struct cpu_info *cpu){
-  int pulling = pull8(cpu);
-
-  cpu->N = (pulling >> 7) & 1;
-  cpu->V = (pulling >> 6) & 1;
-  cpu->D = (pulling >> 3) & 1;
-  cpu->I = (pulling >> 2) & 1;
-  cpu->Z = (pulling >> 1) & 1;
-  cpu->C = pulling & 1;
+  SET_STATUS(cpu, PULL8(cpu));
 }
 
 void push_status(struct cpu_info *cpu){
-  uint8_t pushing = cpu->N << 7;
-  pushing |= cpu->V << 6;
-  pushing |= 0b00 << 4;
-  pushing |= cpu->D << 3;
-  pushing |= cpu->I << 2;
-  pushing |= cpu->Z << 1;
-  pushing |= cpu->C;
-  push8(pushing, cpu);
+  PUSH8(cpu, STATUS_BYTE(cpu, 0b00));
 }
 
 void push_status_brk(struct cpu_info *cpu){
-  uint8_t pushing = cpu->N << 7;
-  pushing |= cpu->V << 6;
-  pushing |= 0b10 << 4;
-  pushing |= cpu->D << 3;
-  pushing |= cpu->I << 2;
-  pushing |= cpu->Z << 1;
-  pushing |= cpu->C;
-  push8(pushing, cpu);
+  PUSH8(cpu, STATUS_BYTE(cpu, 0b10));
 }
 
+/*
+ * Interrupts are taken between instructions. Both push the pc and status
+ * (with the B flag clear), set I and load the full 16 bit vector. Taking
+ * an interrupt costs 7 cycles, which are charged to the cpu clock.
+ */
 void trigger_nmi(struct cpu_info *cpu){
   push16(cpu->pc, cpu);
   push_status(cpu);
   cpu->I = 1;
-  cpu->pc = read8(cpu->mem,0xfffa);
-  //todo does this add cycles? (probably)
+  cpu->pc = read16(cpu->mem, NMI_VECTOR);
+  cpu->clock += INTERRUPT_CYCLES;
+  if(cpu->plugins) plugins_interrupt(cpu, NMI_VECTOR);
 }
 
 void trigger_irq(struct cpu_info *cpu){
@@ -153,480 +145,45 @@ void trigger_irq(struct cpu_info *cpu){
     push16(cpu->pc, cpu);
     push_status(cpu);
     cpu->I = 1;
-    cpu->pc = read8(cpu->mem,0xfffe);
-  //todo does this add cycles? (probably)
+    cpu->pc = read16(cpu->mem, IRQ_VECTOR);
+    cpu->clock += INTERRUPT_CYCLES;
+    if(cpu->plugins) plugins_interrupt(cpu, IRQ_VECTOR);
   }
 }
 
+/*
+ * The generic core, which reaches memory through the memory interface.
+ * It's used for any memory that doesn't supply a core of its own.
+ */
+#define CORE_NAME generic
+#include "6502_core.h"
+
+// the address the instruction at the pc will operate on
+uint16_t effective_address(struct cpu_info *cpu){
+  return cpu->core->operand_address(cpu);
+}
+
+/*
+ * step() is clocked once per cpu cycle: it executes an instruction and
+ * then idles for as many calls as that instruction takes.
+ */
 void step(struct cpu_info *cpu){
 
-  //check how fast we can run
-  cpu->stats++;
   //account for varying instruction cycles
-  // doesn't take pages into account
   if(cpu->cycles > 0){
     cpu->cycles--;
     return;
   }
 
-  int oldPc = cpu->pc;
-  uint8_t instr = read8(cpu->mem, oldPc);
-  enum OpCode op = int_opcodes[instr];
-  enum AddressMode addrMode = int_address_modes[instr];
-  int cycles = int_cycles[instr];
-  int width = int_width[instr];
-  cpu->cycles = cycles;
-
-  /*
-   * Here we use the address mode to calculate the arguement to be given to
-   * the op code. The argument is passed as a pointer to the arguments value;
-   * hence, immediate values point to the address right after the pc and
-   * absolute address are found by reading the address stored in the position
-   * after the pc.
-   */
-  int16_t address = 0;
-  switch(addrMode){
-    //we read a 16 bit absolute address, hence the bitshifting.
-  case abso:
-    address = read16(cpu->mem, oldPc+1);
-    break;
-  case abx:
-    address = read16(cpu->mem, oldPc+1) + (int8_t)cpu->x;
-    break;
-  case aby:
-    address = read16(cpu->mem, oldPc+1) + (int8_t)cpu->y;
-    break;
-    // the value is immediately after the pc, so it's pc + 1
-  case imm:
-    address = oldPc + 1;
-    break;
-    // used specifically for jumps so based of the pc
-  case rel:
-    address = oldPc + width + (int8_t)read8(cpu->mem,oldPc+1);
-    break;
-  case zp:
-    address = read8(cpu->mem,oldPc+1);
-    break;
-  case zpx:
-    address = read8(cpu->mem,oldPc+1) + (int8_t)cpu->x;
-    break;
-  case zpy:
-    address = read8(cpu->mem,oldPc+1) + (int8_t)cpu->y;
-    break;
-    // this uses an absolute address to find another address
-    // hence, we copy abso then look that address up in mem
-  case ind:
-    address = read16(cpu->mem, read16(cpu->mem, oldPc+1));
-    break;
-  case izx:
-    address = read16(cpu->mem, (int16_t)read8(cpu->mem,oldPc+1) + (int16_t)cpu->x);
-    break;
-  case izy:
-    address = read16(cpu->mem, (int16_t)read8(cpu->mem, oldPc+1)) + (int16_t)cpu->y;
-    break;
-  default:
-    break;
-  }
-
+  cpu->cycles = execute_instruction(cpu);
+}
 
-  //diagnostic to see what we are doing
-  //print_registers(cpu);
-  //printf("%s %x %s\n", opcode_strings[op], address, addressMode_strings[addrMode]);
-  //getchar();
-
-  //inc pc by instruction length
-  cpu->pc +=width;
-
-  switch(op){
-  case ADC:
-    {
-      uint8_t over = cpu->a + read8(cpu->mem,address) + cpu->C; 
-
-      cpu->C = over < cpu->a ;
-      cpu->a = over;
-      cpu->N = (cpu->a >> 7) & 1;
-      cpu->Z = cpu->a == 0;
-    }
-    break;
-
-  case AND:
-    cpu->a = cpu->a & read8(cpu->mem, address);
-    cpu->Z = cpu->a == 0 ? 1 : 0;
-    cpu->N = (cpu->a >> 7) & 1;
-    break;
-
-  case ASL:
-	// this is based on the old a so needs to be first
-    cpu->C = (cpu->a >> 7) & 1;
-
-    cpu->a = cpu->a << read8(cpu->mem, address);
-    cpu->Z = cpu->a == 0 ? 1 : 0;
-    cpu->N = (cpu->a >> 7) & 1;
-    break;
-
-  case BCC:
-    if(cpu->C == 0){
-      cpu->pc = address;
-    }
-    break;
-
-  case BCS:
-    if(cpu->C == 1){
-      cpu->pc = address;
-    }
-    break;
-
-  case BEQ:
-    if(cpu->Z == 1){
-      cpu->pc = address;
-    }
-    break;
-
-  case BIT:
-    {
-      uint8_t val = read8(cpu->mem, address);
-      cpu->V = (val >> 6) & 1;
-      cpu->N = (val >> 7) & 1;
-      cpu->Z = (cpu->a &val) == 0 ? 1 : 0;
-    }
-    break;
-
-  case BMI:
-    if(cpu->N == 1){
-      cpu->pc = address;
-    }
-    break;
-
-  case BNE:
-    if(cpu->Z == 0){
-      cpu->pc = address;
-    }
-    break;
-
-  case BPL:
-    if(cpu->N == 0){
-      cpu->pc = address;
-    }
-    break;
-
-  case BRK:
-    //TODO:
-    // this is just placeholder behaviour
-    cpu->finished = 1;
-    break;
-    
-  case BVC:
-    if(cpu->V == 0){
-      cpu->pc = address;
-    }
-    break;
-
-  case BVS:
-    if(cpu->V == 1){
-      cpu->pc = address;
-    }
-    break;
-
-  case CLC:
-    cpu->C = 0;
-    break;
-
-  case CLD:
-    cpu->D = 0;
-    break;
-
-  case CLI:
-    cpu->I = 0;
-    break;
-
-  case CLV:
-    cpu->V = 0;
-    break;
-
-  case CMP:
-    {
-      uint8_t val = read8(cpu->mem, address);
-      cpu->C = cpu->a >= val;
-      cpu->Z = cpu->a == val;
-      cpu->N = ((cpu->a - val) >> 7) & 1;
-    }
-    break;
-
-  case CPX:
-    {
-      uint8_t val = read8(cpu->mem, address);
-      cpu->C = cpu->x >= val;
-      cpu->Z = cpu->x == val;
-      cpu->N = ((cpu->x - val) >> 7) & 1;
-    }
-    break;
-
-  case CPY:
-    {
-      uint8_t val = read8(cpu->mem, address);
-      cpu->C = cpu->y >= val;
-      cpu->Z = cpu->y == val;
-      cpu->N = ((cpu->y - val) >> 7) & 1;
-    }
-    break;
-
-  case DEC:
-    {
-      uint8_t val = read8(cpu->mem, address) - 1;
-      write8(cpu->mem, address, val);
-      cpu->Z = val == 0 ? 1 : 0;
-      cpu->N = (val >> 7) & 1;
-    }
-    break;
-
-  case DEX:
-    cpu->x -= 1;
-    cpu->Z = cpu->x == 0 ? 1 : 0;
-    cpu->N = (cpu->x >> 7) & 1;
-    break;
-
-  case DEY:
-    cpu->y -= 1;
-    cpu->Z = cpu->y == 0 ? 1 : 0;
-    cpu->N = (cpu->y >> 7) & 1;
-    break;
-
-  case EOR:
-    {
-      uint8_t val = cpu->a ^ read8(cpu->mem, address);
-      cpu->Z = cpu->a == 0 ? 1 : 0;
-      cpu->N = (cpu->a >> 7) & 1;
-    }
-    break;
-
-  case INC:
-    {
-      uint8_t val = read8(cpu->mem, address) + 1;
-      write8(cpu->mem, address, val);
-      cpu->Z = val == 0 ? 1 : 0;
-      cpu->N = (val >> 7) & 1;
-    }
-    break;
-
-  case INX:
-    cpu->x += 1;
-    cpu->Z = cpu->x == 0 ? 1 : 0;
-    cpu->N = (cpu->x >> 7) & 1;
-    break;
-
-  case INY:
-    cpu->y += 1;
-    cpu->Z = cpu->y == 0 ? 1 : 0;
-    cpu->N = (cpu->y >> 7) & 1;
-    break;
-
-  case JMP:
-    cpu->pc = address;
-    break;
-
-  case JSR:
-    //push the old pc -1 to stack (this is 16 bit)
-    push16(cpu->pc-1, cpu);
-    cpu->pc = address;
-    break;
-
-  case LDA:
-    cpu->a = read8(cpu->mem, address);
-    cpu->Z = cpu->a == 0 ? 1 : 0;
-    cpu->N = (cpu->a >> 7) & 1;
-    break;
-
-  case LDX:
-    cpu->x = read8(cpu->mem, address);
-    cpu->Z = cpu->x == 0 ? 1 : 0;
-    cpu->N = (cpu->x >> 7) & 1;
-    break;
-
-  case LDY:
-    cpu->y = read8(cpu->mem, address);
-    cpu->Z = cpu->y == 0 ? 1 : 0;
-    cpu->N = (cpu->y >> 7) & 1;
-    break;
-
-  case LSR:
-    if(addrMode == noAddressMode){
-      // shift the accumulator
-      cpu->C = cpu->a & 1;
-      cpu->a >>= 1;
-      cpu->Z = cpu->a == 0 ? 1 : 0;
-      cpu->N = (cpu->a >> 7) & 1;
-    } else{
-      uint8_t old = read8(cpu->mem, address);
-      uint8_t new = old >> 1;
-      cpu->C = old & 1;
-      write8(cpu->mem, address, old >> 1);
-      cpu->Z = new == 0 ? 1 : 0;
-      cpu->N = (new >> 7) & 1;
-    }
-
-    break;
-
-  case NOP:
-    break;
-
-  case ORA:
-    cpu->y = cpu->a | read8(cpu->mem, address);
-    cpu->Z = cpu->a == 0 ? 1 : 0;
-    cpu->N = (cpu->a >> 7) & 1;
-    break;
-
-  case PHA:
-    push8(cpu->a,cpu);
-    break;
-
-  case PHP:
-    push_status(cpu);
-    break;
-
-  case PLA:
-    cpu->a = pull8(cpu);
-    break;
-
-  case PLP:
-    pull_status(cpu);
-    break;
-
-  case ROL:
-    //TODO: Check this is correct
-    if(addrMode == noAddressMode){
-      uint8_t val = cpu->a;
-      uint8_t working = val << 1;
-      working |= val >> 7;
-
-      cpu->a = working;
-      cpu->Z = (working >> 7) & 0x01;
-      cpu->C = val & 0x01;
-    }else{
-      uint8_t val = read8(cpu->mem,address);
-      uint8_t working = val << 1;
-      working |= val >> 7;
-
-      write8(cpu->mem, address, working);
-      cpu->C = val & 0x01;
-      cpu->Z = (working >> 7) & 0x01;
-    }
-    break;
-    
-  case ROR:
-    //TODO: Check this is correct
-    if(addrMode == noAddressMode){
-      uint8_t val = cpu->a;
-      uint8_t working = val >> 1;
-      working |= val << 7;
-
-      cpu->a = working;
-      cpu->Z = (working >> 7) & 0x01;
-      cpu->C = val & 0x01;
-    }else{
-      uint8_t val = read8(cpu->mem,address);
-      uint8_t working = val >> 1;
-      working |= val << 7;
-
-      write8(cpu->mem, address, working);
-      cpu->C = val & 0x01;
-      cpu->Z = (working >> 7) & 0x01;
-    }
-    break;
-
-  case RTI:
-    pull_status(cpu);
-    cpu->pc = pull16(cpu);
-    break;
-
-  case RTS:
-    //pull the old pc -1 from the stack (this is 16 bit)
-    cpu->pc = pull16(cpu) + 1;
-    break;
-  
-  case SBC:
-    {
-      uint8_t c = 1 + (-cpu->C);
-      uint8_t over = cpu->a + (-read8(cpu->mem,address)) + (-c); 
-
-      cpu->C = over < cpu->a ;
-      cpu->a = over;
-      cpu->N = (cpu->a >> 7) & 1;
-      cpu->Z = cpu->a == 0;
-    }
-    break;
-
-  case SEC:
-    cpu->C = 1;
-    break;
-
-  case SED:
-    cpu->D = 1;
-    break;
-
-  case SEI:
-    cpu->I = 1;
-    break;
-
-  case STA:
-    write8(cpu->mem, address, cpu->a);
-    // sets dirty bit if visual mem is drawn to
-    if ((address >= 0x200) && (address <= 0x5ff)) {
-      cpu->visual_dirty = 1;
-    }
-    break;
-
-  case STX:
-    write8(cpu->mem, address, cpu->x);
-    // sets dirty bit if visual mem is drawn to
-    if ((address >= 0x200) && (address <= 0x5ff)) {
-      cpu->visual_dirty = 1;
-    }
-    break;
-
-  case STY:
-    write8(cpu->mem, address, cpu->y);
-    // sets dirty bit if visual mem is drawn to
-    if ((address >= 0x200) && (address <= 0x5ff)) {
-      cpu->visual_dirty = 1;
-    }
-    break;
-
-  case TAX:
-    cpu->x = cpu->a;
-    cpu->Z = cpu->x == 0 ? 1 : 0;
-    cpu->N = (cpu->x >> 7) & 1;
-    break;
-
-  case TAY:
-    cpu->y = cpu->a;
-    cpu->Z = cpu->y == 0 ? 1 : 0;
-    cpu->N = (cpu->y >> 7) & 1;
-    break;
-
-  case TSX:
-    cpu->x = cpu->s;
-    cpu->Z = cpu->x == 0 ? 1 : 0;
-    cpu->N = (cpu->x >> 7) & 1;
-    break;
-
-  case TXA:
-    cpu->a = cpu->x;
-    cpu->Z = cpu->a == 0 ? 1 : 0;
-    cpu->N = (cpu->a >> 7) & 1;
-    break;
-
-  case TXS:
-    cpu->s = cpu->x;
-    cpu->Z = cpu->s == 0 ? 1 : 0;
-    cpu->N = (cpu->s >> 7) & 1;
-    break;
-
-  case TYA:
-    cpu->a = cpu->y;
-    cpu->Z = cpu->a == 0 ? 1 : 0;
-    cpu->N = (cpu->a >> 7) & 1;
-    break;
-  }
+/*
+ * Executes a single whole instruction, advancing the cpu clock.
+ * Returns the number of cycles the instruction took.
+ */
+int execute_instruction(struct cpu_info *cpu){
+  return cpu->core->execute(cpu);
 }
 
 void print_bin(uint8_t i){
@@ -654,104 +211,271 @@ char *opcode_strings[59] = {
 char *addressMode_strings[12] = {
   "abso", "abx", "aby", "zp", "zpx", "zpy", "izx", "izy", "ind", "imm", "rel", "noAddressMode"
 };
-
-
 /*
- * Tables for decoding the instructions
+ * The table for decoding the instructions: what each opcode does, its
+ * address mode, its width in bytes, the cycles it takes and the extra
+ * cycles it may take on top of them (see struct decode in 6502.h).
+ * Indexed writes and read modify writes always pay for the carry, so
+ * it's in their cycles rather than their penalties.
  *
- * These tables are filled using information gathered from:
+ * This table is filled using information gathered from:
  *    http://visual6502.org/wiki/index.php?title=6502_all_256_Opcodes
  */
-
-enum AddressMode int_address_modes[256] = {
-  noAddressMode, izx, noAddressMode, izx, zp, zp, zp, zp, noAddressMode, imm,
-  noAddressMode, imm, abso, abso, abso, abso, rel, izy, noAddressMode, izy,
-  zpx, zpx, zpx, zpx, noAddressMode, aby, noAddressMode, aby, abx, abx,
-  abx, abx, abso, izx, noAddressMode, izx, zp, zp, zp, zp,
-  noAddressMode, imm, noAddressMode, imm, abso, abso, abso, abso, rel, izy,
-  noAddressMode, izy, zpx, zpx, zpx, zpx, noAddressMode, aby, noAddressMode,
-  aby, abx, abx, abx, abx, noAddressMode, izx, noAddressMode, izx, zp, zp, zp,
-  zp, noAddressMode, imm, noAddressMode, imm, abso, abso, abso, abso, rel, izy,
-  noAddressMode, izy, zpx, zpx, zpx, zpx, noAddressMode, aby, noAddressMode,		
-  aby, abx, abx, abx, abx, noAddressMode, izx, noAddressMode, izx, zp,
-  zp, zp, zp, noAddressMode, imm, noAddressMode, imm, ind, abso, abso,
-  abso, rel, izy, noAddressMode, izy, zpx, zpx, zpx, zpx, noAddressMode, aby,
-  noAddressMode, aby, abx, abx, abx, abx, imm, izx, imm, izx,
-  zp, zp, zp, zp, noAddressMode, imm, noAddressMode, imm, abso, abso,
-  abso, abso, rel, izy, noAddressMode, izy, zpx, zpx, zpy, zpy, noAddressMode,
-  aby, noAddressMode, aby, abx, abx, aby, aby, imm, izx, imm, izx, zp, zp,
-  zp, zp, noAddressMode, imm, noAddressMode, imm, abso, abso, abso, abso, rel,
-  izy, noAddressMode, izy, zpx, zpx, zpy, zpy, noAddressMode, aby, noAddressMode,
-  aby, abx, abx, aby, aby, imm, izx, imm, izx, zp, zp, zp, zp, noAddressMode,
-  imm, noAddressMode, imm, abso, abso, abso, abso, rel, izy, noAddressMode,
-  izy, zpx, zpx, zpx, zpx, noAddressMode, aby, noAddressMode, aby, abx,
-  abx, abx, abx, imm, izx, imm, izx, zp, zp, zp, zp, noAddressMode, imm,
-  noAddressMode, imm, abso, abso, abso, abso, rel, izy, noAddressMode, izy,
-  zpx, zpx, zpx, zpx, noAddressMode, aby, noAddressMode, aby, abx, abx, abx, abx
-  };
-
-
-// the cycles used per instruction
-int int_cycles[256] ={
-  7, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6, 3, 5, 0, 8,
-  4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, 6, 6, 0, 8, 3, 3, 5, 5, 
-  4, 2, 2, 2, 4, 4, 6, 6, 2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 
-  4, 4, 7, 7, 6, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6, 
-  3, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, 6, 6, 0, 8, 
-  3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6, 2, 5, 0, 8, 4, 4, 6, 6, 
-  2, 4, 2, 7, 4, 4, 7, 7, 2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 
-  4, 4, 4, 4, 3, 6, 0, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5, 
-  2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, 2, 5, 0, 5, 
-  4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4, 2, 6, 2, 8, 3, 3, 5, 5, 
-  2, 2, 2, 2, 4, 4, 6, 6, 3, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 
-  4, 4, 7, 7, 2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, 
-  2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7 
-};
-
-
-int int_width[256] = {
-  1, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 3, 3, 3, 0,
-  3, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 3, 3, 3, 0,
-  1, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 3, 3, 3, 0,
-  1, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 0, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 0, 3, 0, 0,
-  2, 2, 2, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
-  2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 3, 3, 3, 0
-};
-
-//the opcode
-enum OpCode int_opcodes[256] = {
-  BRK, ORA, BADOP, BADOP, BADOP, ORA, ASL, BADOP, PHP, ORA, ASL, 
-  BADOP, BADOP, ORA, ASL, BADOP, BPL, ORA, BADOP, BADOP, BADOP, ORA, 
-  ASL, BADOP, CLC, ORA, BADOP, BADOP, BADOP, ORA, ASL, BADOP, JSR,
-  AND, BADOP, BADOP, BIT, AND, ROL, BADOP, PLP, AND, ROL, BADOP, 
-  BIT, AND, ROL, BADOP, BMI, AND, BADOP, BADOP, BADOP, AND, ROL, 
-  BADOP, SEC, AND, BADOP, BADOP, BADOP, AND, ROL, BADOP, RTI, EOR, 
-  BADOP, BADOP, BADOP, EOR, LSR, BADOP, PHA, EOR, LSR, BADOP, JMP, 
-  EOR, LSR, BADOP, BVC, EOR, BADOP, BADOP, BADOP, EOR, LSR, BADOP, 
-  CLI, EOR, BADOP, BADOP, BADOP, EOR, LSR, BADOP, RTS, ADC, BADOP, 
-  BADOP, BADOP, ADC, ROR, BADOP, PLA, ADC, ROR, BADOP, JMP, ADC, 
-  ROR, BADOP, BVS, ADC, BADOP, BADOP, BADOP, ADC, ROR, BADOP, SEI, 
-  ADC, BADOP, BADOP, BADOP, ADC, ROR, BADOP, BADOP, STA, BADOP, BADOP, 
-  STY, STA, STX, BADOP, DEY, BADOP, TXA, BADOP, STY, STA, STX, 
-  BADOP, BCC, STA, BADOP, BADOP, STY, STA, STX, BADOP, TYA, STA, 
-  TXS, BADOP, BADOP, STA, BADOP, BADOP, LDY, LDA, LDX, BADOP, LDY, 
-  LDA, LDX, BADOP, TAY, LDA, TAX, BADOP, LDY, LDA, LDX, BADOP, 
-  BCS, LDA, BADOP, BADOP, LDY, LDA, LDX, BADOP, CLV, LDA, TSX, 
-  BADOP, LDY, LDA, LDX, BADOP, CPY, CMP, BADOP, BADOP, CPY, CMP,
-  DEC, BADOP, INY, CMP, DEX, BADOP, CPY, CMP, DEC, BADOP, BNE, 
-  CMP, BADOP, BADOP, BADOP, CMP, DEC, BADOP, CLD, CMP, BADOP, BADOP,
-  BADOP, CMP, DEC, BADOP, CPX, SBC, BADOP, BADOP, CPX, SBC, INC, 
-  BADOP, INX, SBC, NOP, BADOP, CPX, SBC, INC, BADOP, BEQ, SBC, 
-  BADOP, BADOP, BADOP, SBC, INC, BADOP, SED, SBC, BADOP, BADOP, BADOP, 
-  SBC, INC, BADOP 
+const struct decode decode_table[256] = {
+  [0x00] = {BRK,   noAddressMode, 1, 7, 0},
+  [0x01] = {ORA,   izx,           2, 6, 0},
+  [0x02] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x03] = {BADOP, izx,           0, 8, 0},
+  [0x04] = {BADOP, zp,            2, 3, 0},
+  [0x05] = {ORA,   zp,            2, 3, 0},
+  [0x06] = {ASL,   zp,            2, 5, 0},
+  [0x07] = {BADOP, zp,            0, 5, 0},
+  [0x08] = {PHP,   noAddressMode, 1, 3, 0},
+  [0x09] = {ORA,   imm,           2, 2, 0},
+  [0x0A] = {ASL,   noAddressMode, 1, 2, 0},
+  [0x0B] = {BADOP, imm,           0, 2, 0},
+  [0x0C] = {BADOP, abso,          3, 4, 0},
+  [0x0D] = {ORA,   abso,          3, 4, 0},
+  [0x0E] = {ASL,   abso,          3, 6, 0},
+  [0x0F] = {BADOP, abso,          0, 6, 0},
+  [0x10] = {BPL,   rel,           2, 2, 2},
+  [0x11] = {ORA,   izy,           2, 5, 1},
+  [0x12] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x13] = {BADOP, izy,           0, 8, 0},
+  [0x14] = {BADOP, zpx,           2, 4, 0},
+  [0x15] = {ORA,   zpx,           2, 4, 0},
+  [0x16] = {ASL,   zpx,           2, 6, 0},
+  [0x17] = {BADOP, zpx,           0, 6, 0},
+  [0x18] = {CLC,   noAddressMode, 1, 2, 0},
+  [0x19] = {ORA,   aby,           3, 4, 1},
+  [0x1A] = {BADOP, noAddressMode, 1, 2, 0},
+  [0x1B] = {BADOP, aby,           0, 7, 0},
+  [0x1C] = {BADOP, abx,           3, 4, 0},
+  [0x1D] = {ORA,   abx,           3, 4, 1},
+  [0x1E] = {ASL,   abx,           3, 7, 0},
+  [0x1F] = {BADOP, abx,           0, 7, 0},
+  [0x20] = {JSR,   abso,          3, 6, 0},
+  [0x21] = {AND,   izx,           2, 6, 0},
+  [0x22] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x23] = {BADOP, izx,           0, 8, 0},
+  [0x24] = {BIT,   zp,            2, 3, 0},
+  [0x25] = {AND,   zp,            2, 3, 0},
+  [0x26] = {ROL,   zp,            2, 5, 0},
+  [0x27] = {BADOP, zp,            0, 5, 0},
+  [0x28] = {PLP,   noAddressMode, 1, 4, 0},
+  [0x29] = {AND,   imm,           2, 2, 0},
+  [0x2A] = {ROL,   noAddressMode, 1, 2, 0},
+  [0x2B] = {BADOP, imm,           0, 2, 0},
+  [0x2C] = {BIT,   abso,          3, 4, 0},
+  [0x2D] = {AND,   abso,          3, 4, 0},
+  [0x2E] = {ROL,   abso,          3, 6, 0},
+  [0x2F] = {BADOP, abso,          0, 6, 0},
+  [0x30] = {BMI,   rel,           2, 2, 2},
+  [0x31] = {AND,   izy,           2, 5, 1},
+  [0x32] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x33] = {BADOP, izy,           0, 8, 0},
+  [0x34] = {BADOP, zpx,           2, 4, 0},
+  [0x35] = {AND,   zpx,           2, 4, 0},
+  [0x36] = {ROL,   zpx,           2, 6, 0},
+  [0x37] = {BADOP, zpx,           0, 6, 0},
+  [0x38] = {SEC,   noAddressMode, 1, 2, 0},
+  [0x39] = {AND,   aby,           3, 4, 1},
+  [0x3A] = {BADOP, noAddressMode, 1, 2, 0},
+  [0x3B] = {BADOP, aby,           0, 7, 0},
+  [0x3C] = {BADOP, abx,           3, 4, 0},
+  [0x3D] = {AND,   abx,           3, 4, 1},
+  [0x3E] = {ROL,   abx,           3, 7, 0},
+  [0x3F] = {BADOP, abx,           0, 7, 0},
+  [0x40] = {RTI,   noAddressMode, 1, 6, 0},
+  [0x41] = {EOR,   izx,           2, 6, 0},
+  [0x42] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x43] = {BADOP, izx,           0, 8, 0},
+  [0x44] = {BADOP, zp,            2, 3, 0},
+  [0x45] = {EOR,   zp,            2, 3, 0},
+  [0x46] = {LSR,   zp,            2, 5, 0},
+  [0x47] = {BADOP, zp,            0, 5, 0},
+  [0x48] = {PHA,   noAddressMode, 1, 3, 0},
+  [0x49] = {EOR,   imm,           2, 2, 0},
+  [0x4A] = {LSR,   noAddressMode, 1, 2, 0},
+  [0x4B] = {BADOP, imm,           0, 2, 0},
+  [0x4C] = {JMP,   abso,          3, 3, 0},
+  [0x4D] = {EOR,   abso,          3, 4, 0},
+  [0x4E] = {LSR,   abso,          3, 6, 0},
+  [0x4F] = {BADOP, abso,          0, 6, 0},
+  [0x50] = {BVC,   rel,           2, 2, 2},
+  [0x51] = {EOR,   izy,           2, 5, 1},
+  [0x52] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x53] = {BADOP, izy,           0, 8, 0},
+  [0x54] = {BADOP, zpx,           2, 4, 0},
+  [0x55] = {EOR,   zpx,           2, 4, 0},
+  [0x56] = {LSR,   zpx,           2, 6, 0},
+  [0x57] = {BADOP, zpx,           0, 6, 0},
+  [0x58] = {CLI,   noAddressMode, 1, 2, 0},
+  [0x59] = {EOR,   aby,           3, 4, 1},
+  [0x5A] = {BADOP, noAddressMode, 1, 2, 0},
+  [0x5B] = {BADOP, aby,           0, 7, 0},
+  [0x5C] = {BADOP, abx,           3, 4, 0},
+  [0x5D] = {EOR,   abx,           3, 4, 1},
+  [0x5E] = {LSR,   abx,           3, 7, 0},
+  [0x5F] = {BADOP, abx,           0, 7, 0},
+  [0x60] = {RTS,   noAddressMode, 1, 6, 0},
+  [0x61] = {ADC,   izx,           2, 6, 0},
+  [0x62] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x63] = {BADOP, izx,           0, 8, 0},
+  [0x64] = {BADOP, zp,            2, 3, 0},
+  [0x65] = {ADC,   zp,            2, 3, 0},
+  [0x66] = {ROR,   zp,            2, 5, 0},
+  [0x67] = {BADOP, zp,            0, 5, 0},
+  [0x68] = {PLA,   noAddressMode, 1, 4, 0},
+  [0x69] = {ADC,   imm,           2, 2, 0},
+  [0x6A] = {ROR,   noAddressMode, 1, 2, 0},
+  [0x6B] = {BADOP, imm,           0, 2, 0},
+  [0x6C] = {JMP,   ind,           3, 5, 0},
+  [0x6D] = {ADC,   abso,          3, 4, 0},
+  [0x6E] = {ROR,   abso,          3, 6, 0},
+  [0x6F] = {BADOP, abso,          0, 6, 0},
+  [0x70] = {BVS,   rel,           2, 2, 2},
+  [0x71] = {ADC,   izy,           2, 5, 1},
+  [0x72] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x73] = {BADOP, izy,           0, 8, 0},
+  [0x74] = {BADOP, zpx,           2, 4, 0},
+  [0x75] = {ADC,   zpx,           2, 4, 0},
+  [0x76] = {ROR,   zpx,           2, 6, 0},
+  [0x77] = {BADOP, zpx,           0, 6, 0},
+  [0x78] = {SEI,   noAddressMode, 1, 2, 0},
+  [0x79] = {ADC,   aby,           3, 4, 1},
+  [0x7A] = {BADOP, noAddressMode, 1, 2, 0},
+  [0x7B] = {BADOP, aby,           0, 7, 0},
+  [0x7C] = {BADOP, abx,           3, 4, 0},
+  [0x7D] = {ADC,   abx,           3, 4, 1},
+  [0x7E] = {ROR,   abx,           3, 7, 0},
+  [0x7F] = {BADOP, abx,           0, 7, 0},
+  [0x80] = {BADOP, imm,           2, 2, 0},
+  [0x81] = {STA,   izx,           2, 6, 0},
+  [0x82] = {BADOP, imm,           0, 2, 0},
+  [0x83] = {BADOP, izx,           0, 6, 0},
+  [0x84] = {STY,   zp,            2, 3, 0},
+  [0x85] = {STA,   zp,            2, 3, 0},
+  [0x86] = {STX,   zp,            2, 3, 0},
+  [0x87] = {BADOP, zp,            0, 3, 0},
+  [0x88] = {DEY,   noAddressMode, 1, 2, 0},
+  [0x89] = {BADOP, imm,           0, 2, 0},
+  [0x8A] = {TXA,   noAddressMode, 1, 2, 0},
+  [0x8B] = {BADOP, imm,           0, 2, 0},
+  [0x8C] = {STY,   abso,          3, 4, 0},
+  [0x8D] = {STA,   abso,          3, 4, 0},
+  [0x8E] = {STX,   abso,          3, 4, 0},
+  [0x8F] = {BADOP, abso,          0, 4, 0},
+  [0x90] = {BCC,   rel,           2, 2, 2},
+  [0x91] = {STA,   izy,           2, 6, 0},
+  [0x92] = {BADOP, noAddressMode, 0, 0, 0},
+  [0x93] = {BADOP, izy,           0, 6, 0},
+  [0x94] = {STY,   zpx,           2, 4, 0},
+  [0x95] = {STA,   zpx,           2, 4, 0},
+  [0x96] = {STX,   zpy,           2, 4, 0},
+  [0x97] = {BADOP, zpy,           0, 4, 0},
+  [0x98] = {TYA,   noAddressMode, 1, 2, 0},
+  [0x99] = {STA,   aby,           3, 5, 0},
+  [0x9A] = {TXS,   noAddressMode, 1, 2, 0},
+  [0x9B] = {BADOP, aby,           0, 5, 0},
+  [0x9C] = {BADOP, abx,           0, 5, 0},
+  [0x9D] = {STA,   abx,           3, 5, 0},
+  [0x9E] = {BADOP, aby,           0, 5, 0},
+  [0x9F] = {BADOP, aby,           0, 5, 0},
+  [0xA0] = {LDY,   imm,           2, 2, 0},
+  [0xA1] = {LDA,   izx,           2, 6, 0},
+  [0xA2] = {LDX,   imm,           2, 2, 0},
+  [0xA3] = {BADOP, izx,           0, 6, 0},
+  [0xA4] = {LDY,   zp,            2, 3, 0},
+  [0xA5] = {LDA,   zp,            2, 3, 0},
+  [0xA6] = {LDX,   zp,            2, 3, 0},
+  [0xA7] = {BADOP, zp,            0, 3, 0},
+  [0xA8] = {TAY,   noAddressMode, 1, 2, 0},
+  [0xA9] = {LDA,   imm,           2, 2, 0},
+  [0xAA] = {TAX,   noAddressMode, 1, 2, 0},
+  [0xAB] = {BADOP, imm,           0, 2, 0},
+  [0xAC] = {LDY,   abso,          3, 4, 0},
+  [0xAD] = {LDA,   abso,          3, 4, 0},
+  [0xAE] = {LDX,   abso,          3, 4, 0},
+  [0xAF] = {BADOP, abso,          0, 4, 0},
+  [0xB0] = {BCS,   rel,           2, 2, 2},
+  [0xB1] = {LDA,   izy,           2, 5, 1},
+  [0xB2] = {BADOP, noAddressMode, 0, 0, 0},
+  [0xB3] = {BADOP, izy,           0, 5, 0},
+  [0xB4] = {LDY,   zpx,           2, 4, 0},
+  [0xB5] = {LDA,   zpx,           2, 4, 0},
+  [0xB6] = {LDX,   zpy,           2, 4, 0},
+  [0xB7] = {BADOP, zpy,           0, 4, 0},
+  [0xB8] = {CLV,   noAddressMode, 1, 2, 0},
+  [0xB9] = {LDA,   aby,           3, 4, 1},
+  [0xBA] = {TSX,   noAddressMode, 1, 2, 0},
+  [0xBB] = {BADOP, aby,           0, 4, 0},
+  [0xBC] = {LDY,   abx,           3, 4, 1},
+  [0xBD] = {LDA,   abx,           3, 4, 1},
+  [0xBE] = {LDX,   aby,           3, 4, 1},
+  [0xBF] = {BADOP, aby,           0, 4, 0},
+  [0xC0] = {CPY,   imm,           2, 2, 0},
+  [0xC1] = {CMP,   izx,           2, 6, 0},
+  [0xC2] = {BADOP, imm,           0, 2, 0},
+  [0xC3] = {BADOP, izx,           0, 8, 0},
+  [0xC4] = {CPY,   zp,            2, 3, 0},
+  [0xC5] = {CMP,   zp,            2, 3, 0},
+  [0xC6] = {DEC,   zp,            2, 5, 0},
+  [0xC7] = {BADOP, zp,            0, 5, 0},
+  [0xC8] = {INY,   noAddressMode, 1, 2, 0},
+  [0xC9] = {CMP,   imm,           2, 2, 0},
+  [0xCA] = {DEX,   noAddressMode, 1, 2, 0},
+  [0xCB] = {BADOP, imm,           0, 2, 0},
+  [0xCC] = {CPY,   abso,          3, 4, 0},
+  [0xCD] = {CMP,   abso,          3, 4, 0},
+  [0xCE] = {DEC,   abso,          3, 6, 0},
+  [0xCF] = {BADOP, abso,          0, 6, 0},
+  [0xD0] = {BNE,   rel,           2, 2, 2},
+  [0xD1] = {CMP,   izy,           2, 5, 1},
+  [0xD2] = {BADOP, noAddressMode, 0, 0, 0},
+  [0xD3] = {BADOP, izy,           0, 8, 0},
+  [0xD4] = {BADOP, zpx,           2, 4, 0},
+  [0xD5] = {CMP,   zpx,           2, 4, 0},
+  [0xD6] = {DEC,   zpx,           2, 6, 0},
+  [0xD7] = {BADOP, zpx,           0, 6, 0},
+  [0xD8] = {CLD,   noAddressMode, 1, 2, 0},
+  [0xD9] = {CMP,   aby,           3, 4, 1},
+  [0xDA] = {BADOP, noAddressMode, 1, 2, 0},
+  [0xDB] = {BADOP, aby,           0, 7, 0},
+  [0xDC] = {BADOP, abx,           3, 4, 0},
+  [0xDD] = {CMP,   abx,           3, 4, 1},
+  [0xDE] = {DEC,   abx,           3, 7, 0},
+  [0xDF] = {BADOP, abx,           0, 7, 0},
+  [0xE0] = {CPX,   imm,           2, 2, 0},
+  [0xE1] = {SBC,   izx,           2, 6, 0},
+  [0xE2] = {BADOP, imm,           0, 2, 0},
+  [0xE3] = {BADOP, izx,           0, 8, 0},
+  [0xE4] = {CPX,   zp,            2, 3, 0},
+  [0xE5] = {SBC,   zp,            2, 3, 0},
+  [0xE6] = {INC,   zp,            2, 5, 0},
+  [0xE7] = {BADOP, zp,            0, 5, 0},
+  [0xE8] = {INX,   noAddressMode, 1, 2, 0},
+  [0xE9] = {SBC,   imm,           2, 2, 0},
+  [0xEA] = {NOP,   noAddressMode, 1, 2, 0},
+  [0xEB] = {BADOP, imm,           0, 2, 0},
+  [0xEC] = {CPX,   abso,          3, 4, 0},
+  [0xED] = {SBC,   abso,          3, 4, 0},
+  [0xEE] = {INC,   abso,          3, 6, 0},
+  [0xEF] = {BADOP, abso,          0, 6, 0},
+  [0xF0] = {BEQ,   rel,           2, 2, 2},
+  [0xF1] = {SBC,   izy,           2, 5, 1},
+  [0xF2] = {BADOP, noAddressMode, 0, 0, 0},
+  [0xF3] = {BADOP, izy,           0, 8, 0},
+  [0xF4] = {BADOP, zpx,           2, 4, 0},
+  [0xF5] = {SBC,   zpx,           2, 4, 0},
+  [0xF6] = {INC,   zpx,           2, 6, 0},
+  [0xF7] = {BADOP, zpx,           0, 6, 0},
+  [0xF8] = {SED,   noAddressMode, 1, 2, 0},
+  [0xF9] = {SBC,   aby,           3, 4, 1},
+  [0xFA] = {BADOP, noAddressMode, 1, 2, 0},
+  [0xFB] = {BADOP, aby,           0, 7, 0},
+  [0xFC] = {BADOP, abx,           3, 4, 0},
+  [0xFD] = {SBC,   abx,           3, 4, 1},
+  [0xFE] = {INC,   abx,           3, 7, 0},
+  [0xFF] = {BADOP, abx,           0, 7, 0},
 };
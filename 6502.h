@@ -1,6 +1,7 @@
 #ifndef NES_CPU_H
 #define NES_CPU_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <stdio.h>
@@ -19,15 +20,51 @@
 // The PPU registers is also mirrored; though, every 8 bytes.
 // At this stage I think it's best to calculate this using (%)
 
+// interrupt vectors, each holds a 16 bit address
+#define NMI_VECTOR   0xFFFA
+#define RESET_VECTOR 0xFFFC
+#define IRQ_VECTOR   0xFFFE
+// cycles taken to push state and jump through a vector
+#define INTERRUPT_CYCLES 7
+
+struct debugger;
+struct access_counts;
+struct heatmap;
+struct plugin_host;
+struct cpu_info;
+
+/*
+ * A cpu core: the instruction interpreter compiled for one way of
+ * accessing memory (see 6502_core.h).
+ */
+struct cpu_core{
+  uint16_t (*operand_address)(struct cpu_info*);
+  int (*execute)(struct cpu_info*);
+  void (*run)(struct cpu_info*, uint64_t deadline);
+};
+
+extern const struct cpu_core generic_core;
+
+// the cpu state is laid out to suit cache lines of this size
+#define CACHE_LINE 64
+
+/*
+ * What stopped the cpu: a BRK, when stop_on_brk is set, or one of the
+ * undefined opcodes that lock up a real 6502 (and leave the pc on them).
+ */
+enum cpu_stop{ CPU_RUNNING, CPU_BRK, CPU_JAM };
+
 struct cpu_info{
-  uint8_t a;
+  /*
+   * The state every instruction touches comes first, so that it all
+   * shares one cache line; the rest is only needed now and then.
+   */
+  _Alignas(CACHE_LINE) uint8_t a;
   uint8_t x;
   uint8_t y;
-  uint16_t pc;
   //stack register
   uint8_t s;
-  //ptr to mem
-  struct memory *mem;
+  uint16_t pc;
 
   //status registers
   uint8_t N;
@@ -38,13 +75,53 @@ struct cpu_info{
   uint8_t Z;
   uint8_t C;
 
+  // why the program stopped (an enum cpu_stop), tested before every
+  // instruction; CPU_RUNNING (0) until it does
+  uint8_t finished;
+  // BRK finishes the program, as the easy 6502 machine expects, rather
+  // than being the software interrupt it is on a real 6502
+  uint8_t stop_on_brk;
+  // ADC and SBC honour the D flag (the NES's 2A03 has no decimal mode)
+  uint8_t has_decimal;
+
+  // total cycles executed since init, used to time scheduled events
+  uint64_t clock;
+  //ptr to mem
+  struct memory *mem;
+  // chosen to suit mem by init_cpu_info()
+  const struct cpu_core *core;
+  // instructions executed since init. Kept apart from the clock, as
+  // gcc would otherwise add to both with one vector load and store,
+  // which stalls the next instruction's reads of the clock
+  uint64_t instructions;
+
+  // cycles left of the current instruction, for step()
   int cycles;
   int visual_dirty;
-
-  int finished;
-  int stats;
+  // per region access counts, only kept by the metered core (see metrics.h)
+  struct access_counts *counts;
+  // per address access counts, while a heatmap is taken (see heatmap.h)
+  struct heatmap *heat;
+  // the plugins watching this cpu, if any (see plugin.h)
+  struct plugin_host *plugins;
+
+  // set while a debugger needs to see every instruction (see gdbstub.h)
+  struct debugger *debug;
 };
 
+_Static_assert(offsetof(struct cpu_info, cycles) <= CACHE_LINE,
+	       "the hot cpu state should fit in a cache line");
+
+/*
+ * A write by the cpu: stored, then passed on to the memory's devices if it
+ * has any that watch for writes, with the cycles they stall the cpu for
+ * (an OAM DMA, say) charged to its clock in one go.
+ */
+static inline void cpu_write8(struct cpu_info *cpu, uint16_t addr, uint8_t val){
+  write8(cpu->mem, addr, val);
+  if(cpu->mem->store_I) cpu->clock += cpu->mem->store_I(cpu->mem, addr, val, cpu->clock);
+}
+
 
 /*
 void write8(struct cpu_info *cpu, uint16_t indx, uint8_t writing);
@@ -54,6 +131,16 @@ uint8_t read8(struct cpu_info *cpu, uint16_t indx);
 void init_cpu_info(struct cpu_info *cpu, struct memory*);
 int load_file_to_mem(FILE *file, struct cpu_info *cpu, int point);
 void step(struct cpu_info *cpu);
+int execute_instruction(struct cpu_info *cpu);
+uint16_t effective_address(struct cpu_info *cpu);
+
+// stack helpers, shared with the instruction definitions in 6502_ops.h
+void push8(uint8_t pushing, struct cpu_info *cpu);
+void push16(uint16_t pushing, struct cpu_info *cpu);
+uint8_t pull8(struct cpu_info *cpu);
+uint16_t pull16(struct cpu_info *cpu);
+void push_status(struct cpu_info *cpu);
+void pull_status(struct cpu_info *cpu);
 
 void trigger_nmi(struct cpu_info *cpu);
 void trigger_irq(struct cpu_info *cpu);
@@ -77,19 +164,28 @@ enum AddressMode {
 extern char *addressMode_strings[12]; 
 
 /*
- * Tables for decoding the instructions
+ * How an opcode decodes, packed into 4 bytes so that decoding an
+ * instruction touches a single cache line of the table.
  *
- * These tables are filled using information gathered from:
- *    http://visual6502.org/wiki/index.php?title=6502_all_256_Opcodes
+ * penalties are the cycles an instruction may take on top of its cycles,
+ * as a mask: indexed reads take one more when the index carries into the
+ * high byte of the address, and branches one when taken and another when
+ * they land in a different page.
  */
+#define PENALTY_PAGE 1
+#define PENALTY_BRANCH 2
+
+struct decode{
+  uint8_t op;   // enum OpCode
+  uint8_t mode; // enum AddressMode
+  uint8_t width;
+  uint8_t cycles : 4;
+  uint8_t penalties : 4;
+};
 
-extern enum AddressMode int_address_modes[256];
-
+_Static_assert(sizeof(struct decode) == 4, "struct decode should pack into 4 bytes");
 
-// the cycles used per instruction
-extern int int_cycles[256];
-extern int int_width[256];
-//the opcode
-extern enum OpCode int_opcodes[256];
+// the table for decoding the instructions, indexed by opcode
+extern const struct decode decode_table[256];
   
 #endif
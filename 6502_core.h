@@ -0,0 +1,351 @@
+/*
+ * The 6502 core, as a template.
+ *
+ * This file has no include guard: it is included once for every core we
+ * want, each time with READ8/READ16/WRITE8 defined to access memory in a
+ * particular way and CORE_NAME set to name the result. The generic core
+ * (6502.c) goes through the memory interface, while a memory backend can
+ * include it with its own address decoding so that it is inlined into
+ * every access (see memory.c and nes_memory.c). Each inclusion defines
+ *
+ *   const struct cpu_core <CORE_NAME>_core;
+ *
+ * which a backend hands to the cpu through its core_I field.
+ *
+ * The instruction stream (opcodes and operands) is read with FETCH8 and
+ * FETCH16, which are READ8 and READ16 unless a core wants to tell them
+ * apart (see heatmap.c). A core can also define CORE_BEFORE_INSTRUCTION
+ * (cpu, opcode) to be called before each instruction (see plugin.c); it
+ * isn't called from superinstructions, so a core can't have both.
+ * CORE_SUPERINSTRUCTIONS (see below) is undefined again at the end, so
+ * each core that wants them defines it before its inclusion.
+ */
+
+#ifndef CORE_NAME
+#error "CORE_NAME must be defined before including 6502_core.h"
+#endif
+
+#include "6502_ops.h"
+
+#ifndef FETCH8
+#define FETCH8(cpu, addr) READ8(cpu, addr)
+#define FETCH16(cpu, addr) READ16(cpu, addr)
+#define CORE_DEFAULT_FETCH
+#endif
+
+#if defined(CORE_BEFORE_INSTRUCTION) && defined(CORE_SUPERINSTRUCTIONS)
+#error "superinstructions skip CORE_BEFORE_INSTRUCTION"
+#endif
+
+#define CORE_PASTE(a, b) a ## _ ## b
+#define CORE_EXPAND(a, b) CORE_PASTE(a, b)
+#define CORE_FN(name) CORE_EXPAND(CORE_NAME, name)
+
+/*
+ * Here we use the address mode to calculate the arguement to be given to
+ * the op code. The argument is passed as a pointer to the arguments value;
+ * hence, immediate values point to the address right after the pc and
+ * absolute address are found by reading the address stored in the position
+ * after the pc.
+ */
+static inline uint16_t CORE_FN(operand_address)(struct cpu_info *cpu, int oldPc,
+						enum AddressMode addrMode, int width,
+						int *crossed){
+  uint16_t address = 0;
+  // the pointer modes use their operand more than once, so read it first
+  uint16_t ptr, base;
+  switch(addrMode){
+    //we read a 16 bit absolute address, hence the bitshifting.
+  case abso:
+    address = FETCH16(cpu, oldPc+1);
+    break;
+  case abx:
+    base = FETCH16(cpu, oldPc+1);
+    address = ADDR_ABX(cpu, base);
+    *crossed = PAGE_CROSSED(base, address);
+    break;
+  case aby:
+    base = FETCH16(cpu, oldPc+1);
+    address = ADDR_ABY(cpu, base);
+    *crossed = PAGE_CROSSED(base, address);
+    break;
+    // the value is immediately after the pc, so it's pc + 1
+  case imm:
+    address = oldPc + 1;
+    break;
+    // used specifically for jumps so based of the pc
+  case rel:
+    base = oldPc + width;
+    address = base + (int8_t)FETCH8(cpu, oldPc+1);
+    *crossed = PAGE_CROSSED(base, address);
+    break;
+  case zp:
+    address = FETCH8(cpu, oldPc+1);
+    break;
+  case zpx:
+    address = ADDR_ZPX(cpu, FETCH8(cpu, oldPc+1));
+    break;
+  case zpy:
+    address = ADDR_ZPY(cpu, FETCH8(cpu, oldPc+1));
+    break;
+    // this uses an absolute address to find another address
+    // hence, we copy abso then look that address up in mem
+  case ind:
+    ptr = FETCH16(cpu, oldPc+1);
+    address = ADDR_IND(cpu, ptr);
+    break;
+  case izx:
+    ptr = FETCH8(cpu, oldPc+1);
+    address = ADDR_IZX(cpu, ptr);
+    break;
+  case izy:
+    ptr = FETCH8(cpu, oldPc+1);
+    base = ADDR_IZY_BASE(cpu, ptr);
+    address = ADDR_ABY(cpu, base);
+    *crossed = PAGE_CROSSED(base, address);
+    break;
+  default:
+    break;
+  }
+  return address;
+}
+
+// the address the instruction at the pc will operate on
+static uint16_t CORE_FN(operand_address_at)(struct cpu_info *cpu){
+  struct decode d = decode_table[READ8(cpu, cpu->pc)];
+  int crossed;
+  return CORE_FN(operand_address)(cpu, cpu->pc, d.mode, d.width, &crossed);
+}
+
+/*
+ * Executes the instruction at the pc given how it decodes, advancing the
+ * cpu clock by the cycles it takes.
+ *
+ * This is always inlined, so that where the decoding is a constant (in a
+ * superinstruction, see below) the switches fold down to the one case.
+ */
+static inline __attribute__((always_inline))
+void CORE_FN(execute_decoded)(struct cpu_info *cpu, enum OpCode op,
+			      enum AddressMode addrMode, int cycles, int width,
+			      int penalties){
+  int oldPc = cpu->pc;
+  cpu->clock += cycles;
+  cpu->instructions++;
+
+  int crossed = 0;
+  // set by the branches
+  int taken = 0;
+  uint16_t address = CORE_FN(operand_address)(cpu, oldPc, addrMode, width, &crossed);
+
+  //diagnostic to see what we are doing
+  //print_registers(cpu);
+  //printf("%s %x %s\n", opcode_strings[op], address, addressMode_strings[addrMode]);
+  //getchar();
+
+  //inc pc by instruction length
+  cpu->pc +=width;
+
+  /*
+   * The instructions themselves are defined in 6502_ops.h
+   */
+  switch(op){
+  case ADC: OP_ADC(cpu, READ8(cpu, address)); break;
+  case AND: OP_AND(cpu, READ8(cpu, address)); break;
+  case ASL:
+    if(addrMode == noAddressMode){
+      OP_ASL_A(cpu);
+    } else{
+      OP_ASL_M(cpu, address);
+    }
+    break;
+
+  case BIT: OP_BIT(cpu, READ8(cpu, address)); break;
+
+  case BCC: taken = TAKEN_BCC(cpu); break;
+  case BCS: taken = TAKEN_BCS(cpu); break;
+  case BEQ: taken = TAKEN_BEQ(cpu); break;
+  case BMI: taken = TAKEN_BMI(cpu); break;
+  case BNE: taken = TAKEN_BNE(cpu); break;
+  case BPL: taken = TAKEN_BPL(cpu); break;
+  case BVC: taken = TAKEN_BVC(cpu); break;
+  case BVS: taken = TAKEN_BVS(cpu); break;
+
+  case BRK:
+    if(cpu->stop_on_brk){
+      cpu->finished = CPU_BRK;
+    } else{
+      OP_BRK(cpu, cpu->pc);
+    }
+    break;
+
+  case CLC: cpu->C = 0; break;
+  case CLD: cpu->D = 0; break;
+  case CLI: cpu->I = 0; break;
+  case CLV: cpu->V = 0; break;
+
+  case CMP: OP_CMP(cpu, READ8(cpu, address)); break;
+  case CPX: OP_CPX(cpu, READ8(cpu, address)); break;
+  case CPY: OP_CPY(cpu, READ8(cpu, address)); break;
+
+  case DEC: OP_DEC(cpu, address); break;
+  case DEX: OP_DEX(cpu); break;
+  case DEY: OP_DEY(cpu); break;
+  case EOR: OP_EOR(cpu, READ8(cpu, address)); break;
+  case INC: OP_INC(cpu, address); break;
+  case INX: OP_INX(cpu); break;
+  case INY: OP_INY(cpu); break;
+
+  case JMP: cpu->pc = address; break;
+  case JSR: OP_JSR(cpu, cpu->pc); cpu->pc = address; break;
+
+  case LDA: OP_LDA(cpu, READ8(cpu, address)); break;
+  case LDX: OP_LDX(cpu, READ8(cpu, address)); break;
+  case LDY: OP_LDY(cpu, READ8(cpu, address)); break;
+
+  case LSR:
+    if(addrMode == noAddressMode){
+      OP_LSR_A(cpu);
+    } else{
+      OP_LSR_M(cpu, address);
+    }
+    break;
+
+  case NOP: break;
+  case ORA: OP_ORA(cpu, READ8(cpu, address)); break;
+
+  case PHA: OP_PHA(cpu); break;
+  case PHP: OP_PHP(cpu); break;
+  case PLA: OP_PLA(cpu); break;
+  case PLP: OP_PLP(cpu); break;
+
+  case ROL:
+    if(addrMode == noAddressMode){
+      OP_ROL_A(cpu);
+    }else{
+      OP_ROL_M(cpu, address);
+    }
+    break;
+
+  case ROR:
+    if(addrMode == noAddressMode){
+      OP_ROR_A(cpu);
+    }else{
+      OP_ROR_M(cpu, address);
+    }
+    break;
+
+  case RTI: OP_RTI(cpu); break;
+  case RTS: OP_RTS(cpu); break;
+  case SBC: OP_SBC(cpu, READ8(cpu, address)); break;
+
+  case SEC: cpu->C = 1; break;
+  case SED: cpu->D = 1; break;
+  case SEI: cpu->I = 1; break;
+
+  case STA: OP_STA(cpu, address); break;
+  case STX: OP_STX(cpu, address); break;
+  case STY: OP_STY(cpu, address); break;
+
+  case TAX: OP_TAX(cpu); break;
+  case TAY: OP_TAY(cpu); break;
+  case TSX: OP_TSX(cpu); break;
+  case TXA: OP_TXA(cpu); break;
+  case TXS: OP_TXS(cpu); break;
+  case TYA: OP_TYA(cpu); break;
+
+  // the undefined opcodes of no width are the ones that jam the cpu; they
+  // take no cycles either, so running on would never reach a deadline
+  case BADOP: if(!width) cpu->finished = CPU_JAM; break;
+
+  default: break;
+  }
+
+  if(taken) cpu->pc = address;
+
+  /*
+   * The penalties, from the opcode's mask rather than by testing for
+   * them: a read pays for its index carrying, a branch for being taken
+   * and then for leaving the page.
+   */
+  int branch = taken & (penalties >> 1);
+  int extra = (crossed & penalties & PENALTY_PAGE) + branch + (branch & crossed);
+  cpu->clock += extra;
+}
+
+/*
+ * Executes a single whole instruction, decoding it through the table.
+ * Returns the cycles it took, counting any its writes stalled the cpu for.
+ */
+static int CORE_FN(execute)(struct cpu_info *cpu){
+  uint64_t start = cpu->clock;
+  uint8_t instr = FETCH8(cpu, cpu->pc);
+#ifdef CORE_BEFORE_INSTRUCTION
+  CORE_BEFORE_INSTRUCTION(cpu, instr);
+#endif
+  struct decode d = decode_table[instr];
+  CORE_FN(execute_decoded)(cpu, d.op, d.mode, d.cycles, d.width, d.penalties);
+  return cpu->clock - start;
+}
+
+#ifdef CORE_SUPERINSTRUCTIONS
+/*
+ * Superinstructions: the common sequences listed in 6502_super.h (which
+ * ricoh-mine generates from a profile) are run from a single dispatch,
+ * each with its decoding compiled in. After each instruction of one, the
+ * next opcode is checked against what the sequence expects, so it is
+ * only ever a guess at what follows and runs exactly as the plain loop
+ * would, stopping at the deadline too.
+ *
+ * A core opts in by defining CORE_SUPERINSTRUCTIONS, as long as reading
+ * an opcode twice is harmless for its memory.
+ */
+#define SUPER_STEP(op, mode, cycles, width, penalties)			\
+  CORE_FN(execute_decoded)(cpu, op, mode, cycles, width, penalties)
+
+#define SUPER_FIRST(opcode, op, mode, cycles, width, penalties)	\
+  case opcode: {							\
+  SUPER_STEP(op, mode, cycles, width, penalties);
+
+#define SUPER_NEXT(opcode, op, mode, cycles, width, penalties)		\
+  if(cpu->finished || cpu->clock >= deadline) break;			\
+  if(FETCH8(cpu, cpu->pc) == opcode){					\
+  SUPER_STEP(op, mode, cycles, width, penalties);
+
+#define SUPER_END break; }
+#endif
+
+// runs whole instructions until the clock reaches deadline
+static void CORE_FN(run)(struct cpu_info *cpu, uint64_t deadline){
+  while(!cpu->finished && cpu->clock < deadline){
+#ifdef CORE_SUPERINSTRUCTIONS
+    switch(FETCH8(cpu, cpu->pc)){
+#include "6502_super.h"
+    default: CORE_FN(execute)(cpu); break;
+    }
+#else
+    CORE_FN(execute)(cpu);
+#endif
+  }
+}
+
+const struct cpu_core CORE_FN(core) = {
+  CORE_FN(operand_address_at),
+  CORE_FN(execute),
+  CORE_FN(run)
+};
+
+#undef CORE_FN
+#undef CORE_EXPAND
+#undef CORE_PASTE
+#ifdef CORE_DEFAULT_FETCH
+#undef FETCH8
+#undef FETCH16
+#undef CORE_DEFAULT_FETCH
+#endif
+#ifdef CORE_SUPERINSTRUCTIONS
+#undef SUPER_STEP
+#undef SUPER_FIRST
+#undef SUPER_NEXT
+#undef SUPER_END
+#undef CORE_SUPERINSTRUCTIONS
+#endif
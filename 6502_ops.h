@@ -0,0 +1,382 @@
+#ifndef NES_CPU_OPS_H
+#define NES_CPU_OPS_H
+
+#include "6502.h"
+
+/*
+ * The semantics of the 6502 addressing modes and instructions, written as
+ * macros over a struct cpu_info pointer. The interpreter in 6502.c is built
+ * from these, and so is the C emitted by the static recompiler (aot.c), so
+ * the two can never disagree about what an instruction does.
+ *
+ * Memory is accessed through READ8/READ16/WRITE8, which default to the
+ * generic memory interface (writes through cpu_write8, so devices can
+ * stall the cpu). An includer may define them beforehand to
+ * access memory some other way.
+ *
+ * Instructions that only read their operand take its value; instructions
+ * that write back take its address.
+ */
+
+#ifndef READ8
+#define READ8(cpu, addr) read8((cpu)->mem, (addr))
+#endif
+#ifndef READ16
+#define READ16(cpu, addr) read16((cpu)->mem, (addr))
+#endif
+#ifndef WRITE8
+#define WRITE8(cpu, addr, val) cpu_write8((cpu), (addr), (val))
+#endif
+
+
+/*
+ * ============================================
+ * ADDRESSING
+ * ============================================
+ *
+ * abso, zp, imm and rel addresses only depend on the instruction bytes;
+ * the rest also depend on registers or memory.
+ */
+
+#define ADDR_ABX(cpu, base) ((uint16_t)((base) + (cpu)->x))
+#define ADDR_ABY(cpu, base) ((uint16_t)((base) + (cpu)->y))
+// indexing zero page wraps around within it
+#define ADDR_ZPX(cpu, zp) ((uint8_t)((zp) + (cpu)->x))
+#define ADDR_ZPY(cpu, zp) ((uint8_t)((zp) + (cpu)->y))
+// a pointer's high byte comes from the same page as its low byte (the
+// pointer is used twice, so should be a plain value)
+#define READ16_PAGE(cpu, ptr)						\
+  (READ8(cpu, (ptr)) | READ8(cpu, ((ptr) & 0xFF00) | (((ptr) + 1) & 0xFF)) << 8)
+#define ADDR_IND(cpu, ptr) READ16_PAGE(cpu, (uint16_t)(ptr))
+#define ADDR_IZX(cpu, zp) READ16_PAGE(cpu, ADDR_ZPX(cpu, zp))
+// (zp),y is abs,y from the pointer in page zero
+#define ADDR_IZY_BASE(cpu, zp) READ16_PAGE(cpu, (uint8_t)(zp))
+#define ADDR_IZY(cpu, zp) ADDR_ABY(cpu, ADDR_IZY_BASE(cpu, zp))
+
+/*
+ * 1 when an indexed address (or a branch target) is in a different page
+ * from its base. A carry or borrow into the high byte always flips its
+ * low bit, so this needs no comparison.
+ */
+#define PAGE_CROSSED(base, addr) ((((base) ^ (addr)) >> 8) & 1)
+
+
+/*
+ * ============================================
+ * STACK AND STATUS
+ * ============================================
+ *
+ * The stack lives in page one and grows down. These are also written in
+ * terms of READ8/WRITE8, so they get inlined into a specialised core.
+ */
+
+#define PUSH8(cpu, val)					\
+  do{							\
+    WRITE8(cpu, 0x100 | (cpu)->s, (val));		\
+    (cpu)->s--;						\
+  } while(0)
+
+#define PUSH16(cpu, val)				\
+  do{							\
+    uint16_t push_val = (val);				\
+    PUSH8(cpu, push_val >> 8);				\
+    PUSH8(cpu, push_val & 0xFF);			\
+  } while(0)
+
+#define PULL8(cpu) READ8(cpu, 0x100 | ++(cpu)->s)
+
+// pulls the low byte then the high byte into dest
+#define PULL16(cpu, dest)				\
+  do{							\
+    uint16_t pull_lo = PULL8(cpu);			\
+    uint16_t pull_hi = PULL8(cpu);			\
+    (dest) = (pull_hi << 8) | pull_lo;			\
+  } while(0)
+
+// the status register as a byte, b is the break flag (bits 5-4)
+#define STATUS_BYTE(cpu, b)						\
+  ((cpu)->N << 7 | (cpu)->V << 6 | (b) << 4 | (cpu)->D << 3 |		\
+   (cpu)->I << 2 | (cpu)->Z << 1 | (cpu)->C)
+
+#define SET_STATUS(cpu, val)				\
+  do{							\
+    uint8_t status_val = (val);				\
+    (cpu)->N = (status_val >> 7) & 1;			\
+    (cpu)->V = (status_val >> 6) & 1;			\
+    (cpu)->D = (status_val >> 3) & 1;			\
+    (cpu)->I = (status_val >> 2) & 1;			\
+    (cpu)->Z = (status_val >> 1) & 1;			\
+    (cpu)->C = status_val & 1;				\
+  } while(0)
+
+
+/*
+ * ============================================
+ * BRANCH CONDITIONS
+ * ============================================
+ */
+
+#define TAKEN_BCC(cpu) ((cpu)->C == 0)
+#define TAKEN_BCS(cpu) ((cpu)->C == 1)
+#define TAKEN_BEQ(cpu) ((cpu)->Z == 1)
+#define TAKEN_BMI(cpu) ((cpu)->N == 1)
+#define TAKEN_BNE(cpu) ((cpu)->Z == 0)
+#define TAKEN_BPL(cpu) ((cpu)->N == 0)
+#define TAKEN_BVC(cpu) ((cpu)->V == 0)
+#define TAKEN_BVS(cpu) ((cpu)->V == 1)
+
+
+/*
+ * ============================================
+ * INSTRUCTIONS
+ * ============================================
+ */
+
+#define SET_ZN(cpu, reg)			\
+  do{						\
+    (cpu)->Z = (reg) == 0 ? 1 : 0;		\
+    (cpu)->N = ((reg) >> 7) & 1;		\
+  } while(0)
+
+// sets dirty bit if visual mem is drawn to
+#define MARK_VISUAL(cpu, addr)					\
+  do{								\
+    if (((addr) >= 0x200) && ((addr) <= 0x5ff)) {		\
+      (cpu)->visual_dirty = 1;					\
+    }								\
+  } while(0)
+
+/*
+ * Binary add with carry. V is set when both operands have the same sign
+ * and the result's sign differs.
+ */
+#define ADD_WITH_CARRY(cpu, val)					\
+  do{									\
+    uint8_t add_val = (val);						\
+    unsigned sum = (cpu)->a + add_val + (cpu)->C;			\
+    (cpu)->V = ((~((cpu)->a ^ add_val) & ((cpu)->a ^ sum)) >> 7) & 1;	\
+    (cpu)->C = sum > 0xFF;						\
+    (cpu)->a = sum;							\
+    SET_ZN(cpu, (cpu)->a);						\
+  } while(0)
+
+/*
+ * Decimal mode as an NMOS 6502 does it (see Bruce Clark's decimal mode
+ * tutorial on 6502.org): each digit is corrected as it is added, N and V
+ * come from the sum before the high digit is corrected, and Z from the
+ * binary sum. SBC sets every flag as it would in binary.
+ */
+#define ADD_DECIMAL(cpu, val)						\
+  do{									\
+    uint8_t add_val = (val);						\
+    int lo = ((cpu)->a & 0x0F) + (add_val & 0x0F) + (cpu)->C;		\
+    if(lo >= 0x0A) lo = ((lo + 0x06) & 0x0F) + 0x10;			\
+    int sum = ((cpu)->a & 0xF0) + (add_val & 0xF0) + lo;		\
+    int signed_sum = (int8_t)((cpu)->a & 0xF0) + (int8_t)(add_val & 0xF0) + lo; \
+    (cpu)->Z = (((cpu)->a + add_val + (cpu)->C) & 0xFF) == 0;		\
+    (cpu)->N = (sum >> 7) & 1;						\
+    (cpu)->V = signed_sum < -128 || signed_sum > 127;			\
+    if(sum >= 0xA0) sum += 0x60;					\
+    (cpu)->C = sum >= 0x100;						\
+    (cpu)->a = sum;							\
+  } while(0)
+
+#define SUB_DECIMAL(cpu, val)						\
+  do{									\
+    uint8_t sub_val = (val);						\
+    int lo = ((cpu)->a & 0x0F) - (sub_val & 0x0F) + (cpu)->C - 1;	\
+    if(lo < 0) lo = ((lo - 0x06) & 0x0F) - 0x10;			\
+    int diff = ((cpu)->a & 0xF0) - (sub_val & 0xF0) + lo;		\
+    if(diff < 0) diff -= 0x60;						\
+    ADD_WITH_CARRY(cpu, (uint8_t)~sub_val);				\
+    (cpu)->a = diff;							\
+  } while(0)
+
+#define OP_ADC(cpu, val)						\
+  do{									\
+    if((cpu)->D && (cpu)->has_decimal) ADD_DECIMAL(cpu, val);		\
+    else ADD_WITH_CARRY(cpu, val);					\
+  } while(0)
+
+#define OP_AND(cpu, val)			\
+  do{						\
+    (cpu)->a = (cpu)->a & (val);		\
+    SET_ZN(cpu, (cpu)->a);			\
+  } while(0)
+
+// this is based on the old a so the carry needs to be first
+#define OP_ASL_A(cpu)				\
+  do{						\
+    (cpu)->C = ((cpu)->a >> 7) & 1;		\
+    (cpu)->a <<= 1;				\
+    SET_ZN(cpu, (cpu)->a);			\
+  } while(0)
+
+#define OP_ASL_M(cpu, addr)				\
+  do{							\
+    uint8_t old = READ8(cpu, addr);			\
+    uint8_t new = old << 1;				\
+    (cpu)->C = (old >> 7) & 1;				\
+    WRITE8(cpu, addr, new);				\
+    SET_ZN(cpu, new);					\
+  } while(0)
+
+#define OP_BIT(cpu, val)				\
+  do{							\
+    uint8_t bit_val = (val);				\
+    (cpu)->V = (bit_val >> 6) & 1;			\
+    (cpu)->N = (bit_val >> 7) & 1;			\
+    (cpu)->Z = ((cpu)->a & bit_val) == 0 ? 1 : 0;	\
+  } while(0)
+
+#define OP_COMPARE(cpu, reg, val)			\
+  do{							\
+    uint8_t cmp_val = (val);				\
+    (cpu)->C = (reg) >= cmp_val;			\
+    (cpu)->Z = (reg) == cmp_val;			\
+    (cpu)->N = (((reg) - cmp_val) >> 7) & 1;		\
+  } while(0)
+
+#define OP_CMP(cpu, val) OP_COMPARE(cpu, (cpu)->a, val)
+#define OP_CPX(cpu, val) OP_COMPARE(cpu, (cpu)->x, val)
+#define OP_CPY(cpu, val) OP_COMPARE(cpu, (cpu)->y, val)
+
+#define OP_DEC(cpu, addr)				\
+  do{							\
+    uint8_t dec_val = READ8(cpu, addr) - 1;		\
+    WRITE8(cpu, addr, dec_val);				\
+    SET_ZN(cpu, dec_val);				\
+  } while(0)
+
+#define OP_DEX(cpu) do{ (cpu)->x -= 1; SET_ZN(cpu, (cpu)->x); } while(0)
+#define OP_DEY(cpu) do{ (cpu)->y -= 1; SET_ZN(cpu, (cpu)->y); } while(0)
+
+#define OP_EOR(cpu, val)			\
+  do{						\
+    (cpu)->a = (cpu)->a ^ (val);		\
+    SET_ZN(cpu, (cpu)->a);			\
+  } while(0)
+
+#define OP_INC(cpu, addr)				\
+  do{							\
+    uint8_t inc_val = READ8(cpu, addr) + 1;		\
+    WRITE8(cpu, addr, inc_val);				\
+    SET_ZN(cpu, inc_val);				\
+  } while(0)
+
+#define OP_INX(cpu) do{ (cpu)->x += 1; SET_ZN(cpu, (cpu)->x); } while(0)
+#define OP_INY(cpu) do{ (cpu)->y += 1; SET_ZN(cpu, (cpu)->y); } while(0)
+
+//push the old pc -1 to stack (this is 16 bit)
+#define OP_JSR(cpu, next_pc) PUSH16(cpu, (next_pc) - 1)
+
+// BRK skips the byte after it, and pushes the status with B set
+#define OP_BRK(cpu, next_pc)				\
+  do{							\
+    PUSH16(cpu, (next_pc) + 1);				\
+    PUSH8(cpu, STATUS_BYTE(cpu, 0b11));			\
+    (cpu)->I = 1;					\
+    (cpu)->pc = READ16(cpu, IRQ_VECTOR);		\
+  } while(0)
+
+#define OP_LDA(cpu, val) do{ (cpu)->a = (val); SET_ZN(cpu, (cpu)->a); } while(0)
+#define OP_LDX(cpu, val) do{ (cpu)->x = (val); SET_ZN(cpu, (cpu)->x); } while(0)
+#define OP_LDY(cpu, val) do{ (cpu)->y = (val); SET_ZN(cpu, (cpu)->y); } while(0)
+
+// shift the accumulator
+#define OP_LSR_A(cpu)				\
+  do{						\
+    (cpu)->C = (cpu)->a & 1;			\
+    (cpu)->a >>= 1;				\
+    SET_ZN(cpu, (cpu)->a);			\
+  } while(0)
+
+#define OP_LSR_M(cpu, addr)				\
+  do{							\
+    uint8_t old = READ8(cpu, addr);			\
+    uint8_t new = old >> 1;				\
+    (cpu)->C = old & 1;					\
+    WRITE8(cpu, addr, new);				\
+    SET_ZN(cpu, new);					\
+  } while(0)
+
+#define OP_ORA(cpu, val)			\
+  do{						\
+    (cpu)->a = (cpu)->a | (val);		\
+    SET_ZN(cpu, (cpu)->a);			\
+  } while(0)
+
+#define OP_PHA(cpu) PUSH8(cpu, (cpu)->a)
+// PHP pushes B and bit 5 set, like BRK
+#define OP_PHP(cpu) PUSH8(cpu, STATUS_BYTE(cpu, 0b11))
+#define OP_PLA(cpu) do{ (cpu)->a = PULL8(cpu); SET_ZN(cpu, (cpu)->a); } while(0)
+#define OP_PLP(cpu) SET_STATUS(cpu, PULL8(cpu))
+
+// the rotates go through the carry, so are really 9 bit rotates
+#define OP_ROL_A(cpu)				\
+  do{						\
+    uint8_t val = (cpu)->a;			\
+    (cpu)->a = (val << 1) | (cpu)->C;		\
+    (cpu)->C = (val >> 7) & 1;			\
+    SET_ZN(cpu, (cpu)->a);			\
+  } while(0)
+
+#define OP_ROL_M(cpu, addr)			\
+  do{						\
+    uint8_t val = READ8(cpu, addr);		\
+    uint8_t working = (val << 1) | (cpu)->C;	\
+    WRITE8(cpu, addr, working);			\
+    (cpu)->C = (val >> 7) & 1;			\
+    SET_ZN(cpu, working);			\
+  } while(0)
+
+#define OP_ROR_A(cpu)				\
+  do{						\
+    uint8_t val = (cpu)->a;			\
+    (cpu)->a = (val >> 1) | ((cpu)->C << 7);	\
+    (cpu)->C = val & 1;				\
+    SET_ZN(cpu, (cpu)->a);			\
+  } while(0)
+
+#define OP_ROR_M(cpu, addr)				\
+  do{							\
+    uint8_t val = READ8(cpu, addr);			\
+    uint8_t working = (val >> 1) | ((cpu)->C << 7);	\
+    WRITE8(cpu, addr, working);				\
+    (cpu)->C = val & 1;					\
+    SET_ZN(cpu, working);				\
+  } while(0)
+
+#define OP_RTI(cpu)				\
+  do{						\
+    SET_STATUS(cpu, PULL8(cpu));		\
+    PULL16(cpu, (cpu)->pc);			\
+  } while(0)
+
+//pull the old pc -1 from the stack (this is 16 bit)
+#define OP_RTS(cpu)				\
+  do{						\
+    PULL16(cpu, (cpu)->pc);			\
+    (cpu)->pc++;				\
+  } while(0)
+
+// subtracting is adding the ones complement, with the carry as not borrow
+#define OP_SBC(cpu, val)						\
+  do{									\
+    if((cpu)->D && (cpu)->has_decimal) SUB_DECIMAL(cpu, val);		\
+    else ADD_WITH_CARRY(cpu, (uint8_t)~(val));				\
+  } while(0)
+
+#define OP_STA(cpu, addr) do{ WRITE8(cpu, addr, (cpu)->a); MARK_VISUAL(cpu, addr); } while(0)
+#define OP_STX(cpu, addr) do{ WRITE8(cpu, addr, (cpu)->x); MARK_VISUAL(cpu, addr); } while(0)
+#define OP_STY(cpu, addr) do{ WRITE8(cpu, addr, (cpu)->y); MARK_VISUAL(cpu, addr); } while(0)
+
+#define OP_TAX(cpu) do{ (cpu)->x = (cpu)->a; SET_ZN(cpu, (cpu)->x); } while(0)
+#define OP_TAY(cpu) do{ (cpu)->y = (cpu)->a; SET_ZN(cpu, (cpu)->y); } while(0)
+#define OP_TSX(cpu) do{ (cpu)->x = (cpu)->s; SET_ZN(cpu, (cpu)->x); } while(0)
+#define OP_TXA(cpu) do{ (cpu)->a = (cpu)->x; SET_ZN(cpu, (cpu)->a); } while(0)
+// the only transfer that leaves the flags alone
+#define OP_TXS(cpu) ((cpu)->s = (cpu)->x)
+#define OP_TYA(cpu) do{ (cpu)->a = (cpu)->y; SET_ZN(cpu, (cpu)->a); } while(0)
+
+#endif
@@ -0,0 +1,511 @@
+/*
+ * Superinstructions, generated by ricoh-mine from a profile of
+ *
+ *   binary/branching.bin
+ *   binary/carry.bin
+ *   binary/second.bin
+ *   binary/simple.bin
+ *   binary/snake.bin
+ *   binary/stack.bin
+ *
+ * do not edit (see 6502_core.h for what the macros do).
+ */
+
+SUPER_FIRST(0x00, BRK, noAddressMode, 7, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x01, ORA, izx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x05, ORA, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x06, ASL, zp, 5, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x08, PHP, noAddressMode, 3, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x09, ORA, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x0a, ASL, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x0d, ORA, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x0e, ASL, abso, 6, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x10, BPL, rel, 2, 2, 2)
+  SUPER_NEXT(0xb5, LDA, zpx, 4, 2, 0)
+    SUPER_NEXT(0x95, STA, zpx, 4, 2, 0) // 0.86%: BPL rel, LDA zpx, STA zpx
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0x11, ORA, izy, 5, 2, 1)
+SUPER_END
+
+SUPER_FIRST(0x15, ORA, zpx, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x16, ASL, zpx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x18, CLC, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x19, ORA, aby, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0x1d, ORA, abx, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0x1e, ASL, abx, 7, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x20, JSR, abso, 6, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x21, AND, izx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x24, BIT, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x25, AND, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x26, ROL, zp, 5, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x28, PLP, noAddressMode, 4, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x29, AND, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x2a, ROL, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x2c, BIT, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x2d, AND, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x2e, ROL, abso, 6, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x30, BMI, rel, 2, 2, 2)
+SUPER_END
+
+SUPER_FIRST(0x31, AND, izy, 5, 2, 1)
+SUPER_END
+
+SUPER_FIRST(0x35, AND, zpx, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x36, ROL, zpx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x38, SEC, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x39, AND, aby, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0x3d, AND, abx, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0x3e, ROL, abx, 7, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x40, RTI, noAddressMode, 6, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x41, EOR, izx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x45, EOR, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x46, LSR, zp, 5, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x48, PHA, noAddressMode, 3, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x49, EOR, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x4a, LSR, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x4c, JMP, abso, 3, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x4d, EOR, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x4e, LSR, abso, 6, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x50, BVC, rel, 2, 2, 2)
+SUPER_END
+
+SUPER_FIRST(0x51, EOR, izy, 5, 2, 1)
+SUPER_END
+
+SUPER_FIRST(0x55, EOR, zpx, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x56, LSR, zpx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x58, CLI, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x59, EOR, aby, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0x5d, EOR, abx, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0x5e, LSR, abx, 7, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x60, RTS, noAddressMode, 6, 1, 0)
+  SUPER_NEXT(0x20, JSR, abso, 6, 3, 0) // 1.13%: RTS noAddressMode, JSR abso
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0x61, ADC, izx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x65, ADC, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x66, ROR, zp, 5, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x68, PLA, noAddressMode, 4, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x69, ADC, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x6a, ROR, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x6c, JMP, ind, 5, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x6d, ADC, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x6e, ROR, abso, 6, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x70, BVS, rel, 2, 2, 2)
+SUPER_END
+
+SUPER_FIRST(0x71, ADC, izy, 5, 2, 1)
+SUPER_END
+
+SUPER_FIRST(0x75, ADC, zpx, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x76, ROR, zpx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x78, SEI, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x79, ADC, aby, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0x7d, ADC, abx, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0x7e, ROR, abx, 7, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x81, STA, izx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x84, STY, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x85, STA, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x86, STX, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x88, DEY, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x8a, TXA, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x8c, STY, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x8d, STA, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x8e, STX, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x90, BCC, rel, 2, 2, 2)
+SUPER_END
+
+SUPER_FIRST(0x91, STA, izy, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x94, STY, zpx, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x95, STA, zpx, 4, 2, 0)
+  SUPER_NEXT(0xca, DEX, noAddressMode, 2, 1, 0)
+    SUPER_NEXT(0x10, BPL, rel, 2, 2, 2) // 1.15%: STA zpx, DEX noAddressMode, BPL rel
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0x96, STX, zpy, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0x98, TYA, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x99, STA, aby, 5, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0x9a, TXS, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0x9d, STA, abx, 5, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xa0, LDY, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xa1, LDA, izx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xa2, LDX, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xa4, LDY, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xa5, LDA, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xa6, LDX, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xa8, TAY, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0xa9, LDA, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xaa, TAX, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0xac, LDY, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xad, LDA, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xae, LDX, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xb0, BCS, rel, 2, 2, 2)
+SUPER_END
+
+SUPER_FIRST(0xb1, LDA, izy, 5, 2, 1)
+SUPER_END
+
+SUPER_FIRST(0xb4, LDY, zpx, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xb5, LDA, zpx, 4, 2, 0)
+  SUPER_NEXT(0x95, STA, zpx, 4, 2, 0)
+    SUPER_NEXT(0xca, DEX, noAddressMode, 2, 1, 0) // 1.15%: LDA zpx, STA zpx, DEX noAddressMode
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0xb6, LDX, zpy, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xb8, CLV, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0xb9, LDA, aby, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0xba, TSX, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0xbc, LDY, abx, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0xbd, LDA, abx, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0xbe, LDX, aby, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0xc0, CPY, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xc1, CMP, izx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xc4, CPY, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xc5, CMP, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xc6, DEC, zp, 5, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xc8, INY, noAddressMode, 2, 1, 0)
+  SUPER_NEXT(0xc0, CPY, imm, 2, 2, 0)
+    SUPER_NEXT(0xd0, BNE, rel, 2, 2, 2) // 0.61%: INY noAddressMode, CPY imm, BNE rel
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0xc9, CMP, imm, 2, 2, 0)
+  SUPER_NEXT(0xf0, BEQ, rel, 2, 2, 2)
+    SUPER_NEXT(0xc9, CMP, imm, 2, 2, 0) // 0.86%: CMP imm, BEQ rel, CMP imm
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0xca, DEX, noAddressMode, 2, 1, 0)
+  SUPER_NEXT(0x10, BPL, rel, 2, 2, 2)
+    SUPER_NEXT(0xb5, LDA, zpx, 4, 2, 0) // 0.86%: DEX noAddressMode, BPL rel, LDA zpx
+    SUPER_END
+  SUPER_END
+  SUPER_NEXT(0xd0, BNE, rel, 2, 2, 2) // 45.62%: DEX noAddressMode, BNE rel
+    SUPER_NEXT(0xea, NOP, noAddressMode, 2, 1, 0) // 68.16%: DEX noAddressMode, BNE rel, NOP noAddressMode
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0xcc, CPY, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xcd, CMP, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xce, DEC, abso, 6, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xd0, BNE, rel, 2, 2, 2)
+  SUPER_NEXT(0xea, NOP, noAddressMode, 2, 1, 0) // 45.44%: BNE rel, NOP noAddressMode
+    SUPER_NEXT(0xea, NOP, noAddressMode, 2, 1, 0) // 68.16%: BNE rel, NOP noAddressMode, NOP noAddressMode
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0xd1, CMP, izy, 5, 2, 1)
+SUPER_END
+
+SUPER_FIRST(0xd5, CMP, zpx, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xd6, DEC, zpx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xd8, CLD, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0xd9, CMP, aby, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0xdd, CMP, abx, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0xde, DEC, abx, 7, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xe0, CPX, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xe1, SBC, izx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xe4, CPX, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xe5, SBC, zp, 3, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xe6, INC, zp, 5, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xe8, INX, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0xe9, SBC, imm, 2, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xea, NOP, noAddressMode, 2, 1, 0)
+  SUPER_NEXT(0xca, DEX, noAddressMode, 2, 1, 0) // 45.62%: NOP noAddressMode, DEX noAddressMode
+    SUPER_NEXT(0xd0, BNE, rel, 2, 2, 2) // 68.43%: NOP noAddressMode, DEX noAddressMode, BNE rel
+    SUPER_END
+  SUPER_END
+  SUPER_NEXT(0xea, NOP, noAddressMode, 2, 1, 0) // 45.62%: NOP noAddressMode, NOP noAddressMode
+    SUPER_NEXT(0xca, DEX, noAddressMode, 2, 1, 0) // 68.43%: NOP noAddressMode, NOP noAddressMode, DEX noAddressMode
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0xec, CPX, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xed, SBC, abso, 4, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xee, INC, abso, 6, 3, 0)
+SUPER_END
+
+SUPER_FIRST(0xf0, BEQ, rel, 2, 2, 2)
+  SUPER_NEXT(0xc9, CMP, imm, 2, 2, 0)
+    SUPER_NEXT(0xf0, BEQ, rel, 2, 2, 2) // 0.86%: BEQ rel, CMP imm, BEQ rel
+    SUPER_END
+  SUPER_END
+SUPER_END
+
+SUPER_FIRST(0xf1, SBC, izy, 5, 2, 1)
+SUPER_END
+
+SUPER_FIRST(0xf5, SBC, zpx, 4, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xf6, INC, zpx, 6, 2, 0)
+SUPER_END
+
+SUPER_FIRST(0xf8, SED, noAddressMode, 2, 1, 0)
+SUPER_END
+
+SUPER_FIRST(0xf9, SBC, aby, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0xfd, SBC, abx, 4, 3, 1)
+SUPER_END
+
+SUPER_FIRST(0xfe, INC, abx, 7, 3, 0)
+SUPER_END
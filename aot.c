@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "6502.h"
+
+/*
+ * ricoh-aot: an ahead of time recompiler from 6502 binaries to C.
+ *
+ * The image is disassembled from its entry point using the decode tables
+ * in 6502.c, following branches, jumps and subroutine calls to find all of
+ * the statically reachable code. Each basic block becomes a label in a
+ * single C function, aot_run(), and control flow between blocks becomes
+ * direct gotos. The instructions themselves are emitted as the macros
+ * from 6502_ops.h, so the compiled code behaves exactly like the
+ * interpreter and still goes through the memory interface.
+ *
+ * Anything that can't be resolved statically (RTS, RTI, JMP (ind)) goes
+ * through a dispatch switch on the pc, which falls back to the
+ * interpreter for addresses that aren't compiled. Stores into the code
+ * range are checked, and bail out with AOT_STALE (see aot.h).
+ *
+ * The output is linked with aot_main.c to get a runnable program:
+ *    ./ricoh-aot binary/snake.bin > snake.c
+ */
+
+#define MEM_SIZE 0x10000
+
+static uint8_t image[MEM_SIZE];
+static int load = 0x0600;
+static int image_len = 0;
+
+// instruction starts found by the traversal
+static uint8_t reached[MEM_SIZE];
+// addresses that start a basic block, and so get a label
+static uint8_t leader[MEM_SIZE];
+
+static int code_lo = MEM_SIZE, code_hi = 0;
+
+
+static int in_image(int addr){
+  return addr >= load && addr < load + image_len;
+}
+
+static int is_branch(enum OpCode op){
+  switch(op){
+  case BCC: case BCS: case BEQ: case BMI:
+  case BNE: case BPL: case BVC: case BVS:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static int writes_memory(enum OpCode op, enum AddressMode mode){
+  switch(op){
+  case STA: case STX: case STY: case INC: case DEC:
+    return 1;
+  case ASL: case LSR: case ROL: case ROR:
+    return mode != noAddressMode;
+  default:
+    return 0;
+  }
+}
+
+// instructions we don't compile are left to the interpreter
+static int compilable(int addr){
+  uint8_t instr = image[addr];
+  return decode_table[instr].op != BADOP && decode_table[instr].width > 0 &&
+    in_image(addr + decode_table[instr].width - 1);
+}
+
+static int operand8(int addr){
+  return image[(addr + 1) & 0xFFFF];
+}
+
+static int operand16(int addr){
+  return operand8(addr) | (image[(addr + 2) & 0xFFFF] << 8);
+}
+
+static int branch_target(int addr){
+  return (addr + 2 + (int8_t)operand8(addr)) & 0xFFFF;
+}
+
+// does control carry on to the next instruction?
+static int falls_through(int addr){
+  if(!compilable(addr)) return 0;
+  switch(decode_table[image[addr]].op){
+  case JMP: case JSR: case RTS: case RTI: case BRK:
+    return 0;
+  default:
+    return 1;
+  }
+}
+
+
+/*
+ * ============================================
+ * FINDING CODE
+ * ============================================
+ */
+
+static int *worklist;
+static int work_count = 0;
+
+static void add_target(int addr){
+  if(!in_image(addr)) return;
+  leader[addr] = 1;
+  if(!reached[addr]){
+    worklist[work_count++] = addr;
+  }
+}
+
+static void trace(int entry){
+  worklist = malloc(MEM_SIZE * 2 * sizeof(int));
+  add_target(entry);
+
+  while(work_count){
+    int addr = worklist[--work_count];
+
+    while(in_image(addr) && !reached[addr]){
+      reached[addr] = 1;
+      if(addr < code_lo) code_lo = addr;
+      if(!compilable(addr)){
+	if(addr + 1 > code_hi) code_hi = addr + 1;
+	break;
+      }
+
+      uint8_t instr = image[addr];
+      enum OpCode op = decode_table[instr].op;
+      int next = addr + decode_table[instr].width;
+      if(next > code_hi) code_hi = next;
+
+      if(is_branch(op)){
+	add_target(branch_target(addr));
+	add_target(next);
+      } else if(op == JMP && decode_table[instr].mode == abso){
+	add_target(operand16(addr));
+      } else if(op == JSR){
+	add_target(operand16(addr));
+	// where the subroutine returns to
+	add_target(next);
+      }
+
+      if(!falls_through(addr)) break;
+      addr = next;
+    }
+  }
+  free(worklist);
+
+  // make sure fall through always lands on a labelled instruction when
+  // the next instruction in address order isn't the one we fall into
+  for(int addr = code_lo; addr < code_hi; addr++){
+    if(!reached[addr] || !falls_through(addr)) continue;
+    int next = addr + decode_table[image[addr]].width;
+    int following = addr + 1;
+    while(following < code_hi && !reached[following]) following++;
+    if(following != next) leader[next] = 1;
+  }
+}
+
+
+/*
+ * ============================================
+ * EMITTING C
+ * ============================================
+ */
+
+static void emit_goto(FILE *out, int target){
+  if(reached[target] && leader[target] && in_image(target)){
+    fprintf(out, "goto L_%04x;", target);
+  } else{
+    fprintf(out, "{ cpu->pc = 0x%04x; goto dispatch; }", target);
+  }
+}
+
+// what the compiled instructions of a block (or the rest of one) cost
+struct cost{
+  int cycles;
+  int instructions;
+};
+
+static struct cost block_cost(int addr){
+  struct cost cost = { 0, 0 };
+  for(;;){
+    if(!compilable(addr)) return cost;
+    cost.cycles += decode_table[image[addr]].cycles;
+    cost.instructions++;
+    if(!falls_through(addr) || is_branch(decode_table[image[addr]].op)){
+      return cost;
+    }
+    addr += decode_table[image[addr]].width;
+    if(leader[addr] || !reached[addr]) return cost;
+  }
+}
+
+static void emit_address(FILE *out, int addr, enum AddressMode mode){
+  switch(mode){
+  case abso: fprintf(out, "0x%04x", operand16(addr)); break;
+  case zp:   fprintf(out, "0x%02x", operand8(addr)); break;
+  case abx:  fprintf(out, "ADDR_ABX(cpu, 0x%04x)", operand16(addr)); break;
+  case aby:  fprintf(out, "ADDR_ABY(cpu, 0x%04x)", operand16(addr)); break;
+  case zpx:  fprintf(out, "ADDR_ZPX(cpu, 0x%02x)", operand8(addr)); break;
+  case zpy:  fprintf(out, "ADDR_ZPY(cpu, 0x%02x)", operand8(addr)); break;
+  case izx:  fprintf(out, "ADDR_IZX(cpu, 0x%02x)", operand8(addr)); break;
+  case izy:  fprintf(out, "ADDR_IZY(cpu, 0x%02x)", operand8(addr)); break;
+  case ind:  fprintf(out, "ADDR_IND(cpu, 0x%04x)", operand16(addr)); break;
+  default:   fprintf(out, "0"); break;
+  }
+}
+
+static int constant_address(enum AddressMode mode){
+  return mode == abso || mode == zp || mode == noAddressMode;
+}
+
+static int constant_value(int addr, enum AddressMode mode){
+  switch(mode){
+  case abso: return operand16(addr);
+  case zp:   return operand8(addr);
+  default:   return 0;
+  }
+}
+
+static void emit_instruction(FILE *out, int addr, struct cost remaining){
+  uint8_t instr = image[addr];
+  enum OpCode op = decode_table[instr].op;
+  enum AddressMode mode = decode_table[instr].mode;
+  int next = addr + decode_table[instr].width;
+  const char *name = opcode_strings[op];
+
+  fprintf(out, "  /* %04x: %s %s */\n", addr, name, addressMode_strings[mode]);
+
+  if(!compilable(addr)){
+    fprintf(out, "  cpu->pc = 0x%04x; goto interpret;\n", addr);
+    return;
+  }
+
+  switch(op){
+  case BCC: case BCS: case BEQ: case BMI:
+  case BNE: case BPL: case BVC: case BVS:
+    // the target is fixed, so so is whether taking it crosses a page
+    fprintf(out, "  if(TAKEN_%s(cpu)){ cpu->clock += %d; ", name,
+	    1 + ((next ^ branch_target(addr)) >> 8 & 1));
+    emit_goto(out, branch_target(addr));
+    fprintf(out, " }\n");
+    return;
+  case JMP:
+    if(mode == abso){
+      fprintf(out, "  ");
+      emit_goto(out, operand16(addr));
+    } else{
+      fprintf(out, "  cpu->pc = ");
+      emit_address(out, addr, mode);
+      fprintf(out, "; goto dispatch;");
+    }
+    fprintf(out, "\n");
+    return;
+  case JSR:
+    fprintf(out, "  OP_JSR(cpu, 0x%04x); ", next);
+    emit_goto(out, operand16(addr));
+    fprintf(out, "\n");
+    return;
+  case RTS: case RTI:
+    fprintf(out, "  OP_%s(cpu); goto dispatch;\n", name);
+    return;
+  case BRK:
+    fprintf(out, "  if(cpu->stop_on_brk){ cpu->pc = 0x%04x; cpu->finished = CPU_BRK; return AOT_DONE; }\n",
+	    next);
+    fprintf(out, "  OP_BRK(cpu, 0x%04x); goto dispatch;\n", next);
+    return;
+  case NOP:
+    return;
+  case CLC: fprintf(out, "  cpu->C = 0;\n"); return;
+  case CLD: fprintf(out, "  cpu->D = 0;\n"); return;
+  case CLI: fprintf(out, "  cpu->I = 0;\n"); return;
+  case CLV: fprintf(out, "  cpu->V = 0;\n"); return;
+  case SEC: fprintf(out, "  cpu->C = 1;\n"); return;
+  case SED: fprintf(out, "  cpu->D = 1;\n"); return;
+  case SEI: fprintf(out, "  cpu->I = 1;\n"); return;
+  case DEX: case DEY: case INX: case INY:
+  case PHA: case PHP: case PLA: case PLP:
+  case TAX: case TAY: case TSX: case TXA: case TXS: case TYA:
+    fprintf(out, "  OP_%s(cpu);\n", name);
+    return;
+  default:
+    break;
+  }
+
+  // immediate operands are folded into the code
+  if(mode == imm){
+    fprintf(out, "  OP_%s(cpu, 0x%02x);\n", name, operand8(addr));
+    return;
+  }
+
+  // everything else works on an operand in memory
+  if(decode_table[instr].penalties & PENALTY_PAGE){
+    // a read that pays for its index carrying, which only shows at run time
+    if(mode == izy){
+      fprintf(out, "  { uint16_t base = ADDR_IZY_BASE(cpu, 0x%02x); ", operand8(addr));
+    } else{
+      fprintf(out, "  { uint16_t base = 0x%04x; ", operand16(addr));
+    }
+    fprintf(out, "uint16_t ea = ADDR_AB%c(cpu, base); ", mode == abx ? 'X' : 'Y');
+    fprintf(out, "cpu->clock += PAGE_CROSSED(base, ea); ");
+  } else{
+    fprintf(out, "  { uint16_t ea = ");
+    emit_address(out, addr, mode);
+    fprintf(out, "; ");
+  }
+
+  switch(op){
+  case ASL: case LSR: case ROL: case ROR:
+    if(mode == noAddressMode){
+      fprintf(out, "(void)ea; OP_%s_A(cpu);", name);
+    } else{
+      fprintf(out, "OP_%s_M(cpu, ea);", name);
+    }
+    break;
+  case DEC: case INC: case STA: case STX: case STY:
+    fprintf(out, "OP_%s(cpu, ea);", name);
+    break;
+  default:
+    fprintf(out, "OP_%s(cpu, READ8(cpu, ea));", name);
+    break;
+  }
+
+  // a store into our own code means the compiled code is stale
+  if(writes_memory(op, mode)){
+    int bail = 0;
+    if(constant_address(mode)){
+      int target = constant_value(addr, mode);
+      bail = target >= code_lo && target < code_hi;
+    }
+    if(bail || !constant_address(mode)){
+      fprintf(out, "\n    ");
+      if(!bail){
+	fprintf(out, "if((uint16_t)(ea - CODE_LO) < CODE_LEN)");
+      }
+      fprintf(out, "{ cpu->clock -= %d; cpu->instructions -= %d; "
+	      "cpu->pc = 0x%04x; return AOT_STALE; }",
+	      remaining.cycles, remaining.instructions, next);
+    }
+  }
+  fprintf(out, " }\n");
+}
+
+static void emit(FILE *out, const char *source){
+  fprintf(out, "/*\n * Generated by ricoh-aot from %s, do not edit.\n */\n\n", source);
+  // see aot.h: stores go straight to memory
+  fprintf(out, "#define WRITE8(cpu, addr, val) write8((cpu)->mem, (addr), (val))\n");
+  fprintf(out, "#include \"6502_ops.h\"\n#include \"aot.h\"\n\n");
+  fprintf(out, "#define CODE_LO 0x%04x\n#define CODE_LEN 0x%04x\n\n",
+	  code_lo, code_hi - code_lo);
+
+  fprintf(out, "const uint16_t aot_load = 0x%04x;\n", load);
+  fprintf(out, "const int aot_image_len = %d;\n", image_len);
+  fprintf(out, "const uint8_t aot_image[] = {");
+  for(int i = 0; i < image_len; i++){
+    fprintf(out, "%s0x%02x,", i % 12 ? " " : "\n  ", image[load + i]);
+  }
+  fprintf(out, "\n};\n\n");
+
+  fprintf(out, "int aot_run(struct cpu_info *cpu, uint64_t until){\n");
+  fprintf(out, " dispatch:\n  switch(cpu->pc){\n");
+  for(int addr = code_lo; addr < code_hi; addr++){
+    if(reached[addr] && leader[addr]){
+      fprintf(out, "  case 0x%04x: goto L_%04x;\n", addr, addr);
+    }
+  }
+  fprintf(out, "  default: goto interpret;\n  }\n\n");
+
+  // the interpreter fallback, for anything we don't have compiled
+  fprintf(out, " interpret:\n");
+  fprintf(out, "  if(cpu->finished || cpu->clock >= until) return AOT_DONE;\n");
+  // it may have stopped the cpu (a jam opcode, say), which the compiled
+  // blocks don't check for
+  fprintf(out, "  execute_instruction(cpu);\n"
+	  "  if(cpu->finished) return AOT_DONE;\n  goto dispatch;\n\n");
+
+  struct cost remaining = { 0, 0 };
+  for(int addr = code_lo; addr < code_hi; addr++){
+    if(!reached[addr]) continue;
+    if(leader[addr]){
+      /*
+       * Each block checks the budget on entry and is then charged its
+       * cycles and instructions up front; that is all the bookkeeping it
+       * needs.
+       */
+      remaining = block_cost(addr);
+      fprintf(out, "\n L_%04x:\n", addr);
+      fprintf(out, "  if(cpu->clock >= until){ cpu->pc = 0x%04x; return AOT_DONE; }\n",
+	      addr);
+      if(remaining.instructions){
+	fprintf(out, "  cpu->clock += %d; cpu->instructions += %d;\n",
+		remaining.cycles, remaining.instructions);
+      }
+    }
+    if(compilable(addr)){
+      remaining.cycles -= decode_table[image[addr]].cycles;
+      remaining.instructions--;
+    }
+    emit_instruction(out, addr, remaining);
+
+    if(falls_through(addr)){
+      int next = addr + decode_table[image[addr]].width;
+      int following = addr + 1;
+      while(following < code_hi && !reached[following]) following++;
+      if(following != next || !reached[next]){
+	fprintf(out, "  ");
+	emit_goto(out, next);
+	fprintf(out, "\n");
+      }
+    }
+  }
+  fprintf(out, "}\n");
+}
+
+
+static void usage(const char *name){
+  fprintf(stderr, "usage: %s [-l load_address] [-o out.c] image.bin\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv){
+  const char *out_name = NULL;
+  int opt;
+  while((opt = getopt(argc, argv, "l:o:")) != -1){
+    switch(opt){
+    case 'l': load = strtol(optarg, NULL, 0) & 0xFFFF; break;
+    case 'o': out_name = optarg; break;
+    default: usage(argv[0]);
+    }
+  }
+  if(optind >= argc) usage(argv[0]);
+
+  FILE *file = fopen(argv[optind], "rb");
+  if(!file){
+    perror(argv[optind]);
+    return 1;
+  }
+  image_len = fread(image + load, 1, MEM_SIZE - load, file);
+  fclose(file);
+
+  trace(load);
+  if(code_lo >= code_hi){
+    fprintf(stderr, "%s: no reachable code\n", argv[optind]);
+    return 1;
+  }
+
+  FILE *out = out_name ? fopen(out_name, "w") : stdout;
+  if(!out){
+    perror(out_name);
+    return 1;
+  }
+  emit(out, argv[optind]);
+  if(out != stdout) fclose(out);
+  return 0;
+}
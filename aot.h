@@ -0,0 +1,35 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+
+#include "6502.h"
+
+/*
+ * The interface of a program compiled by ricoh-aot (see aot.c).
+ *
+ * aot_run() runs the compiled program from cpu->pc until the cpu clock
+ * reaches until or the program finishes, leaving the cpu exactly as the
+ * interpreter would. Code outside the compiled image, and indirect jumps
+ * to addresses that don't start a compiled block, are interpreted.
+ *
+ * If the program writes over its own compiled code aot_run() returns
+ * AOT_STALE with the cpu stopped after the offending instruction; the
+ * compiled code can't be trusted from then on and the caller should keep
+ * going with the interpreter.
+ *
+ * The compiled code stores straight to memory, without telling the
+ * memory's devices (see store_I in memory.h), so it is only for memories
+ * that have none, like the easy 6502 one it is built for.
+ */
+
+#define AOT_DONE  0
+#define AOT_STALE 1
+
+extern const uint8_t aot_image[];
+extern const int aot_image_len;
+extern const uint16_t aot_load;
+
+int aot_run(struct cpu_info *cpu, uint64_t until);
+
+#endif
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "6502.h"
+#include "sched.h"
+#include "aot.h"
+#include "counter.h"
+
+/*
+ * Runs a program compiled by ricoh-aot on the easy 6502 machine, or the
+ * same program on the interpreter (-i) for comparison. The program is run
+ * from a fresh machine -n times so short programs can be timed; only the
+ * time spent running is counted, not resetting the machine.
+ *
+ * Besides the speed, it reports how often the emulator's own reads missed
+ * the L1 data cache while it ran, where the machine lets us count them.
+ */
+
+static double now(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void reset(struct cpu_info *cpu, struct memory *mem){
+  static const uint8_t zeros[2048];
+  mem_write_block(mem, 0, zeros, sizeof(zeros));
+  mem_write_block(mem, aot_load, aot_image, aot_image_len);
+  init_cpu_info(cpu, mem);
+  cpu->pc = aot_load;
+  cpu->s = 0xFF;
+}
+
+int main(int argc, char **argv){
+  int interpret = 0;
+  int repeat = 1;
+  uint64_t max_cycles = 10000000;
+  int opt;
+  while((opt = getopt(argc, argv, "in:c:")) != -1){
+    switch(opt){
+    case 'i': interpret = 1; break;
+    case 'n': repeat = atoi(optarg); break;
+    case 'c': max_cycles = strtoull(optarg, NULL, 0); break;
+    default:
+      fprintf(stderr, "usage: %s [-i] [-n repeat] [-c max_cycles]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  struct memory *mem = make_flat_2k_mem();
+  struct scheduler sched;
+  init_scheduler(&sched);
+  struct cpu_info cpu;
+  uint64_t total = 0;
+  uint64_t instructions = 0;
+  uint64_t misses = 0;
+  int stale = 0;
+  int l1d = counter_open_l1d_misses();
+
+  double elapsed = 0;
+  for(int i = 0; i < repeat; i++){
+    reset(&cpu, mem);
+    double start = now();
+    counter_start(l1d);
+    int compiled = !interpret;
+    while(!cpu.finished && cpu.clock < max_cycles){
+      if(compiled){
+	if(aot_run(&cpu, max_cycles) == AOT_STALE){
+	  compiled = 0;
+	  stale++;
+	}
+      } else{
+	run_until(&cpu, &sched, max_cycles);
+      }
+    }
+    misses += counter_stop(l1d);
+    elapsed += now() - start;
+    total += cpu.clock;
+    instructions += cpu.instructions;
+  }
+
+  uint32_t hash = 2166136261u;
+  for(int i = 0; i < 2048; i++){
+    hash = (hash ^ read8(mem, i)) * 16777619u;
+  }
+
+  printf("%s: a %x, x %x, y %x, pc %x, s %x, ram %08x\n",
+	 interpret ? "interpreted" : "compiled",
+	 cpu.a, cpu.x, cpu.y, cpu.pc, cpu.s, hash);
+  printf("%llu cycles, %llu instructions over %d runs, in %.3fs (%.1f MHz)",
+	 (unsigned long long)total, (unsigned long long)instructions, repeat,
+	 elapsed, total / elapsed / 1e6);
+  if(stale) printf(", fell back to the interpreter %d times", stale);
+  printf("\n");
+  printf("%.1f million instructions/s", instructions / elapsed / 1e6);
+  if(l1d >= 0){
+    printf(", %llu L1d read misses (%.4f per instruction)\n",
+	   (unsigned long long)misses, (double)misses / instructions);
+  } else{
+    printf(", L1d misses not counted (no hardware counters)\n");
+  }
+  counter_close(l1d);
+  return 0;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "6502.h"
+#include "sched.h"
+#include "machine.h"
+#include "paged_memory.h"
+#include "screen.h"
+#include "task.h"
+
+/*
+ * ricoh-batch: runs many instances of one easy 6502 program at once, and
+ * reports how much resident memory each instance costs, after they are
+ * made and after they have run, and how fast they ran.
+ *
+ * By default the instances share the program through copy-on-write
+ * memory (see paged_memory.h); -m flat gives each a flat memory of its
+ * own instead, for comparison. -s is the size of the address space, 0x800
+ * (the easy 6502's) or up to 0x10000.
+ *
+ * The instances take turns on this one thread (see task.h), -q frames
+ * at a time, with a new random number each turn, until each has run -f
+ * frames, stopped, or is left waiting on a key press it will never get.
+ */
+
+#define DEFAULT_MACHINES 10000
+#define DEFAULT_FRAMES 1000
+#define DEFAULT_SLICE 60
+#define DEFAULT_LOAD 0x0600
+
+static double now(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// the bytes of this process that are in memory, or 0 if unknown
+static size_t resident(){
+  FILE *file = fopen("/proc/self/statm", "r");
+  if(!file) return 0;
+  unsigned long size, pages = 0;
+  if(fscanf(file, "%lu %lu", &size, &pages) != 2) pages = 0;
+  fclose(file);
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+static void usage(const char *name){
+  fprintf(stderr,
+	  "usage: %s [-n machines] [-f frames] [-q frames_per_turn] [-m paged|flat]\n"
+	  "          [-s size] [-l load_addr] program.bin\n", name);
+  exit(1);
+}
+
+// a new random number each turn, as gui gives one each frame
+static void next_random(struct task *task){
+  write8(task->cpu->mem, 0xfe, rand() % 256);
+}
+
+int main(int argc, char **argv){
+  int count = DEFAULT_MACHINES;
+  long frames = DEFAULT_FRAMES;
+  long slice = DEFAULT_SLICE;
+  int paged = 1;
+  size_t size = 0x800;
+  int load = DEFAULT_LOAD;
+  int opt;
+  while((opt = getopt(argc, argv, "n:f:q:m:s:l:")) != -1){
+    switch(opt){
+    case 'n': count = atoi(optarg); break;
+    case 'f': frames = atol(optarg); break;
+    case 'q': slice = atol(optarg); break;
+    case 'm':
+      if(!strcmp(optarg, "flat")) paged = 0;
+      else if(strcmp(optarg, "paged")) usage(argv[0]);
+      break;
+    case 's': size = strtoul(optarg, NULL, 0); break;
+    case 'l': load = strtol(optarg, NULL, 16); break;
+    default: usage(argv[0]);
+    }
+  }
+  if(optind >= argc || count < 1 || slice < 1 || load < 0 || load > 0xFFFF ||
+     size < 0x100 || size > 0x10000 || (size & (size - 1))) usage(argv[0]);
+  // the flat memories only come in two sizes
+  if(!paged && size != 0x800 && size != 0x10000) usage(argv[0]);
+
+  FILE *file = fopen(argv[optind], "r");
+  if(!file){
+    perror(argv[optind]);
+    return 1;
+  }
+  static uint8_t program[0x10000];
+  size_t len = fread(program, 1, sizeof(program) - load, file);
+  fclose(file);
+
+  struct page_image *image = NULL;
+  if(paged){
+    image = page_image_create(size, load, program, len);
+    if(!image){
+      perror("page image");
+      return 1;
+    }
+  }
+
+  struct machine **machines = calloc(count, sizeof(struct machine *));
+  struct task *tasks = calloc(count, sizeof(struct task));
+  if(!machines || !tasks){
+    perror("machines");
+    return 1;
+  }
+  struct scheduler sched;
+  init_scheduler(&sched);
+  struct task_runner runner;
+  if(task_runner_init(&runner, slice * CYCLES_PER_FRAME, size) < 0){
+    perror("task runner");
+    return 1;
+  }
+  size_t before = resident();
+  for(int i = 0; i < count; i++){
+    struct memory *mem = paged ? make_paged_mem(image) :
+      size == 0x800 ? make_flat_2k_mem() : make_flat_64k_mem();
+    if(mem) machines[i] = machine_create(mem);
+    if(!machines[i]){
+      perror("machine");
+      return 1;
+    }
+    struct cpu_info *cpu = &machines[i]->cpu;
+    if(!paged) mem_write_block(cpu->mem, load, program, len);
+    cpu->pc = load;
+    cpu->s = 0xFF;
+
+    // none of them has any events, so they can share a scheduler
+    task_init(&tasks[i], cpu, &sched, 1);
+    tasks[i].until = frames * CYCLES_PER_FRAME;
+    tasks[i].resume = next_random;
+    task_add_input(&tasks[i], 0xfe);
+    task_add_input(&tasks[i], 0xff);
+    task_add(&runner, &tasks[i]);
+  }
+  size_t created = resident();
+
+  double began = now();
+  uint64_t turns = task_run(&runner, UINT64_MAX);
+  double elapsed = now() - began;
+  size_t ran = resident();
+  uint64_t cycles = 0;
+  for(int i = 0; i < count; i++){
+    cycles += machines[i]->cpu.clock;
+  }
+
+  printf("%d machines, %#zx bytes of %s memory each\n", count, size,
+	 paged ? "paged" : "flat");
+  printf("made:     %8.0f bytes resident each\n", (double)(created - before) / count);
+  printf("after %ld frames: %8.0f bytes resident each", frames, (double)(ran - before) / count);
+  if(paged){
+    long owned = 0;
+    for(int i = 0; i < count; i++){
+      owned += paged_mem_owned(machines[i]->cpu.mem);
+    }
+    printf(", %.1f of %zu pages their own", (double)owned / count, size / 0x100);
+  }
+  printf("\n%llu turns, %d left waiting for a key\n", (unsigned long long)turns,
+	 runner.parked_count);
+  printf("%llu cycles in %.3fs (%.1f MHz)\n", (unsigned long long)cycles, elapsed,
+	 elapsed > 0 ? cycles / elapsed / 1e6 : 0.0);
+
+  for(int i = 0; i < count; i++){
+    task_remove(&runner, &tasks[i]);
+    machine_free(machines[i]);
+  }
+  free(tasks);
+  free(machines);
+  task_runner_free(&runner);
+  free_scheduler(&sched);
+  if(image) page_image_free(image);
+  return 0;
+}
@@ -0,0 +1,225 @@
+#include <string.h>
+#include <immintrin.h>
+
+#include "blit.h"
+
+/*
+ * The scalar implementation, which the others fall back on for whatever
+ * they have no vector code for.
+ */
+static int scalar_supported(void){
+  return 1;
+}
+
+static void scalar_convert(const uint8_t *index, uint32_t *out, int count,
+			   const uint32_t *palette, int mask){
+  for(int i = 0; i < count; i++){
+    out[i] = palette[index[i] & mask];
+  }
+}
+
+static void scalar_widen(const uint32_t *src, uint32_t *dst, int count, int scale){
+  for(int i = 0; i < count; i++){
+    for(int k = 0; k < scale; k++){
+      *dst++ = src[i];
+    }
+  }
+}
+
+/*
+ * SSE: pshufb (SSSE3) looks up 16 indices at once in a palette of up to
+ * 16 colours, held as four 16 byte tables, one per byte of the colour.
+ * The bytes looked up are then interleaved back into pixels. Widening is
+ * plain SSE2, storing each pixel four at a time.
+ */
+static int sse_supported(void){
+  return __builtin_cpu_supports("ssse3");
+}
+
+// splits palette into a table of each byte of its colours
+static void palette_planes(const uint32_t *palette, int mask, uint8_t planes[4][16]){
+  for(int i = 0; i < 16; i++){
+    uint32_t colour = palette[i & mask];
+    for(int b = 0; b < 4; b++){
+      planes[b][i] = colour >> (8 * b);
+    }
+  }
+}
+
+__attribute__((target("ssse3")))
+static void sse_convert(const uint8_t *index, uint32_t *out, int count,
+			const uint32_t *palette, int mask){
+  if(mask > 0x0f){
+    scalar_convert(index, out, count, palette, mask);
+    return;
+  }
+  uint8_t planes[4][16];
+  palette_planes(palette, mask, planes);
+  __m128i p0 = _mm_loadu_si128((const __m128i *)planes[0]);
+  __m128i p1 = _mm_loadu_si128((const __m128i *)planes[1]);
+  __m128i p2 = _mm_loadu_si128((const __m128i *)planes[2]);
+  __m128i p3 = _mm_loadu_si128((const __m128i *)planes[3]);
+  __m128i masks = _mm_set1_epi8(mask);
+
+  int i = 0;
+  for(; i + 16 <= count; i += 16){
+    __m128i idx = _mm_and_si128(_mm_loadu_si128((const __m128i *)(index + i)), masks);
+    __m128i b0 = _mm_shuffle_epi8(p0, idx);
+    __m128i b1 = _mm_shuffle_epi8(p1, idx);
+    __m128i b2 = _mm_shuffle_epi8(p2, idx);
+    __m128i b3 = _mm_shuffle_epi8(p3, idx);
+    __m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+    __m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+    __m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+    __m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+    _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi16(lo01, lo23));
+    _mm_storeu_si128((__m128i *)(out + i + 4), _mm_unpackhi_epi16(lo01, lo23));
+    _mm_storeu_si128((__m128i *)(out + i + 8), _mm_unpacklo_epi16(hi01, hi23));
+    _mm_storeu_si128((__m128i *)(out + i + 12), _mm_unpackhi_epi16(hi01, hi23));
+  }
+  scalar_convert(index + i, out + i, count - i, palette, mask);
+}
+
+static void sse_widen(const uint32_t *src, uint32_t *dst, int count, int scale){
+  if(scale & 3){
+    scalar_widen(src, dst, count, scale);
+    return;
+  }
+  int i = 0;
+  if(scale == 4){
+    // four pixels in, each spread over a vector out
+    for(; i + 4 <= count; i += 4){
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+      _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi32(v, 0x00));
+      _mm_storeu_si128((__m128i *)(dst + 4), _mm_shuffle_epi32(v, 0x55));
+      _mm_storeu_si128((__m128i *)(dst + 8), _mm_shuffle_epi32(v, 0xAA));
+      _mm_storeu_si128((__m128i *)(dst + 12), _mm_shuffle_epi32(v, 0xFF));
+      dst += 16;
+    }
+  }
+  for(; i < count; i++){
+    __m128i v = _mm_set1_epi32(src[i]);
+    for(int k = 0; k < scale; k += 4){
+      _mm_storeu_si128((__m128i *)dst, v);
+      dst += 4;
+    }
+  }
+}
+
+/*
+ * AVX2: the same lookup 32 indices at a time (vpshufb works within each
+ * 128 bit lane, so the lanes are put back in order at the end), and a
+ * gather for palettes of more than 16 colours. Widening stores eight
+ * pixels at a time.
+ */
+static int avx2_supported(void){
+  return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static void avx2_convert(const uint8_t *index, uint32_t *out, int count,
+			 const uint32_t *palette, int mask){
+  int i = 0;
+  if(mask > 0x0f){
+    __m256i masks = _mm256_set1_epi32(mask);
+    for(; i + 8 <= count; i += 8){
+      __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(index + i)));
+      idx = _mm256_and_si256(idx, masks);
+      _mm256_storeu_si256((__m256i *)(out + i),
+			  _mm256_i32gather_epi32((const int *)palette, idx, 4));
+    }
+    scalar_convert(index + i, out + i, count - i, palette, mask);
+    return;
+  }
+
+  uint8_t planes[4][16];
+  palette_planes(palette, mask, planes);
+  __m256i p0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)planes[0]));
+  __m256i p1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)planes[1]));
+  __m256i p2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)planes[2]));
+  __m256i p3 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)planes[3]));
+  __m256i masks = _mm256_set1_epi8(mask);
+
+  for(; i + 32 <= count; i += 32){
+    __m256i idx = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(index + i)), masks);
+    __m256i b0 = _mm256_shuffle_epi8(p0, idx);
+    __m256i b1 = _mm256_shuffle_epi8(p1, idx);
+    __m256i b2 = _mm256_shuffle_epi8(p2, idx);
+    __m256i b3 = _mm256_shuffle_epi8(p3, idx);
+    __m256i lo01 = _mm256_unpacklo_epi8(b0, b1);
+    __m256i hi01 = _mm256_unpackhi_epi8(b0, b1);
+    __m256i lo23 = _mm256_unpacklo_epi8(b2, b3);
+    __m256i hi23 = _mm256_unpackhi_epi8(b2, b3);
+    // each lane holds pixels 0-3, 4-7 ... of its own 16
+    __m256i q0 = _mm256_unpacklo_epi16(lo01, lo23);
+    __m256i q1 = _mm256_unpackhi_epi16(lo01, lo23);
+    __m256i q2 = _mm256_unpacklo_epi16(hi01, hi23);
+    __m256i q3 = _mm256_unpackhi_epi16(hi01, hi23);
+    _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute2x128_si256(q0, q1, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + i + 8), _mm256_permute2x128_si256(q2, q3, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + i + 16), _mm256_permute2x128_si256(q0, q1, 0x31));
+    _mm256_storeu_si256((__m256i *)(out + i + 24), _mm256_permute2x128_si256(q2, q3, 0x31));
+  }
+  scalar_convert(index + i, out + i, count - i, palette, mask);
+}
+
+__attribute__((target("avx2")))
+static void avx2_widen(const uint32_t *src, uint32_t *dst, int count, int scale){
+  int i = 0;
+  if(scale == 4){
+    // eight pixels in, two to each vector out
+    const __m256i spread[4] = {
+      _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1),
+      _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3),
+      _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5),
+      _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7),
+    };
+    for(; i + 8 <= count; i += 8){
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+      for(int k = 0; k < 4; k++){
+	_mm256_storeu_si256((__m256i *)dst, _mm256_permutevar8x32_epi32(v, spread[k]));
+	dst += 8;
+      }
+    }
+  } else if(!(scale & 7)){
+    for(; i < count; i++){
+      __m256i v = _mm256_set1_epi32(src[i]);
+      for(int k = 0; k < scale; k += 8){
+	_mm256_storeu_si256((__m256i *)dst, v);
+	dst += 8;
+      }
+    }
+  }
+  sse_widen(src + i, dst, count - i, scale);
+}
+
+// best last
+const struct blit blits[] = {
+  { "scalar", scalar_supported, scalar_convert, scalar_widen },
+  { "sse", sse_supported, sse_convert, sse_widen },
+  { "avx2", avx2_supported, avx2_convert, avx2_widen },
+};
+
+const int blit_count = sizeof(blits) / sizeof(blits[0]);
+
+const struct blit *blit_best(void){
+  static const struct blit *best;
+  if(!best){
+    for(int i = 0; i < blit_count; i++){
+      if(blits[i].supported()) best = &blits[i];
+    }
+  }
+  return best;
+}
+
+void blit_scale(const struct blit *blit, const uint32_t *src, int width, int height,
+		uint32_t *dst, int stride, int x_scale, int y_scale){
+  for(int y = 0; y < height; y++){
+    uint32_t *row = dst + (uint64_t)y * y_scale * stride;
+    blit->widen(src + y * width, row, width, x_scale);
+    // the rest of the block's rows are copies of the first
+    for(int r = 1; r < y_scale; r++){
+      memcpy(row + r * stride, row, sizeof(uint32_t) * width * x_scale);
+    }
+  }
+}
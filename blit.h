@@ -0,0 +1,40 @@
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <stdint.h>
+
+/*
+ * The output stage: turns an indexed framebuffer (a byte per pixel, like
+ * the easy 6502 screen, or the NES's 256x240 later) into 0xAARRGGBB
+ * pixels through a palette, and scales them up by whole numbers, nearest
+ * neighbour, straight into the buffer that is shown.
+ *
+ * There's an implementation for each instruction set we have code for.
+ * blit_best() picks the best one this cpu can run, and the rest are kept
+ * for comparison (see ricoh-blit).
+ */
+
+struct blit{
+  const char *name;
+  // nonzero if this cpu can run it
+  int (*supported)(void);
+  // out[i] = palette[index[i] & mask], mask being one less than a power of two
+  void (*convert)(const uint8_t *index, uint32_t *out, int count,
+		  const uint32_t *palette, int mask);
+  // writes each of count pixels scale times over
+  void (*widen)(const uint32_t *src, uint32_t *dst, int count, int scale);
+};
+
+extern const struct blit blits[];
+extern const int blit_count;
+
+const struct blit *blit_best(void);
+
+/*
+ * Scales a width x height frame into dst, whose rows are stride pixels
+ * apart, each pixel becoming an x_scale by y_scale block.
+ */
+void blit_scale(const struct blit *blit, const uint32_t *src, int width, int height,
+		uint32_t *dst, int stride, int x_scale, int y_scale);
+
+#endif
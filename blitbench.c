@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "blit.h"
+#include "screen.h"
+
+/*
+ * Times the display output stage: converting an indexed frame through
+ * its palette and scaling it up, as gui does every frame, with each
+ * implementation this cpu supports against the scalar one. Frames are
+ * the easy 6502 screen and one the size of the NES's, at 4x and 8x (and
+ * 1x, to time the conversion alone).
+ * Every implementation's output is checked against the scalar one's.
+ */
+
+struct frame_kind{
+  const char *name;
+  int width, height;
+  int colours;
+};
+
+static const struct frame_kind kinds[] = {
+  { "easy 6502", SCREEN_WIDTH, SCREEN_HEIGHT, 16 },
+  { "nes", 256, 240, 64 },
+};
+
+// 1x is the palette conversion alone
+static const int scales[] = { 1, 4, 8 };
+
+static double now(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void draw(const struct blit *blit, const struct frame_kind *kind, const uint8_t *index,
+		 const uint32_t *palette, uint32_t *pixels, uint32_t *out, int scale){
+  blit->convert(index, pixels, kind->width * kind->height, palette, kind->colours - 1);
+  blit_scale(blit, pixels, kind->width, kind->height, out, kind->width * scale, scale, scale);
+}
+
+int main(int argc, char **argv){
+  double seconds = 0.25;
+  int opt;
+  while((opt = getopt(argc, argv, "t:")) != -1){
+    switch(opt){
+    case 't': seconds = atof(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-t seconds_per_test]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  uint32_t palette[256];
+  memcpy(palette, screen_palette, sizeof(screen_palette));
+  srand(1);
+  for(int i = 16; i < 256; i++){
+    palette[i] = 0xFF000000 | (rand() & 0xFFFFFF);
+  }
+
+  int failed = 0;
+  printf("%-10s %5s %-7s %10s %12s %8s\n",
+	 "frame", "scale", "blit", "us/frame", "Mpixels/s", "speedup");
+  for(int k = 0; k < (int)(sizeof(kinds) / sizeof(kinds[0])); k++){
+    const struct frame_kind *kind = &kinds[k];
+    int count = kind->width * kind->height;
+    uint8_t *index = malloc(count);
+    uint32_t *pixels = malloc(sizeof(uint32_t) * count);
+    for(int i = 0; i < count; i++){
+      index[i] = rand();
+    }
+
+    for(int s = 0; s < (int)(sizeof(scales) / sizeof(scales[0])); s++){
+      int scale = scales[s];
+      size_t out_len = (size_t)count * scale * scale;
+      uint32_t *expected = malloc(sizeof(uint32_t) * out_len);
+      uint32_t *out = malloc(sizeof(uint32_t) * out_len);
+      draw(&blits[0], kind, index, palette, pixels, expected, scale);
+
+      double scalar_time = 0;
+      for(int b = 0; b < blit_count; b++){
+	const struct blit *blit = &blits[b];
+	if(!blit->supported()) continue;
+
+	memset(out, 0, sizeof(uint32_t) * out_len);
+	draw(blit, kind, index, palette, pixels, out, scale);
+	int matches = !memcmp(out, expected, sizeof(uint32_t) * out_len);
+	if(!matches) failed++;
+
+	// doubles the frames drawn until they take long enough to time
+	long frames = 0;
+	double elapsed = 0;
+	for(long batch = 1; elapsed < seconds; batch *= 2){
+	  double start = now();
+	  for(long i = 0; i < batch; i++){
+	    draw(blit, kind, index, palette, pixels, out, scale);
+	  }
+	  elapsed += now() - start;
+	  frames += batch;
+	}
+	double per_frame = elapsed / frames;
+	if(b == 0) scalar_time = per_frame;
+
+	printf("%-10s %4dx %-7s %10.2f %12.1f %7.2fx%s\n",
+	       kind->name, scale, blit->name, per_frame * 1e6, out_len / per_frame / 1e6,
+	       scalar_time / per_frame, matches ? "" : "  MISMATCH");
+      }
+      free(expected);
+      free(out);
+    }
+    free(index);
+    free(pixels);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,746 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "6502.h"
+#include "6502_ops.h"
+#include "nes_memory.h"
+#include "sched.h"
+
+/*
+ * ricoh-test: checks the core against what a real (NMOS) 6502 does.
+ *
+ * Everything runs headless on the flat 64k memory, through the core that
+ * memory picks. There are three kinds of test:
+ *
+ *  - built in checks, which always run: ADC and SBC over every operand,
+ *    carry and mode against a model of the arithmetic, a table of
+ *    single instructions whose corner cases are easy to get wrong
+ *    (indexing wrap around, the JMP indirect page bug, the B flag...),
+ *    and one of the cycles taken with and without the penalties. OAM
+ *    DMA, the one thing here that isn't the cpu's, is checked on the NES
+ *    memory, through its core and the generic one. The opcodes that jam a
+ *    real 6502 are checked to stop a run to a deadline, on both cores.
+ *
+ *  - the Klaus Dormann functional and decimal test images. These loop on
+ *    themselves (a "trap") when something fails, so a test stops when an
+ *    instruction leaves the pc where it was, and passes if that is the
+ *    success trap, or for the decimal test, if its ERROR byte is zero.
+ *
+ *  - nestest, whose log of the cpu state before every instruction is
+ *    compared against ours, up to where it starts on illegal opcodes.
+ *
+ * The images aren't ours to ship, so they are looked for in a test
+ * directory (-d, test/ by default) and skipped if missing:
+ *
+ *   6502_functional_test.bin   assembled with its default options
+ *   6502_decimal_test.bin      assembled to load at 0x0200
+ *   nestest.nes, nestest.log
+ *
+ * The exit status is 1 if any test failed.
+ */
+
+#define DEFAULT_DIR "test"
+// no test image takes anywhere near this long
+#define MAX_INSTRUCTIONS 200000000ULL
+
+enum result{ PASS, FAIL, SKIP };
+
+static const char *result_strings[] = {
+  [PASS] = "pass",
+  [FAIL] = "FAIL",
+  [SKIP] = "skip",
+};
+
+static const char *test_dir = DEFAULT_DIR;
+static int verbose = 0;
+
+static double now(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static uint8_t status_of(struct cpu_info *cpu){
+  return STATUS_BYTE(cpu, 0b10);
+}
+
+/*
+ * A fresh machine with all 64k zeroed, BRK stopping it, and the stack
+ * pointer where a reset leaves it.
+ */
+static void fresh_cpu(struct cpu_info *cpu, struct memory *mem){
+  memset(decode_address(mem, 0), 0, 0x10000);
+  init_cpu_info(cpu, mem);
+  cpu->s = 0xFD;
+  cpu->I = 1;
+}
+
+// reads a whole file from the test directory, or NULL if it isn't there
+static uint8_t *read_test_file(const char *name, size_t *len){
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/%s", test_dir, name);
+  FILE *file = fopen(path, "rb");
+  if(!file) return NULL;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  rewind(file);
+  uint8_t *data = size > 0 ? malloc(size + 1) : NULL;
+  if(!data || fread(data, 1, size, file) != (size_t)size){
+    fprintf(stderr, "%s: couldn't read\n", path);
+    free(data);
+    fclose(file);
+    return NULL;
+  }
+  data[size] = 0;
+  fclose(file);
+  *len = size;
+  return data;
+}
+
+/*
+ * ADC AND SBC
+ *
+ * Every accumulator, operand and carry, in binary against plain integer
+ * arithmetic, and in decimal for every valid BCD pair against digit by
+ * digit arithmetic. (What decimal mode makes of invalid BCD, and its N
+ * and V flags, are left to the decimal test image.)
+ */
+static int check_alu(struct cpu_info *cpu, uint8_t opcode, int decimal,
+		     int a, int b, int carry){
+  cpu->pc = 0x0400;
+  write8(cpu->mem, 0x0400, opcode);
+  write8(cpu->mem, 0x0401, b);
+  cpu->a = a;
+  cpu->C = carry;
+  cpu->D = decimal;
+  execute_instruction(cpu);
+
+  int subtract = opcode == 0xE9;
+  int operand = subtract ? b ^ 0xFF : b;
+  int binary = a + operand + carry;
+  int want_a, want_c, want_z = (binary & 0xFF) == 0;
+  if(!decimal){
+    int sum = (int8_t)a + (int8_t)operand + carry;
+    want_a = binary & 0xFF;
+    want_c = binary > 0xFF;
+    if(cpu->N != want_a >> 7 || cpu->V != (sum < -128 || sum > 127)) return 0;
+  } else{
+    int x = (a >> 4) * 10 + (a & 0x0F);
+    int y = (b >> 4) * 10 + (b & 0x0F);
+    int result = subtract ? x - y - !carry : x + y + carry;
+    want_c = subtract ? result >= 0 : result > 99;
+    result = (result + 100) % 100;
+    want_a = (result / 10) << 4 | result % 10;
+  }
+  return cpu->a == want_a && cpu->C == want_c && cpu->Z == want_z;
+}
+
+static enum result test_alu(struct memory *mem, uint64_t *instructions){
+  struct cpu_info cpu;
+  fresh_cpu(&cpu, mem);
+  static const uint8_t opcodes[] = { 0x69, 0xE9 };
+  int failures = 0;
+  for(int op = 0; op < 2; op++){
+    for(int decimal = 0; decimal < 2; decimal++){
+      for(int a = 0; a < 0x100; a++){
+	for(int b = 0; b < 0x100; b++){
+	  if(decimal && ((a & 0x0F) > 9 || a > 0x99 || (b & 0x0F) > 9 || b > 0x99)) continue;
+	  for(int carry = 0; carry < 2; carry++){
+	    if(check_alu(&cpu, opcodes[op], decimal, a, b, carry)) continue;
+	    if(failures++ < 5){
+	      printf("  %s%s a %02x, operand %02x, carry %d: got a %02x, p %02x\n",
+		     op ? "sbc" : "adc", decimal ? " (decimal)" : "",
+		     a, b, carry, cpu.a, status_of(&cpu));
+	    }
+	  }
+	}
+      }
+    }
+  }
+  *instructions = cpu.instructions;
+  return failures ? FAIL : PASS;
+}
+
+/*
+ * SINGLE INSTRUCTIONS
+ *
+ * Each case pokes bytes into memory ("addr:value ..."), places code at
+ * 0x0400, sets the registers and runs until a BRK stops it or the pc
+ * reaches end. Then the registers and the memory in expect are checked,
+ * with -1 meaning "don't care". Flags are compared through mask.
+ */
+struct case_test{
+  const char *name;
+  const char *code;
+  const char *poke;
+  int a, x, y, s, p;
+  int end;
+  const char *expect;
+  int want_a, want_x, want_y, want_s, want_pc;
+  uint8_t mask, want_p;
+};
+
+#define ANY -1
+// the registers going in, and what they should be coming out
+#define REGS(a, x, y, s, p) a, x, y, s, p
+#define WANT(a, x, y, s, pc) a, x, y, s, pc
+
+static const struct case_test case_tests[] = {
+  { "lda abs,x indexes unsigned", "bd 00 10", "1080:42",
+    REGS(0, 0x80, 0, 0xFF, 0), ANY, "", WANT(0x42, ANY, ANY, ANY, ANY), 0, 0 },
+  { "sta abs,y crosses a page", "99 80 10", "",
+    REGS(0x09, 0, 0x90, 0xFF, 0), ANY, "1110:09", WANT(ANY, ANY, ANY, ANY, ANY), 0, 0 },
+  { "ldx abs,y wraps at 64k", "be 01 ff", "0000:12",
+    REGS(0, 0, 0xFF, 0xFF, 0), ANY, "", WANT(ANY, 0x12, ANY, ANY, ANY), 0x82, 0 },
+  { "lda zp,x wraps in page zero", "b5 f0", "0010:42 0110:99",
+    REGS(0, 0x20, 0, 0xFF, 0), ANY, "", WANT(0x42, ANY, ANY, ANY, ANY), 0, 0 },
+  { "ldx zp,y wraps in page zero", "b6 f0", "0010:37",
+    REGS(0, 0, 0x20, 0xFF, 0), ANY, "", WANT(ANY, 0x37, ANY, ANY, ANY), 0, 0 },
+  { "lda (zp,x) wraps in page zero", "a1 fe", "00ff:34 0000:12 1234:55",
+    REGS(0, 0x01, 0, 0xFF, 0), ANY, "", WANT(0x55, ANY, ANY, ANY, ANY), 0, 0 },
+  { "lda (zp),y pointer wraps", "b1 ff", "00ff:00 0000:20 2001:66",
+    REGS(0, 0, 0x01, 0xFF, 0), ANY, "", WANT(0x66, ANY, ANY, ANY, ANY), 0, 0 },
+  { "lda (zp),y indexes unsigned", "b1 10", "0010:01 0011:20 2100:77",
+    REGS(0, 0, 0xFF, 0xFF, 0), ANY, "", WANT(0x77, ANY, ANY, ANY, ANY), 0x82, 0 },
+  { "jmp (ind) stays in its page", "6c ff 02", "02ff:00 0200:05 0300:06",
+    REGS(0, 0, 0, 0xFF, 0), 0x0500, "", WANT(ANY, ANY, ANY, ANY, 0x0500), 0, 0 },
+  { "jsr pushes its last byte", "20 00 05", "",
+    REGS(0, 0, 0, 0xFF, 0), 0x0500, "01ff:04 01fe:02",
+    WANT(ANY, ANY, ANY, 0xFD, 0x0500), 0, 0 },
+  { "rts returns past it", "60", "01fe:ff 01ff:04",
+    REGS(0, 0, 0, 0xFD, 0), 0x0500, "", WANT(ANY, ANY, ANY, 0xFF, 0x0500), 0, 0 },
+  { "rti restores flags and pc", "40", "01fd:c3 01fe:00 01ff:05",
+    REGS(0, 0, 0, 0xFC, 0), 0x0500, "", WANT(ANY, ANY, ANY, 0xFF, 0x0500), 0xCF, 0xC3 },
+  { "brk pushes pc + 2 and b", "00 ea", "fffe:00 ffff:05",
+    REGS(0, 0, 0, 0xFF, 0x00), 0x0500, "01ff:04 01fe:02 01fd:30",
+    WANT(ANY, ANY, ANY, 0xFC, 0x0500), 0x04, 0x04 },
+  { "php pushes b and bit 5", "08", "",
+    REGS(0, 0, 0, 0xFF, 0xC3), ANY, "01ff:f3", WANT(ANY, ANY, ANY, 0xFE, ANY), 0, 0 },
+  { "plp ignores b and bit 5", "28", "01ff:30",
+    REGS(0, 0, 0, 0xFE, 0), ANY, "", WANT(ANY, ANY, ANY, 0xFF, ANY), 0xCF, 0x00 },
+  { "pla sets n and z", "68", "01ff:80",
+    REGS(0, 0, 0, 0xFE, 0x02), ANY, "", WANT(0x80, ANY, ANY, 0xFF, ANY), 0x82, 0x80 },
+  { "txs leaves the flags", "9a", "",
+    REGS(0, 0x00, 0, 0xFF, 0x80), ANY, "", WANT(ANY, ANY, ANY, 0x00, ANY), 0x82, 0x80 },
+  { "tsx sets n and z", "ba", "",
+    REGS(0, 0, 0, 0x80, 0x02), ANY, "", WANT(ANY, 0x80, ANY, ANY, ANY), 0x82, 0x80 },
+  { "adc overflows", "69 50", "",
+    REGS(0x50, 0, 0, 0xFF, 0), ANY, "", WANT(0xA0, ANY, ANY, ANY, ANY), 0xC3, 0xC0 },
+  { "sbc borrows", "e9 01", "",
+    REGS(0x00, 0, 0, 0xFF, 0), ANY, "", WANT(0xFE, ANY, ANY, ANY, ANY), 0xC3, 0x80 },
+  { "adc in decimal", "69 46", "",
+    REGS(0x58, 0, 0, 0xFF, 0x09), ANY, "", WANT(0x05, ANY, ANY, ANY, ANY), 0x01, 0x01 },
+  { "sbc in decimal", "e9 12", "",
+    REGS(0x46, 0, 0, 0xFF, 0x09), ANY, "", WANT(0x34, ANY, ANY, ANY, ANY), 0x01, 0x01 },
+  { "adc in decimal sets z from binary", "69 01", "",
+    REGS(0x99, 0, 0, 0xFF, 0x08), ANY, "", WANT(0x00, ANY, ANY, ANY, ANY), 0x03, 0x01 },
+  { "cmp sets carry when equal", "c9 40", "",
+    REGS(0x40, 0, 0, 0xFF, 0), ANY, "", WANT(0x40, ANY, ANY, ANY, ANY), 0x83, 0x03 },
+  { "bit copies n and v", "24 10", "0010:c0",
+    REGS(0x00, 0, 0, 0xFF, 0), ANY, "", WANT(ANY, ANY, ANY, ANY, ANY), 0xC2, 0xC2 },
+  { "rol goes through carry", "2a", "",
+    REGS(0x80, 0, 0, 0xFF, 0x01), ANY, "", WANT(0x01, ANY, ANY, ANY, ANY), 0x83, 0x01 },
+  { "ror memory goes through carry", "66 10", "0010:01",
+    REGS(0, 0, 0, 0xFF, 0x01), ANY, "0010:80", WANT(ANY, ANY, ANY, ANY, ANY), 0x83, 0x81 },
+  { "asl abs,x", "1e 00 10", "1001:40",
+    REGS(0, 0x01, 0, 0xFF, 0), ANY, "1001:80", WANT(ANY, ANY, ANY, ANY, ANY), 0x83, 0x80 },
+  { "inc wraps to zero", "e6 10", "0010:ff",
+    REGS(0, 0, 0, 0xFF, 0), ANY, "0010:00", WANT(ANY, ANY, ANY, ANY, ANY), 0x82, 0x02 },
+  { "bne branches backwards", "d0 fa", "03fc:a9 03fd:07",
+    REGS(0, 0, 0, 0xFF, 0), ANY, "", WANT(0x07, ANY, ANY, ANY, ANY), 0, 0 },
+};
+
+#define CASE_COUNT (int)(sizeof(case_tests) / sizeof(case_tests[0]))
+
+// places the hex bytes of code at 0x0400
+static void load_code(struct memory *mem, const char *code){
+  unsigned byte;
+  int used;
+  uint16_t at = 0x0400;
+  for(; sscanf(code, " %x%n", &byte, &used) == 1; code += used){
+    write8(mem, at++, byte);
+  }
+}
+
+// writes each "addr:value" in list
+static void poke_list(struct memory *mem, const char *list){
+  unsigned addr, value;
+  int used;
+  while(sscanf(list, " %x:%x%n", &addr, &value, &used) == 2){
+    write8(mem, addr, value);
+    list += used;
+  }
+}
+
+// checks each "addr:value" in list, printing the first that differs
+static int check_list(struct memory *mem, const char *list){
+  unsigned addr, value;
+  int used;
+  while(sscanf(list, " %x:%x%n", &addr, &value, &used) == 2){
+    if(read8(mem, addr) != value){
+      printf("  %04x is %02x, not %02x\n", addr, read8(mem, addr), value);
+      return 0;
+    }
+    list += used;
+  }
+  return 1;
+}
+
+#define CHECK_REG(name, got, want)					\
+  do{									\
+    if((want) != ANY && (got) != (want)){				\
+      printf("  %s is %02x, not %02x\n", name, got, want);		\
+      ok = 0;								\
+    }									\
+  } while(0)
+
+static int run_case(struct memory *mem, const struct case_test *t, uint64_t *instructions){
+  struct cpu_info cpu;
+  fresh_cpu(&cpu, mem);
+  load_code(mem, t->code);
+  poke_list(mem, t->poke);
+  cpu.pc = 0x0400;
+  cpu.a = t->a; cpu.x = t->x; cpu.y = t->y; cpu.s = t->s;
+  SET_STATUS(&cpu, t->p);
+  // an interrupt takes the BRK in the brk case, elsewhere BRK ends it
+  cpu.stop_on_brk = t->end == ANY;
+
+  while(!cpu.finished && cpu.pc != t->end && cpu.instructions < 16){
+    execute_instruction(&cpu);
+  }
+  *instructions += cpu.instructions;
+
+  int ok = 1;
+  if(!cpu.finished && cpu.pc != t->end){
+    printf("  didn't stop, pc %04x\n", cpu.pc);
+    ok = 0;
+  }
+  CHECK_REG("a", cpu.a, t->want_a);
+  CHECK_REG("x", cpu.x, t->want_x);
+  CHECK_REG("y", cpu.y, t->want_y);
+  CHECK_REG("s", cpu.s, t->want_s);
+  if(t->want_pc != ANY && cpu.pc != t->want_pc){
+    printf("  pc is %04x, not %04x\n", cpu.pc, t->want_pc);
+    ok = 0;
+  }
+  if((status_of(&cpu) & t->mask) != t->want_p){
+    printf("  p is %02x, wanted %02x in %02x\n", status_of(&cpu), t->want_p, t->mask);
+    ok = 0;
+  }
+  return check_list(mem, t->expect) && ok;
+}
+
+static enum result test_cases(struct memory *mem, uint64_t *instructions){
+  int failures = 0;
+  for(int i = 0; i < CASE_COUNT; i++){
+    if(run_case(mem, &case_tests[i], instructions)){
+      if(verbose) printf("  ok: %s\n", case_tests[i].name);
+    } else{
+      printf("  failed: %s\n", case_tests[i].name);
+      failures++;
+    }
+  }
+  return failures ? FAIL : PASS;
+}
+
+/*
+ * CYCLES
+ *
+ * One instruction at 0x0400 each, checking what it returned and what it
+ * added to the clock.
+ */
+struct timing_test{
+  const char *name;
+  const char *code;
+  const char *poke;
+  int x, y, p;
+  int cycles;
+};
+
+static const struct timing_test timing_tests[] = {
+  { "lda abs,x", "bd 00 10", "", 0x01, 0, 0, 4 },
+  { "lda abs,x across a page", "bd ff 10", "", 0x01, 0, 0, 5 },
+  { "lda abs,y across a page", "b9 80 10", "", 0, 0x80, 0, 5 },
+  { "ldx abs,y across a page", "be ff 10", "", 0, 0x01, 0, 5 },
+  { "ldy abs,x across 64k", "bc ff ff", "", 0x01, 0, 0, 5 },
+  { "lda (zp),y", "b1 10", "0010:00 0011:10", 0, 0xFF, 0, 5 },
+  { "lda (zp),y across a page", "b1 10", "0010:ff 0011:10", 0, 0x01, 0, 6 },
+  { "sta abs,x", "9d 00 10", "", 0x01, 0, 0, 5 },
+  { "sta abs,x across a page", "9d ff 10", "", 0x01, 0, 0, 5 },
+  { "sta (zp),y across a page", "91 10", "0010:ff 0011:10", 0, 0x01, 0, 6 },
+  { "asl abs,x across a page", "1e ff 10", "", 0x01, 0, 0, 7 },
+  { "bne not taken", "d0 10", "", 0, 0, 0x02, 2 },
+  { "bne taken", "d0 10", "", 0, 0, 0, 3 },
+  { "bne taken to another page", "d0 fa", "", 0, 0, 0, 4 },
+  { "bcc not taken", "90 10", "", 0, 0, 0x01, 2 },
+  { "bcs taken", "b0 10", "", 0, 0, 0x01, 3 },
+  { "jmp (ind)", "6c 00 10", "", 0, 0, 0, 5 },
+  { "brk", "00", "", 0, 0, 0, 7 },
+};
+
+#define TIMING_COUNT (int)(sizeof(timing_tests) / sizeof(timing_tests[0]))
+
+static enum result test_timing(struct memory *mem, uint64_t *instructions){
+  int failures = 0;
+  for(int i = 0; i < TIMING_COUNT; i++){
+    const struct timing_test *t = &timing_tests[i];
+    struct cpu_info cpu;
+    fresh_cpu(&cpu, mem);
+    load_code(mem, t->code);
+    poke_list(mem, t->poke);
+    cpu.pc = 0x0400;
+    cpu.x = t->x; cpu.y = t->y;
+    SET_STATUS(&cpu, t->p);
+    int cycles = execute_instruction(&cpu);
+    *instructions += cpu.instructions;
+    if(cycles != t->cycles || cpu.clock != (uint64_t)t->cycles){
+      printf("  failed: %s took %d cycles (clock %llu), not %d\n", t->name,
+	     cycles, (unsigned long long)cpu.clock, t->cycles);
+      failures++;
+    } else if(verbose){
+      printf("  ok: %s\n", t->name);
+    }
+  }
+  return failures ? FAIL : PASS;
+}
+
+/*
+ * OAM DMA: STA $4014 copies a page into sprite memory from OAMADDR on,
+ * and stalls the cpu for 513 cycles, or 514 from an odd cycle. Page 3 is
+ * ram, copied whole; page $20 is the ppu registers, a byte at a time.
+ */
+struct dma_test{
+  const char *name;
+  uint8_t page;
+  uint8_t oam_addr;
+  // the clock before the STA
+  uint64_t clock;
+};
+
+static const struct dma_test dma_tests[] = {
+  { "oam dma from ram", 0x03, 0x00, 0 },
+  { "oam dma from an odd cycle", 0x03, 0x00, 1 },
+  { "oam dma wraps from oamaddr", 0x03, 0x40, 0 },
+  { "oam dma from the ppu", 0x20, 0x00, 0 },
+};
+
+#define DMA_COUNT (int)(sizeof(dma_tests) / sizeof(dma_tests[0]))
+
+static int run_dma(struct memory *mem, const struct cpu_core *core,
+		   const struct dma_test *t, uint64_t *instructions){
+  struct cpu_info cpu;
+  init_cpu_info(&cpu, mem);
+  cpu.core = core;
+  memset(nes_oam(mem), 0, 0x100);
+  uint8_t page[0x100];
+  for(int i = 0; i < 0x100; i++){
+    write8(mem, 0x0300 + i, i * 7 + 1);
+  }
+  for(int i = 0; i < 8; i++){
+    write8(mem, 0x2000 + i, 0x80 | i);
+  }
+  write8(mem, 0x2003, t->oam_addr);
+  mem_read_block(mem, t->page << 8, page, sizeof(page));
+  load_code(mem, "8d 14 40");
+  cpu.pc = 0x0400;
+  cpu.a = t->page;
+  cpu.clock = t->clock;
+  int cycles = execute_instruction(&cpu);
+  *instructions += cpu.instructions;
+
+  int want = 4 + 513 + ((t->clock + 4) & 1);
+  if(cycles != want || cpu.clock != t->clock + want){
+    printf("  failed: %s took %d cycles, not %d\n", t->name, cycles, want);
+    return 0;
+  }
+  for(int i = 0; i < 0x100; i++){
+    uint8_t got = nes_oam(mem)[(uint8_t)(t->oam_addr + i)];
+    if(got != page[i]){
+      printf("  failed: %s, oam %02x is %02x, not %02x\n", t->name,
+	     (uint8_t)(t->oam_addr + i), got, page[i]);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static enum result test_dma(uint64_t *instructions){
+  struct memory *mem = make_nes_mem();
+  const struct cpu_core *cores[] = { mem->core_I, &generic_core };
+  int failures = 0;
+  for(int c = 0; c < 2; c++){
+    for(int i = 0; i < DMA_COUNT; i++){
+      if(!run_dma(mem, cores[c], &dma_tests[i], instructions)){
+	failures++;
+      } else if(verbose){
+	printf("  ok: %s%s\n", dma_tests[i].name, c ? " (generic core)" : "");
+      }
+    }
+  }
+  free(mem);
+  return failures ? FAIL : PASS;
+}
+
+/*
+ * JAM: the undefined opcodes that lock up a real 6502 take no cycles and
+ * leave the pc where it is, so they have to stop the cpu, or anything
+ * running to a deadline would spin on one for ever.
+ */
+static const uint8_t jam_opcodes[] = {
+  0x02, 0x12, 0x22, 0x32, 0x42, 0x52, 0x62, 0x72, 0x92, 0xB2, 0xD2, 0xF2
+};
+
+#define JAM_COUNT (int)(sizeof(jam_opcodes) / sizeof(jam_opcodes[0]))
+
+static int run_jam(struct memory *mem, const struct cpu_core *core, uint8_t opcode,
+		   uint64_t *instructions){
+  struct cpu_info cpu;
+  fresh_cpu(&cpu, mem);
+  cpu.core = core;
+  load_code(mem, "a9 01");
+  write8(mem, 0x0402, opcode);
+  cpu.pc = 0x0400;
+
+  struct scheduler sched;
+  init_scheduler(&sched);
+  run_until(&cpu, &sched, 1000);
+  free_scheduler(&sched);
+  *instructions += cpu.instructions;
+
+  if(cpu.finished != CPU_JAM || cpu.pc != 0x0402 || cpu.a != 0x01){
+    printf("  failed: %02x left the cpu at pc %04x, a %02x, finished %d\n",
+	   opcode, cpu.pc, cpu.a, cpu.finished);
+    return 0;
+  }
+  return 1;
+}
+
+static enum result test_jam(struct memory *mem, uint64_t *instructions){
+  const struct cpu_core *cores[] = { mem->core_I, &generic_core };
+  int failures = 0;
+  for(int c = 0; c < 2; c++){
+    for(int i = 0; i < JAM_COUNT; i++){
+      if(!run_jam(mem, cores[c], jam_opcodes[i], instructions)){
+	failures++;
+      } else if(verbose){
+	printf("  ok: jam %02x%s\n", jam_opcodes[i], c ? " (generic core)" : "");
+      }
+    }
+  }
+  return failures ? FAIL : PASS;
+}
+
+/*
+ * TEST IMAGES
+ *
+ * Run until a trap, a BRK (when it stops the machine) or an undefined
+ * opcode, and judge by where it stopped.
+ */
+struct image_test{
+  const char *name;
+  const char *file;
+  uint16_t load;
+  uint16_t start;
+  // passes if it traps here, or with -1, if error_addr holds zero
+  int success_pc;
+  int error_addr;
+  // the functional test checks BRK as the interrupt it is
+  int stop_on_brk;
+};
+
+static const struct image_test image_tests[] = {
+  { "functional", "6502_functional_test.bin", 0x0000, 0x0400, 0x3469, -1, 0 },
+  { "decimal", "6502_decimal_test.bin", 0x0200, 0x0200, -1, 0x000B, 1 },
+};
+
+#define IMAGE_COUNT (int)(sizeof(image_tests) / sizeof(image_tests[0]))
+
+static enum result test_image(struct memory *mem, const struct image_test *t,
+			      uint64_t *instructions){
+  size_t len;
+  uint8_t *image = read_test_file(t->file, &len);
+  if(!image) return SKIP;
+  if(len > 0x10000u - t->load){
+    printf("  %s doesn't fit at %04x\n", t->file, t->load);
+    free(image);
+    return FAIL;
+  }
+  struct cpu_info cpu;
+  fresh_cpu(&cpu, mem);
+  mem_write_block(mem, t->load, image, len);
+  free(image);
+  cpu.pc = t->start;
+  cpu.stop_on_brk = t->stop_on_brk;
+
+  const char *why = "ran too long";
+  while(cpu.instructions < MAX_INSTRUCTIONS){
+    uint16_t pc = cpu.pc;
+    if(decode_table[read8(mem, pc)].op == BADOP){
+      why = "undefined opcode";
+      break;
+    }
+    execute_instruction(&cpu);
+    if(cpu.finished){
+      why = "brk";
+      break;
+    }
+    if(cpu.pc == pc){
+      why = "trap";
+      break;
+    }
+  }
+  *instructions = cpu.instructions;
+
+  int passed = t->success_pc >= 0 ? cpu.pc == t->success_pc && !cpu.finished :
+    read8(mem, t->error_addr) == 0;
+  if(!passed || verbose){
+    printf("  stopped on %s at pc %04x, a %02x, x %02x, y %02x, p %02x",
+	   why, cpu.pc, cpu.a, cpu.x, cpu.y, status_of(&cpu));
+    if(t->error_addr >= 0) printf(", error %02x", read8(mem, t->error_addr));
+    printf("\n");
+  }
+  return passed ? PASS : FAIL;
+}
+
+/*
+ * NESTEST
+ *
+ * Run from 0xC000 in "automation" mode, every log line is the state
+ * before an instruction:
+ *
+ *   C000  4C F5 C5  JMP $C5F5        A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+ *
+ * Past the official opcodes the disassembly starts with a '*', which is
+ * where we stop.
+ */
+struct nestest_state{
+  unsigned pc, a, x, y, p, s;
+  unsigned long long cycle;
+};
+
+static int parse_nestest_line(const char *line, struct nestest_state *st, int *illegal){
+  const char *regs = strstr(line, "A:");
+  const char *cyc = strstr(line, "CYC:");
+  if(!regs || !cyc || sscanf(line, "%4x", &st->pc) != 1) return 0;
+  if(sscanf(regs, "A:%x X:%x Y:%x P:%x SP:%x", &st->a, &st->x, &st->y,
+	    &st->p, &st->s) != 5) return 0;
+  if(sscanf(cyc, "CYC:%llu", &st->cycle) != 1) return 0;
+  *illegal = strlen(line) > 15 && line[15] == '*';
+  return 1;
+}
+
+static enum result test_nestest(struct memory *mem, uint64_t *instructions){
+  size_t rom_len, log_len;
+  uint8_t *rom = read_test_file("nestest.nes", &rom_len);
+  char *log = (char*)read_test_file("nestest.log", &log_len);
+  if(!rom || !log){
+    free(rom);
+    free(log);
+    return SKIP;
+  }
+
+  enum result result = FAIL;
+  struct cpu_info cpu;
+  fresh_cpu(&cpu, mem);
+  // one or two 16k banks of PRG after the iNES header, at 0x8000 and 0xC000
+  int banks = rom_len >= 16 ? rom[4] : 0;
+  if(memcmp(rom, "NES\x1a", 4) || banks < 1 || banks > 2 ||
+     rom_len < 16 + banks * 0x4000u){
+    printf("  nestest.nes isn't a one or two bank iNES image\n");
+    goto done;
+  }
+  mem_write_block(mem, 0x8000, rom + 16, 0x4000);
+  mem_write_block(mem, 0xC000, rom + 16 + (banks - 1) * 0x4000, 0x4000);
+  cpu.pc = 0xC000;
+  cpu.stop_on_brk = 0;
+  cpu.has_decimal = 0;
+  cpu.clock = 7;
+
+  int line_no = 0;
+  for(char *line = strtok(log, "\r\n"); line; line = strtok(NULL, "\r\n")){
+    struct nestest_state want;
+    int illegal;
+    line_no++;
+    if(!parse_nestest_line(line, &want, &illegal)){
+      printf("  nestest.log:%d: can't read \"%s\"\n", line_no, line);
+      goto done;
+    }
+    if(illegal) break;
+    if(cpu.pc != want.pc || cpu.a != want.a || cpu.x != want.x || cpu.y != want.y ||
+       status_of(&cpu) != want.p || cpu.s != want.s || cpu.clock != want.cycle){
+      printf("  nestest.log:%d differs:\n"
+	     "  want %04x a %02x x %02x y %02x p %02x s %02x cyc %llu\n"
+	     "  got  %04x a %02x x %02x y %02x p %02x s %02x cyc %llu\n", line_no,
+	     want.pc, want.a, want.x, want.y, want.p, want.s, want.cycle,
+	     cpu.pc, cpu.a, cpu.x, cpu.y, status_of(&cpu), cpu.s,
+	     (unsigned long long)cpu.clock);
+      goto done;
+    }
+    execute_instruction(&cpu);
+  }
+  if(verbose) printf("  matched %d lines\n", line_no - 1);
+  // the official opcodes leave their results at 0x02 and 0x03
+  if(read8(mem, 0x02) || read8(mem, 0x03)){
+    printf("  error codes %02x %02x\n", read8(mem, 0x02), read8(mem, 0x03));
+    goto done;
+  }
+  result = PASS;
+
+done:
+  *instructions = cpu.instructions;
+  free(rom);
+  free(log);
+  return result;
+}
+
+static void usage(const char *name){
+  fprintf(stderr, "usage: %s [-v] [-d test_dir]\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv){
+  int opt;
+  while((opt = getopt(argc, argv, "vd:")) != -1){
+    switch(opt){
+    case 'v': verbose = 1; break;
+    case 'd': test_dir = optarg; break;
+    default: usage(argv[0]);
+    }
+  }
+
+  struct memory *mem = make_flat_64k_mem();
+  int counts[3] = { 0 };
+  for(int i = 0; i < 6 + IMAGE_COUNT; i++){
+    const char *name;
+    uint64_t instructions = 0;
+    double began = now();
+    enum result result;
+    switch(i){
+    case 0: name = "adc/sbc"; result = test_alu(mem, &instructions); break;
+    case 1: name = "instructions"; result = test_cases(mem, &instructions); break;
+    case 2: name = "cycles"; result = test_timing(mem, &instructions); break;
+    case 3: name = "oam dma"; result = test_dma(&instructions); break;
+    case 4: name = "jam"; result = test_jam(mem, &instructions); break;
+    case 5: name = "nestest"; result = test_nestest(mem, &instructions); break;
+    default:
+      name = image_tests[i - 6].name;
+      result = test_image(mem, &image_tests[i - 6], &instructions);
+    }
+    double elapsed = now() - began;
+    counts[result]++;
+    if(result == SKIP){
+      printf("%s %-14s (no image in %s)\n", result_strings[result], name, test_dir);
+    } else{
+      printf("%s %-14s %12llu instructions in %.3fs (%.1f M/s)\n",
+	     result_strings[result], name, (unsigned long long)instructions, elapsed,
+	     elapsed > 0 ? instructions / elapsed / 1e6 : 0.0);
+    }
+  }
+  printf("%d passed, %d failed, %d skipped\n", counts[PASS], counts[FAIL], counts[SKIP]);
+  free(mem);
+  return counts[FAIL] ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "counter.h"
+
+int counter_open_l1d_misses(void){
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_L1D |
+    PERF_COUNT_HW_CACHE_OP_READ << 8 |
+    PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // there's no libc wrapper for it
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void counter_start(int counter){
+  if(counter < 0) return;
+  ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+  ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t counter_stop(int counter){
+  uint64_t count = 0;
+  if(counter < 0) return 0;
+  ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+  if(read(counter, &count, sizeof(count)) != sizeof(count)) return 0;
+  return count;
+}
+
+void counter_close(int counter){
+  if(counter >= 0) close(counter);
+}
@@ -0,0 +1,23 @@
+#ifndef COUNTER_H
+#define COUNTER_H
+
+#include <stdint.h>
+
+/*
+ * Hardware event counters for the benchmarks, read with perf_event_open.
+ * Only this thread is counted, and only in user space.
+ *
+ * Not every machine will count for us (virtual machines often have no
+ * counters to give, and perf_event_paranoid may forbid it), so a counter
+ * that couldn't be opened is -1; starting, stopping and closing one is
+ * harmless and it always reads 0.
+ */
+
+// counts reads that missed the L1 data cache
+int counter_open_l1d_misses(void);
+void counter_start(int counter);
+// stops counting, returning the events since the last counter_start
+uint64_t counter_stop(int counter);
+void counter_close(int counter);
+
+#endif
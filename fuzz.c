@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "6502.h"
+#include "nes_memory.h"
+#include "paged_memory.h"
+
+/*
+ * ricoh-fuzz: a differential fuzzer for the cpu cores.
+ *
+ * Each test is a random machine state (RAM, registers, flags) with a
+ * random sequence of instructions at the pc. It is run on the reference
+ * core (the generic interpreter) and on every alternative core, each on
+ * its own copy of the same kind of machine, and the full state is
+ * compared after every block of instructions.
+ *
+ * Generation is guided by coverage: opcodes are drawn from the decode
+ * tables, and of two candidates the one that has been executed less is
+ * used, so rarely reached opcodes and addressing modes catch up.
+ *
+ * Tests are spread over threads, each with its own machines. A test is
+ * fully determined by its seed, which is printed on a mismatch and can
+ * be replayed with -r to trace it instruction by instruction.
+ */
+
+// a sequence is this many blocks of this many instructions
+#define BLOCK_LEN 8
+#define BLOCKS 4
+// bytes of generated code
+#define CODE_LEN 48
+/*
+ * Every machine under test has 2KiB of RAM at 0x0000, as plain pages (see
+ * page_I in memory.h), so it is loaded and compared a page at a time.
+ */
+#define RAM_SIZE 0x800
+
+#define MAX_REPORTS 10
+
+/*
+ * The alternative cores. With core left NULL, the memory's own
+ * specialised core is used. A new core (threaded, cached, ...) only has
+ * to be added here to be checked against the reference.
+ */
+struct fuzz_target{
+  const char *name;
+  struct memory *(*make_mem)();
+  const struct cpu_core *core;
+};
+
+// made before any thread starts, see main
+static struct page_image *blank_2k;
+
+static struct memory *make_paged_2k_mem(){
+  return make_paged_mem(blank_2k);
+}
+
+static struct fuzz_target targets[] = {
+  { "flat_2k", make_flat_2k_mem, NULL },
+  { "nes", make_nes_mem, NULL },
+  { "paged", make_paged_2k_mem, NULL },
+};
+
+#define TARGET_COUNT (int)(sizeof(targets) / sizeof(targets[0]))
+
+struct fuzz_test{
+  uint8_t ram[RAM_SIZE];
+  uint8_t a, x, y, s, p;
+  uint16_t pc;
+};
+
+struct worker{
+  pthread_t thread;
+  uint64_t seed;
+  uint64_t tests;
+  uint64_t instructions;
+  uint64_t mismatches;
+  uint64_t hits[256];
+};
+
+static volatile int stop_fuzzing = 0;
+static uint64_t max_tests = 0;
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+static int reports = 0;
+
+static uint8_t valid[256];
+static int valid_count = 0;
+static uint8_t valid_list[256];
+
+
+static uint64_t next_random(uint64_t *state){
+  // splitmix64
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static void find_valid_opcodes(){
+  for(int i = 0; i < 256; i++){
+    if(decode_table[i].op != BADOP && decode_table[i].width > 0){
+      valid[i] = 1;
+      valid_list[valid_count++] = i;
+    }
+  }
+}
+
+static uint8_t pick_opcode(uint64_t *rng, uint64_t *hits){
+  uint8_t a = valid_list[next_random(rng) % valid_count];
+  uint8_t b = valid_list[next_random(rng) % valid_count];
+  return hits[a] <= hits[b] ? a : b;
+}
+
+static void generate(struct fuzz_test *test, uint64_t seed, uint64_t *hits){
+  uint64_t rng = seed;
+  for(int i = 0; i < RAM_SIZE; i += 8){
+    uint64_t r = next_random(&rng);
+    memcpy(test->ram + i, &r, 8);
+  }
+  uint64_t r = next_random(&rng);
+  test->a = r;
+  test->x = r >> 8;
+  test->y = r >> 16;
+  test->s = r >> 24;
+  test->p = r >> 32;
+  test->pc = (r >> 40) % (RAM_SIZE - CODE_LEN);
+
+  // operands are left as the random bytes already there
+  int at = test->pc;
+  while(at < test->pc + CODE_LEN){
+    uint8_t op = pick_opcode(&rng, hits);
+    test->ram[at] = op;
+    at += decode_table[op].width;
+  }
+}
+
+static void load(struct fuzz_test *test, struct cpu_info *cpu){
+  mem_write_block(cpu->mem, 0, test->ram, RAM_SIZE);
+  cpu->a = test->a;
+  cpu->x = test->x;
+  cpu->y = test->y;
+  cpu->s = test->s;
+  cpu->pc = test->pc;
+  cpu->N = (test->p >> 7) & 1;
+  cpu->V = (test->p >> 6) & 1;
+  cpu->D = (test->p >> 3) & 1;
+  cpu->I = (test->p >> 2) & 1;
+  cpu->Z = (test->p >> 1) & 1;
+  cpu->C = test->p & 1;
+  cpu->clock = 0;
+  cpu->finished = 0;
+}
+
+// describes the first difference between the two cpus, or returns 0
+static int compare(struct cpu_info *ref, struct cpu_info *alt, char *why, int size){
+#define CHECK(field)							\
+  if(ref->field != alt->field){						\
+    snprintf(why, size, #field " %llx != %llx",				\
+	     (unsigned long long)ref->field, (unsigned long long)alt->field); \
+    return 1;								\
+  }
+  CHECK(a); CHECK(x); CHECK(y); CHECK(s); CHECK(pc);
+  CHECK(N); CHECK(V); CHECK(D); CHECK(I); CHECK(Z); CHECK(C);
+  CHECK(clock); CHECK(finished);
+#undef CHECK
+
+  for(int page = 0; page < RAM_SIZE; page += 0x100){
+    const uint8_t *ref_ram = mem_page(ref->mem, page, 0);
+    const uint8_t *alt_ram = mem_page(alt->mem, page, 0);
+    if(!memcmp(ref_ram, alt_ram, 0x100)) continue;
+    for(int i = 0; i < 0x100; i++){
+      if(ref_ram[i] != alt_ram[i]){
+	snprintf(why, size, "ram[%03x] %02x != %02x", page + i, ref_ram[i], alt_ram[i]);
+	break;
+      }
+    }
+    return 1;
+  }
+  return 0;
+}
+
+static void print_cpu(const char *name, struct cpu_info *cpu){
+  printf("  %-8s pc %04x a %02x x %02x y %02x s %02x NV-DIZC %d%d-%d%d%d%d clock %llu\n",
+	 name, cpu->pc, cpu->a, cpu->x, cpu->y, cpu->s,
+	 cpu->N, cpu->V, cpu->D, cpu->I, cpu->Z, cpu->C,
+	 (unsigned long long)cpu->clock);
+}
+
+static void report(struct fuzz_target *target, uint64_t seed, struct fuzz_test *test,
+		   int block, const char *why){
+  pthread_mutex_lock(&report_lock);
+  if(reports++ < MAX_REPORTS){
+    printf("mismatch: %s, test %016llx, block %d: %s\n  code at %04x:",
+	   target->name, (unsigned long long)seed, block, why, test->pc);
+    for(int i = 0; i < 16; i++){
+      printf(" %02x", test->ram[test->pc + i]);
+    }
+    printf("\n");
+  }
+  pthread_mutex_unlock(&report_lock);
+}
+
+/*
+ * Runs one test on the reference and every target. Returns the number of
+ * mismatching targets.
+ */
+static int run_test(struct worker *w, struct cpu_info *refs, struct cpu_info *alts,
+		    uint64_t seed, int trace){
+  static __thread struct fuzz_test test;
+  generate(&test, seed, w->hits);
+  int failed = 0;
+
+  for(int t = 0; t < TARGET_COUNT; t++){
+    struct cpu_info *ref = &refs[t];
+    struct cpu_info *alt = &alts[t];
+    load(&test, ref);
+    load(&test, alt);
+
+    for(int block = 0; block < BLOCKS; block++){
+      for(int i = 0; i < BLOCK_LEN && !ref->finished; i++){
+	if(t == 0){
+	  w->hits[read8(ref->mem, ref->pc)]++;
+	  w->instructions++;
+	}
+	if(trace){
+	  uint8_t instr = read8(ref->mem, ref->pc);
+	  printf("%s %s\n", opcode_strings[decode_table[instr].op],
+		 addressMode_strings[decode_table[instr].mode]);
+	}
+	ref->core->execute(ref);
+	if(trace){
+	  // an instruction at a time, so each can be seen
+	  alt->core->run(alt, ref->clock);
+	  print_cpu("generic", ref);
+	  print_cpu(targets[t].name, alt);
+	}
+      }
+      /*
+       * Otherwise the target runs the whole block through its run loop,
+       * as it would for real, so its superinstructions are checked too.
+       * Every instruction takes at least two cycles, so it stops on the
+       * same instruction as the reference if it agrees with it.
+       */
+      if(!trace) alt->core->run(alt, ref->clock);
+      // except for a jam, which takes no cycles, so the run stops short of it
+      if(ref->finished == CPU_JAM && !alt->finished) alt->core->execute(alt);
+
+      char why[64];
+      if(compare(ref, alt, why, sizeof(why))){
+	report(&targets[t], seed, &test, block, why);
+	failed++;
+	break;
+      }
+      if(ref->finished) break;
+    }
+  }
+  return failed;
+}
+
+// each target is checked against the generic core on the same memory
+static void make_cpus(struct cpu_info *refs, struct cpu_info *alts){
+  for(int t = 0; t < TARGET_COUNT; t++){
+    init_cpu_info(&refs[t], targets[t].make_mem());
+    refs[t].core = &generic_core;
+    init_cpu_info(&alts[t], targets[t].make_mem());
+    if(targets[t].core) alts[t].core = targets[t].core;
+  }
+}
+
+static void *fuzz_thread(void *arg){
+  struct worker *w = arg;
+  struct cpu_info refs[TARGET_COUNT];
+  struct cpu_info alts[TARGET_COUNT];
+  make_cpus(refs, alts);
+
+  uint64_t rng = w->seed;
+  while(!stop_fuzzing && (!max_tests || w->tests < max_tests)){
+    uint64_t seed = next_random(&rng);
+    w->mismatches += run_test(w, refs, alts, seed, 0);
+    w->tests++;
+  }
+  return NULL;
+}
+
+
+static void print_coverage(uint64_t *hits){
+  int covered = 0;
+  uint64_t modes[12] = { 0 };
+  for(int i = 0; i < 256; i++){
+    if(!valid[i]) continue;
+    if(hits[i]) covered++;
+    modes[decode_table[i].mode] += hits[i];
+  }
+  printf("coverage: %d/%d opcodes\n", covered, valid_count);
+  for(int m = 0; m < 12; m++){
+    printf("  %-14s %llu\n", addressMode_strings[m], (unsigned long long)modes[m]);
+  }
+  for(int i = 0; i < 256; i++){
+    if(valid[i] && !hits[i]){
+      printf("  never executed: %02x %s %s\n", i, opcode_strings[decode_table[i].op],
+	     addressMode_strings[decode_table[i].mode]);
+    }
+  }
+}
+
+static void usage(const char *name){
+  fprintf(stderr, "usage: %s [-j threads] [-t seconds] [-n tests_per_thread] "
+	  "[-s seed] [-r test_seed]\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv){
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int seconds = 10;
+  uint64_t seed = time(NULL);
+  int replay = 0;
+  uint64_t replay_seed = 0;
+
+  int opt;
+  while((opt = getopt(argc, argv, "j:t:n:s:r:")) != -1){
+    switch(opt){
+    case 'j': threads = atoi(optarg); break;
+    case 't': seconds = atoi(optarg); break;
+    case 'n': max_tests = strtoull(optarg, NULL, 0); break;
+    case 's': seed = strtoull(optarg, NULL, 0); break;
+    case 'r': replay = 1; replay_seed = strtoull(optarg, NULL, 16); break;
+    default: usage(argv[0]);
+    }
+  }
+  if(threads < 1) threads = 1;
+  find_valid_opcodes();
+  blank_2k = page_image_create(RAM_SIZE, 0, NULL, 0);
+  if(!blank_2k){
+    perror("page image");
+    return 1;
+  }
+
+  if(replay){
+    struct worker w;
+    memset(&w, 0, sizeof(w));
+    struct cpu_info refs[TARGET_COUNT];
+    struct cpu_info alts[TARGET_COUNT];
+    make_cpus(refs, alts);
+    return run_test(&w, refs, alts, replay_seed, 1) ? 1 : 0;
+  }
+
+  printf("fuzzing %d cores against the generic core on %d threads, seed %llu\n",
+	 TARGET_COUNT, threads, (unsigned long long)seed);
+
+  struct worker *workers = calloc(threads, sizeof(struct worker));
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(int i = 0; i < threads; i++){
+    workers[i].seed = seed + i * 0x9E3779B97F4A7C15ULL;
+    pthread_create(&workers[i].thread, NULL, fuzz_thread, &workers[i]);
+  }
+
+  if(!max_tests){
+    sleep(seconds);
+    stop_fuzzing = 1;
+  }
+
+  uint64_t tests = 0, instructions = 0, mismatches = 0;
+  uint64_t hits[256] = { 0 };
+  for(int i = 0; i < threads; i++){
+    pthread_join(workers[i].thread, NULL);
+    tests += workers[i].tests;
+    instructions += workers[i].instructions;
+    mismatches += workers[i].mismatches;
+    for(int op = 0; op < 256; op++){
+      hits[op] += workers[i].hits[op];
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  print_coverage(hits);
+  printf("%llu tests (%.2f million/minute), %llu instructions, %llu mismatches\n",
+	 (unsigned long long)tests, tests / elapsed * 60 / 1e6,
+	 (unsigned long long)instructions, (unsigned long long)mismatches);
+  free(workers);
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,533 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "gdbstub.h"
+
+
+static int test_bit(uint64_t *bitmap, uint16_t addr){
+  return (bitmap[addr >> 6] >> (addr & 63)) & 1;
+}
+
+static void set_bit(struct debugger *dbg, uint64_t *bitmap, uint16_t addr){
+  if(!test_bit(bitmap, addr)){
+    bitmap[addr >> 6] |= 1ULL << (addr & 63);
+    dbg->armed++;
+  }
+}
+
+static void clear_bit(struct debugger *dbg, uint64_t *bitmap, uint16_t addr){
+  if(test_bit(bitmap, addr)){
+    bitmap[addr >> 6] &= ~(1ULL << (addr & 63));
+    dbg->armed--;
+  }
+}
+
+// the cpu only takes the slow path while there is something to check
+static void update_cpu(struct debugger *dbg, struct cpu_info *cpu){
+  cpu->debug = (dbg->armed || dbg->stepping) ? dbg : NULL;
+}
+
+
+/*
+ * ============================================
+ * CONNECTION
+ * ============================================
+ */
+
+/*
+ * Listens on where, which is either a TCP port on the loopback interface
+ * or the path of a Unix socket, and waits for gdb to connect. The program
+ * starts off stopped so breakpoints can be set before it runs.
+ */
+int gdb_listen(struct debugger *dbg, const char *where){
+  memset(dbg, 0, sizeof(struct debugger));
+  dbg->fd = -1;
+
+  int is_port = 1;
+  for(const char *c = where; *c; c++){
+    if(!isdigit((unsigned char)*c)) is_port = 0;
+  }
+
+  if(is_port){
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(atoi(where));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int one = 1;
+    dbg->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(dbg->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(bind(dbg->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+      perror("gdb: bind");
+      close(dbg->listen_fd);
+      return -1;
+    }
+  } else{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, where, sizeof(addr.sun_path) - 1);
+    unlink(where);
+
+    dbg->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(bind(dbg->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+      perror("gdb: bind");
+      close(dbg->listen_fd);
+      return -1;
+    }
+  }
+
+  listen(dbg->listen_fd, 1);
+  fprintf(stderr, "waiting for gdb on %s\n", where);
+  dbg->fd = accept(dbg->listen_fd, NULL, NULL);
+  if(dbg->fd < 0){
+    perror("gdb: accept");
+    close(dbg->listen_fd);
+    return -1;
+  }
+  if(is_port){
+    int one = 1;
+    setsockopt(dbg->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  dbg->stopped = 1;
+  return 0;
+}
+
+void gdb_close(struct debugger *dbg){
+  if(dbg->fd >= 0) close(dbg->fd);
+  if(dbg->listen_fd >= 0) close(dbg->listen_fd);
+  dbg->fd = -1;
+  dbg->listen_fd = -1;
+}
+
+// returns the next byte from gdb, or -1 if there is none (or it's gone)
+static int read_byte(struct debugger *dbg, int block){
+  if(dbg->in_pos == dbg->in_len){
+    if(dbg->fd < 0) return -1;
+    if(!block){
+      struct pollfd p = { dbg->fd, POLLIN, 0 };
+      if(poll(&p, 1, 0) <= 0) return -1;
+    }
+    int got = read(dbg->fd, dbg->in, sizeof(dbg->in));
+    if(got <= 0){
+      close(dbg->fd);
+      dbg->fd = -1;
+      return -1;
+    }
+    dbg->in_len = got;
+    dbg->in_pos = 0;
+  }
+  return (uint8_t)dbg->in[dbg->in_pos++];
+}
+
+static void send_packet(struct debugger *dbg, const char *data){
+  if(dbg->fd < 0) return;
+
+  static char out[sizeof(((struct debugger*)0)->in) * 2 + 8];
+  uint8_t sum = 0;
+  for(const char *c = data; *c; c++){
+    sum += *c;
+  }
+  int len = snprintf(out, sizeof(out), "$%s#%02x", data, sum);
+  if(write(dbg->fd, out, len) != len){
+    perror("gdb: write");
+  }
+}
+
+/*
+ * Reads a packet into buf, acknowledging it. An interrupt request (^C)
+ * outside of a packet is returned as the packet "\x03".
+ * Returns -1 once gdb has disconnected.
+ */
+static int recv_packet(struct debugger *dbg, char *buf, int size){
+  int c;
+  do{
+    c = read_byte(dbg, 1);
+    if(c < 0) return -1;
+    if(c == 0x03){
+      strcpy(buf, "\x03");
+      return 1;
+    }
+  } while(c != '$');
+
+  int len = 0;
+  while((c = read_byte(dbg, 1)) != '#'){
+    if(c < 0) return -1;
+    if(len < size - 1) buf[len++] = c;
+  }
+  buf[len] = 0;
+  // we trust the transport, so the checksum is just skipped
+  read_byte(dbg, 1);
+  read_byte(dbg, 1);
+  if(write(dbg->fd, "+", 1) != 1) return -1;
+  return len;
+}
+
+
+/*
+ * ============================================
+ * COMMANDS
+ * ============================================
+ */
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char c){
+  if(c >= '0' && c <= '9') return c - '0';
+  if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static char *put_hex8(char *out, uint8_t val){
+  *out++ = hex_digits[val >> 4];
+  *out++ = hex_digits[val & 0xF];
+  return out;
+}
+
+static uint8_t get_hex8(const char *in){
+  return (hex_value(in[0]) << 4) | hex_value(in[1]);
+}
+
+static uint8_t status_byte(struct cpu_info *cpu){
+  return cpu->N << 7 | cpu->V << 6 | 1 << 5 | cpu->D << 3 |
+    cpu->I << 2 | cpu->Z << 1 | cpu->C;
+}
+
+static void set_status(struct cpu_info *cpu, uint8_t p){
+  cpu->N = (p >> 7) & 1;
+  cpu->V = (p >> 6) & 1;
+  cpu->D = (p >> 3) & 1;
+  cpu->I = (p >> 2) & 1;
+  cpu->Z = (p >> 1) & 1;
+  cpu->C = p & 1;
+}
+
+static char *put_register(char *out, struct cpu_info *cpu, int reg){
+  switch(reg){
+  case 0: return put_hex8(out, cpu->a);
+  case 1: return put_hex8(out, cpu->x);
+  case 2: return put_hex8(out, cpu->y);
+  case 3: return put_hex8(out, status_byte(cpu));
+  case 4: return put_hex8(out, cpu->s);
+  case 5: return put_hex8(put_hex8(out, cpu->pc & 0xFF), cpu->pc >> 8);
+  default: return out;
+  }
+}
+
+// returns the number of hex characters used
+static int get_register(const char *in, struct cpu_info *cpu, int reg){
+  switch(reg){
+  case 0: cpu->a = get_hex8(in); return 2;
+  case 1: cpu->x = get_hex8(in); return 2;
+  case 2: cpu->y = get_hex8(in); return 2;
+  case 3: set_status(cpu, get_hex8(in)); return 2;
+  case 4: cpu->s = get_hex8(in); return 2;
+  case 5: cpu->pc = get_hex8(in) | get_hex8(in + 2) << 8; return 4;
+  default: return 0;
+  }
+}
+
+// Z/z packets: type,addr,length
+static void set_point(struct debugger *dbg, char *pkt, int setting){
+  int type = pkt[1] - '0';
+  char *next;
+  unsigned long addr = strtoul(pkt + 3, &next, 16);
+  unsigned long len = *next == ',' ? strtoul(next + 1, NULL, 16) : 1;
+  if(type < 2) len = 1;
+
+  for(unsigned long i = 0; i < len; i++){
+    uint16_t at = addr + i;
+    uint64_t *maps[2] = { NULL, NULL };
+    switch(type){
+    case 0: case 1: maps[0] = dbg->breakpoints; break;
+    case 2: maps[0] = dbg->watch_write; break;
+    case 3: maps[0] = dbg->watch_read; break;
+    case 4: maps[0] = dbg->watch_write; maps[1] = dbg->watch_read; break;
+    default:
+      send_packet(dbg, "");
+      return;
+    }
+    for(int m = 0; m < 2 && maps[m]; m++){
+      if(setting){
+	set_bit(dbg, maps[m], at);
+      } else{
+	clear_bit(dbg, maps[m], at);
+      }
+    }
+  }
+  send_packet(dbg, "OK");
+}
+
+static void resume(struct debugger *dbg, struct cpu_info *cpu, char *pkt, int stepping){
+  if(pkt[1]){
+    cpu->pc = strtoul(pkt + 1, NULL, 16);
+  }
+  if(cpu->finished){
+    // the program has ended, there is nothing left to run
+    send_packet(dbg, "W00");
+    return;
+  }
+  dbg->stopped = 0;
+  dbg->stepping = stepping;
+  dbg->resuming = 1;
+  update_cpu(dbg, cpu);
+}
+
+static void detach(struct debugger *dbg, struct cpu_info *cpu){
+  memset(dbg->breakpoints, 0, sizeof(dbg->breakpoints));
+  memset(dbg->watch_read, 0, sizeof(dbg->watch_read));
+  memset(dbg->watch_write, 0, sizeof(dbg->watch_write));
+  dbg->armed = 0;
+  dbg->stopped = 0;
+  dbg->stepping = 0;
+  update_cpu(dbg, cpu);
+  gdb_close(dbg);
+}
+
+// returns -1 if gdb asked us to quit
+static int handle_packet(struct debugger *dbg, struct cpu_info *cpu, char *pkt){
+  static char out[sizeof(dbg->in) * 2 + 1];
+  char *o = out;
+
+  switch(pkt[0]){
+  case '?':
+    send_packet(dbg, "S05");
+    break;
+
+  case 'g':
+    for(int reg = 0; reg < 6; reg++){
+      o = put_register(o, cpu, reg);
+    }
+    *o = 0;
+    send_packet(dbg, out);
+    break;
+
+  case 'G':
+    {
+      const char *in = pkt + 1;
+      for(int reg = 0; reg < 6 && *in; reg++){
+	in += get_register(in, cpu, reg);
+      }
+      send_packet(dbg, "OK");
+    }
+    break;
+
+  case 'p':
+    *put_register(o, cpu, strtoul(pkt + 1, NULL, 16)) = 0;
+    send_packet(dbg, out);
+    break;
+
+  case 'P':
+    {
+      char *value;
+      int reg = strtoul(pkt + 1, &value, 16);
+      get_register(value + 1, cpu, reg);
+      send_packet(dbg, "OK");
+    }
+    break;
+
+  case 'm':
+    {
+      char *next;
+      unsigned long addr = strtoul(pkt + 1, &next, 16);
+      unsigned long len = strtoul(next + 1, NULL, 16);
+      if(len > sizeof(dbg->in)) len = sizeof(dbg->in);
+      for(unsigned long i = 0; i < len; i++){
+	o = put_hex8(o, read8(cpu->mem, addr + i));
+      }
+      *o = 0;
+      send_packet(dbg, out);
+    }
+    break;
+
+  case 'M':
+    {
+      char *next;
+      unsigned long addr = strtoul(pkt + 1, &next, 16);
+      unsigned long len = strtoul(next + 1, &next, 16);
+      const char *data = next + 1;
+      for(unsigned long i = 0; i < len && data[0] && data[1]; i++, data += 2){
+	write8(cpu->mem, addr + i, get_hex8(data));
+      }
+      cpu->visual_dirty = 1;
+      send_packet(dbg, "OK");
+    }
+    break;
+
+  case 'c':
+    resume(dbg, cpu, pkt, 0);
+    break;
+
+  case 's':
+    resume(dbg, cpu, pkt, 1);
+    break;
+
+  case 'Z':
+  case 'z':
+    set_point(dbg, pkt, pkt[0] == 'Z');
+    update_cpu(dbg, cpu);
+    break;
+
+  case 'H':
+    send_packet(dbg, "OK");
+    break;
+
+  case 'q':
+    if(!strncmp(pkt, "qSupported", 10)){
+      send_packet(dbg, "PacketSize=1000");
+    } else if(!strcmp(pkt, "qAttached")){
+      send_packet(dbg, "1");
+    } else{
+      send_packet(dbg, "");
+    }
+    break;
+
+  case 'D':
+    send_packet(dbg, "OK");
+    detach(dbg, cpu);
+    break;
+
+  case 'k':
+    detach(dbg, cpu);
+    return -1;
+
+  case 0x03:
+    send_packet(dbg, "S02");
+    break;
+
+  default:
+    // an empty reply tells gdb we don't support the packet
+    send_packet(dbg, "");
+    break;
+  }
+  return 0;
+}
+
+/*
+ * Talks to gdb; called by the run loop between batches of instructions.
+ * While the program is running this only checks for an interrupt
+ * request, while it is stopped it serves gdb until it resumes it.
+ * Returns -1 if gdb asked us to quit.
+ */
+int gdb_poll(struct debugger *dbg, struct cpu_info *cpu){
+  if(dbg->fd < 0) return 0;
+
+  if(!dbg->stopped){
+    if(cpu->finished){
+      dbg->stopped = 1;
+      send_packet(dbg, "S05");
+    } else{
+      int c;
+      while((c = read_byte(dbg, 0)) >= 0){
+	if(c == 0x03){
+	  dbg->stopped = 1;
+	  dbg->stepping = 0;
+	  update_cpu(dbg, cpu);
+	  send_packet(dbg, "S02");
+	  break;
+	}
+      }
+    }
+  }
+
+  char pkt[sizeof(dbg->in)];
+  while(dbg->stopped){
+    if(recv_packet(dbg, pkt, sizeof(pkt)) < 0){
+      // gdb went away, so just carry on
+      detach(dbg, cpu);
+      break;
+    }
+    if(handle_packet(dbg, cpu, pkt) < 0) return -1;
+  }
+  return 0;
+}
+
+
+/*
+ * ============================================
+ * THE SLOW PATH
+ * ============================================
+ */
+
+// the memory accesses an instruction makes through its operand
+#define ACCESS_READ 1
+#define ACCESS_WRITE 2
+
+static int operand_access(uint8_t instr){
+  enum AddressMode mode = decode_table[instr].mode;
+  if(mode == imm || mode == rel || mode == noAddressMode) return 0;
+
+  switch(decode_table[instr].op){
+  case ADC: case AND: case BIT: case CMP: case CPX: case CPY:
+  case EOR: case LDA: case LDX: case LDY: case ORA: case SBC:
+    return ACCESS_READ;
+  case STA: case STX: case STY:
+    return ACCESS_WRITE;
+  case ASL: case DEC: case INC: case LSR: case ROL: case ROR:
+    return ACCESS_READ | ACCESS_WRITE;
+  default:
+    return 0;
+  }
+}
+
+static int stop(struct debugger *dbg, struct cpu_info *cpu, const char *reply){
+  dbg->stopped = 1;
+  dbg->stepping = 0;
+  update_cpu(dbg, cpu);
+  send_packet(dbg, reply);
+  return 1;
+}
+
+/*
+ * Runs instructions one by one up to deadline, checking each one against
+ * the breakpoints and watchpoints. Only used while cpu->debug is set.
+ * Returns 1 if the program stopped for the debugger.
+ */
+int debug_run(struct cpu_info *cpu, uint64_t deadline){
+  struct debugger *dbg = cpu->debug;
+  while(!cpu->finished && cpu->clock < deadline){
+    if(dbg->resuming){
+      dbg->resuming = 0;
+    } else if(test_bit(dbg->breakpoints, cpu->pc)){
+      return stop(dbg, cpu, "S05");
+    }
+
+    uint8_t instr = read8(cpu->mem, cpu->pc);
+    int access = operand_access(instr);
+    const char *watch = NULL;
+    uint16_t addr = 0;
+    if(access){
+      addr = effective_address(cpu);
+      int r = (access & ACCESS_READ) && test_bit(dbg->watch_read, addr);
+      int w = (access & ACCESS_WRITE) && test_bit(dbg->watch_write, addr);
+      if(r && w) watch = "awatch";
+      else if(r) watch = "rwatch";
+      else if(w) watch = "watch";
+    }
+
+    execute_instruction(cpu);
+
+    if(watch){
+      char reply[32];
+      snprintf(reply, sizeof(reply), "T05%s:%04x;", watch, addr);
+      return stop(dbg, cpu, reply);
+    }
+    if(dbg->stepping){
+      return stop(dbg, cpu, "S05");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include <stdint.h>
+
+#include "6502.h"
+
+/*
+ * A GDB remote serial protocol server, so the emulated program can be
+ * debugged with gdb (or anything else that speaks RSP) over a local TCP
+ * port or Unix socket.
+ *
+ * Breakpoints and watchpoints are kept as bitmaps with one bit per
+ * address. The cpu only points at the debugger (cpu->debug) while some
+ * are armed or we are single stepping, so the run loop checks for them
+ * once per scheduler deadline rather than per instruction, and a session
+ * with nothing armed runs at full speed.
+ *
+ * Registers are exchanged in the order a, x, y, p, s (8 bits each) and
+ * pc (16 bits, little endian).
+ */
+
+#define DEBUG_BITMAP_WORDS (0x10000 / 64)
+
+struct debugger{
+  int listen_fd;
+  int fd;
+
+  uint64_t breakpoints[DEBUG_BITMAP_WORDS];
+  uint64_t watch_read[DEBUG_BITMAP_WORDS];
+  uint64_t watch_write[DEBUG_BITMAP_WORDS];
+  // number of bits set across all of the bitmaps
+  int armed;
+
+  int stopped;
+  int stepping;
+  // resuming from a breakpoint mustn't immediately hit it again
+  int resuming;
+
+  char in[4096];
+  int in_len;
+  int in_pos;
+};
+
+int gdb_listen(struct debugger *dbg, const char *where);
+void gdb_close(struct debugger *dbg);
+int gdb_poll(struct debugger *dbg, struct cpu_info *cpu);
+
+int debug_run(struct cpu_info *cpu, uint64_t deadline);
+
+#endif
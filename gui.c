@@ -12,16 +12,27 @@
 #include <X11/Xos.h>
 
 #include "6502.h"
-
-#define WIDTH 32
-#define HEIGHT 32
+#include "sched.h"
+#include "gdbstub.h"
+#include "metrics.h"
+#include "movie.h"
+#include "machine.h"
+#include "screen.h"
+#include "heatmap.h"
+#include "plugin.h"
+#include "blit.h"
 
 long my_event_mask = KeyPressMask;
 
+// where 'm' saves the heatmap it took
+#define HEATMAP_PREFIX "heatmap"
+
 Display *dis;
 int screen;
 Window win;
 GC gc;
+// what convert_to_image() draws the screen into
+XImage *image;
 
 uint32_t rgba8 (uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
   return ((((a)&0xFF)<<24) | (((b)&0xFF)<<16) | (((g)&0xFF)<<8) | (((r)&0xFF)<<0));
@@ -31,13 +42,24 @@ uint32_t rgb8 (uint8_t r, uint8_t g, uint8_t b) {
 }
 
 
+// stops taking a heatmap, saving it and printing its counts by region
+void finish_heatmap(struct cpu_info *cpu, struct heatmap *heat){
+  heatmap_stop(cpu);
+  heatmap_print_regions(heat, stdout);
+  if(heatmap_save(heat, HEATMAP_PREFIX ".heat") == 0 &&
+     heatmap_render(heat, HEATMAP_PREFIX ".ppm", 2) == 0){
+    printf("saved " HEATMAP_PREFIX ".heat and " HEATMAP_PREFIX ".ppm\n");
+  }
+  heatmap_free(heat);
+}
+
 //stuff for timing
-//gets time in ms
+//gets time in us
 long long get_timestamp() {
     struct timeval t; 
     gettimeofday(&t, NULL); 
-    long long ms = t.tv_sec*1000LL + t.tv_usec/1000; 
-    return ms;
+    long long us = t.tv_sec*1000000LL + t.tv_usec; 
+    return us;
 }
 
 // we put this in atexit
@@ -45,6 +67,7 @@ void close_x() {
   //ensure we only run this once
   static Bool cont = True;
   if(cont){
+    if(image) XDestroyImage(image);
     XFreeGC(dis, gc);
     XDestroyWindow(dis,win);
     XCloseDisplay(dis);
@@ -77,46 +100,138 @@ void init_x() {
   XMapRaised(dis, win);
 }
 
-uint32_t pallette[16] = {
-  0xff000000, 0xffffffff, 0xff880000, 0xffaaffee,
-  0xffcc44cc, 0xff00cc55, 0xff0000aa, 0xffeeee77,
-  0xffdd8855, 0xff664400, 0xffff7777, 0xff333333,
-  0xff777777, 0xffaaff66, 0xff0088ff, 0xffbbbbbb
-};
-
+/*
+ * The screen is scaled into an image the size of the window (as near as
+ * whole numbers allow), which is remade when the window changes size,
+ * and sent to the server in one go.
+ */
 void convert_to_image(struct cpu_info *cpu){
   XWindowAttributes wa;
-  Status wc = XGetWindowAttributes(dis, win, &wa);
-  
-  int w_scale = wa.width / WIDTH;
-  int h_scale = wa.height / HEIGHT;
-  
-  for(int i = 0x200; i <= 0x5ff; i++){
-    uint32_t colour = pallette[read8(cpu->mem,i) & 0x0f];
-    int y = (i - 0x200) / HEIGHT;
-    int x = (i - 0x200) % WIDTH;
-
-    XSetForeground(dis,gc, colour);
-    XFillRectangle(dis, win, gc, x*w_scale, y*h_scale, w_scale, h_scale);
+  if(!XGetWindowAttributes(dis, win, &wa)) return;
+
+  int w_scale = wa.width / SCREEN_WIDTH;
+  int h_scale = wa.height / SCREEN_HEIGHT;
+  if(w_scale < 1 || h_scale < 1) return;
+  int width = SCREEN_WIDTH * w_scale;
+  int height = SCREEN_HEIGHT * h_scale;
+
+  if(!image || image->width != width || image->height != height){
+    if(image) XDestroyImage(image);
+    char *data = malloc(sizeof(uint32_t) * width * height);
+    image = XCreateImage(dis, DefaultVisual(dis, screen), DefaultDepth(dis, screen),
+			 ZPixmap, 0, data, width, height, 32, 0);
+    if(!image){
+      free(data);
+      return;
+    }
   }
+
+  uint32_t pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+  render_screen(cpu, pixels);
+  blit_scale(blit_best(), pixels, SCREEN_WIDTH, SCREEN_HEIGHT, (uint32_t *)image->data,
+	     image->bytes_per_line / sizeof(uint32_t), w_scale, h_scale);
+  XPutImage(dis, win, gc, image, 0, 0, 0, 0, width, height);
 }
 
 
+void usage(const char *name){
+  fprintf(stderr, "usage: %s [-a frames] [-g gdb_port_or_socket | -r movie]\n"
+	  "          [-c | -P plugin.so[:args]...] program.bin\n", name);
+  exit(1);
+}
+
 int main(int argc, char **argv){
-  if(argc < 2) return 0;
+  const char *gdb_where = NULL;
+  const char *movie_path = NULL;
+  int run_ahead = 0;
+  // with -c memory accesses are counted by region for ricoh-stat, which
+  // takes the generic metered core, so it is opt in
+  int count_regions = 0;
+  // with -P plugins watch the program, see plugin.h
+  struct plugin_host plugins;
+  plugins_init(&plugins);
+  int opt;
+  while((opt = getopt(argc, argv, "a:g:r:cP:")) != -1){
+    switch(opt){
+    case 'a': run_ahead = atoi(optarg); break;
+    case 'g': gdb_where = optarg; break;
+    case 'r': movie_path = optarg; break;
+    case 'c': count_regions = 1; break;
+    case 'P':
+      if(plugins_load(&plugins, optarg) < 0) return 1;
+      break;
+    default: usage(argv[0]);
+    }
+  }
+  if(optind >= argc) return 0;
+  // gdb can change anything at any time, which a movie can't replay
+  if(gdb_where && movie_path) usage(argv[0]);
+  // plugins run the cpu on a core of their own, which keeps no counts
+  if(count_regions && plugins.count) usage(argv[0]);
   /*
    * The NES maps the rom to 0x8000 - 0xFFFF
    * For the easy NES tutorial, The PC begins at 0x0600, so we load the code there.
    */
-  struct cpu_info cpu;
-  struct memory * mem = make_flat_2k_mem();
-  init_cpu_info(&cpu, mem);
-  FILE * file = fopen(argv[1], "r");
-  load_file_to_mem(file, &cpu, 0x0600);
+  struct machine *machine = machine_create(make_flat_2k_mem());
+  struct cpu_info *cpu = &machine->cpu;
+  FILE * file = fopen(argv[optind], "r");
+  if(!file){
+    perror(argv[optind]);
+    return 1;
+  }
+  int image_len = load_file_to_mem(file, cpu, 0x0600);
   fclose(file);
-  cpu.pc = 0x0600;
-  cpu.s = 0xFF;
+  cpu->pc = 0x0600;
+  cpu->s = 0xFF;
+
+  // with -r everything sent to the program is recorded, see ricoh-replay
+  struct movie recording;
+  struct movie *movie = NULL;
+  if(movie_path){
+    // the image as loaded, which wraps round the 2k past 0x07FF
+    uint8_t image[MOVIE_RAM];
+    mem_read_block(cpu->mem, 0x0600, image, image_len);
+    if(movie_record(&recording, movie_path, image,
+		    image_len, 0x0600, cpu->pc, CYCLES_PER_FRAME) < 0) return 1;
+    movie = &recording;
+  }
+
+  struct scheduler sched;
+  init_scheduler(&sched);
 
+  /*
+   * With -a the window shows a clone of the machine run that many frames
+   * ahead, as though the keys (and random number) stayed as they are, so
+   * key presses show up that much sooner. The clone is redone from the
+   * real machine every frame, so a wrong guess only lasts a frame.
+   */
+  struct machine *ahead = NULL;
+  struct scheduler ahead_sched;
+  struct cpu_info *shown = cpu;
+  if(run_ahead > 0){
+    ahead = machine_arena(machine);
+    init_scheduler(&ahead_sched);
+    shown = &ahead->cpu;
+  }
+
+  // with -g the program starts stopped, waiting for gdb to connect
+  struct debugger dbg;
+  Bool debugging = False;
+  if(gdb_where){
+    if(gdb_listen(&dbg, gdb_where) < 0) return 1;
+    debugging = True;
+  }
+
+  // live metrics, see ricoh-stat
+  struct metrics *metrics = metrics_create();
+  struct access_counts counts;
+  if(metrics && count_regions){
+    metrics_count_regions(cpu, &counts);
+  }
+  if(plugins.count) plugins_attach(&plugins, cpu);
+
+  // 'm' starts taking a heatmap of memory accesses, and 'm' again stops it
+  struct heatmap *heat = NULL;
 
   init_x();
   atexit(close_x);
@@ -124,10 +239,6 @@ int main(int argc, char **argv){
   KeySym key;	
   char text[255];
 
-	
-  int scale = 10;
-  XImage *img = NULL;
-
   //small programs can exit to quickly
   // display properly, so we wait 1 second
   // for the X window to pop up
@@ -137,74 +248,89 @@ int main(int argc, char **argv){
   wait.tv_nsec = 0;
   nanosleep(&wait, NULL);
   
-  int breakPt = INT32_MAX;
-  Bool breaking = False;
-  while(1) {		
+  Bool quit = False;
+  while(!quit) {		
     long long start = get_timestamp();
-    //XNextEvent(dis, &event);
     //A non blocking version of XNextEvent, returns true if event is there.
-    Bool isEvent = XCheckMaskEvent(dis, my_event_mask, &event);
-    if(cpu.visual_dirty){
-      convert_to_image(&cpu);
-      cpu.visual_dirty = 0;
-    }
-
-    write8(cpu.mem, 0xfe, rand() % 256);
-    if(isEvent){
+    while(XCheckMaskEvent(dis, my_event_mask, &event)){
       // handle key events etc
       if (event.type==Expose && event.xexpose.count==0) {
-	convert_to_image(&cpu);
+	convert_to_image(shown);
       }
       if (event.type==KeyPress&& XLookupString(&event.xkey,text,255,&key,0)==1) {
 	/* use the XLookupString routine to convert the invent
 	 */
 	if (text[0]=='w') {
-	  write8(cpu.mem, 0xff, 0x77);
+	  movie_inject(movie, cpu, 0xff, 0x77);
 	} else if (text[0]=='s') {
-	  write8(cpu.mem, 0xff, 0x73);
+	  movie_inject(movie, cpu, 0xff, 0x73);
 	} else if (text[0]=='d') {
-	  write8(cpu.mem, 0xff, 0x64);
+	  movie_inject(movie, cpu, 0xff, 0x64);
 	} else if (text[0]=='a') {
-	  write8(cpu.mem, 0xff, 0x61);
+	  movie_inject(movie, cpu, 0xff, 0x61);
 	}
 
 	if (text[0]=='q') {
-	  break;
+	  quit = True;
+	}
+
+	if (text[0]=='m') {
+	  if(heat){
+	    finish_heatmap(cpu, heat);
+	    heat = NULL;
+	  } else if((heat = heatmap_create()) && heatmap_start(cpu, heat) < 0){
+	    fprintf(stderr, "no heatmap while plugins are loaded\n");
+	    heatmap_free(heat);
+	    heat = NULL;
+	  }
 	}
 
       }
     }
-    if(!cpu.finished){
-      // here we handle a cycle like normal
-      // my poor calculations say we should wait around 600 ns per cycle
-      
-      step(&cpu);
-
-      if(cpu.pc == breakPt){
-	breaking = True;
-	printf("==============================\n");
-	printf("\nreached break point\n");
-	printf("snakedirections %x, snake length %x\n", cpu.mem[0x02], cpu.mem[0x03]);
-	printf("==============================\n");
-      }
 
-	    
-      if(breaking){
-	cpu.cycles = 0;
-	char c = getchar();
-	if(c == 'c'){
-	  breaking = False;
-	} else if (c == 'q'){
-	  return 0;
-	}
+    // blocks here while gdb has the program stopped
+    if(debugging && gdb_poll(&dbg, cpu) < 0){
+      break;
+    }
+
+    movie_inject(movie, cpu, 0xfe, rand() % 256);
+    run_until(cpu, &sched, cpu->clock + CYCLES_PER_FRAME);
+    plugins_frame(cpu);
+
+    if(ahead){
+      machine_clone(ahead, machine);
+      cpu->visual_dirty = 0;
+      for(int i = 0; i < run_ahead; i++){
+	run_until(&ahead->cpu, &ahead_sched, ahead->cpu.clock + CYCLES_PER_FRAME);
       }
     }
+
+    if(shown->visual_dirty){
+      convert_to_image(shown);
+      shown->visual_dirty = 0;
+    }
+
+    metrics_publish(metrics, cpu);
+
     long long end = get_timestamp();
-    struct timespec t;
-    t.tv_sec =0;
-    t.tv_nsec = (600) - (end - start);
-    nanosleep(&t, NULL);
+    long long remaining = 1000000 / FRAME_RATE - (end - start);
+    // a frame that overruns its time is counted as dropped
+    metrics_frame(metrics, end - start, remaining <= 0);
+    if(remaining > 0){
+      struct timespec t;
+      t.tv_sec = 0;
+      t.tv_nsec = remaining * 1000;
+      nanosleep(&t, NULL);
+      metrics_sleep(metrics, remaining, get_timestamp() - end);
+    }
   }
 
+  if(heat) finish_heatmap(cpu, heat);
+  plugins_unload(&plugins, cpu, stdout);
+  if(movie) movie_finish(movie, cpu);
+  if(debugging) gdb_close(&dbg);
+  if(metrics) metrics_destroy(metrics);
+  if(ahead) machine_free(ahead);
+  machine_free(machine);
   return 0;
 }
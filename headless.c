@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "6502.h"
+#include "sched.h"
+#include "metrics.h"
+#include "movie.h"
+#include "machine.h"
+#include "screen.h"
+#include "share.h"
+
+/*
+ * Runs an easy 6502 program like gui does, but with no window: frames
+ * are published through a share (see share.h) for ricoh-view, or anything
+ * else, to show, and key presses come back the same way. Runs until it
+ * is interrupted, or for -n frames.
+ */
+
+static volatile sig_atomic_t quit = 0;
+
+static void stop(int sig){
+  quit = 1;
+}
+
+static long long get_timestamp(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000LL + t.tv_nsec / 1000;
+}
+
+static void usage(const char *name){
+  fprintf(stderr, "usage: %s [-u] [-n frames] [-r movie] program.bin\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv){
+  int unthrottled = 0;
+  long long frames = -1;
+  const char *movie_path = NULL;
+  int opt;
+  while((opt = getopt(argc, argv, "un:r:")) != -1){
+    switch(opt){
+    case 'u': unthrottled = 1; break;
+    case 'n': frames = atoll(optarg); break;
+    case 'r': movie_path = optarg; break;
+    default: usage(argv[0]);
+    }
+  }
+  if(optind >= argc) usage(argv[0]);
+
+  struct machine *machine = machine_create(make_flat_2k_mem());
+  struct cpu_info *cpu = &machine->cpu;
+  FILE *file = fopen(argv[optind], "r");
+  if(!file){
+    perror(argv[optind]);
+    return 1;
+  }
+  int image_len = load_file_to_mem(file, cpu, 0x0600);
+  fclose(file);
+  cpu->pc = 0x0600;
+  cpu->s = 0xFF;
+
+  struct movie recording;
+  struct movie *movie = NULL;
+  if(movie_path){
+    // the image as loaded, which wraps round the 2k past 0x07FF
+    uint8_t image[MOVIE_RAM];
+    mem_read_block(cpu->mem, 0x0600, image, image_len);
+    if(movie_record(&recording, movie_path, image,
+		    image_len, 0x0600, cpu->pc, CYCLES_PER_FRAME) < 0) return 1;
+    movie = &recording;
+  }
+
+  struct scheduler sched;
+  init_scheduler(&sched);
+
+  struct share share;
+  if(share_create(&share, SCREEN_WIDTH, SCREEN_HEIGHT) < 0) return 1;
+  fprintf(stderr, "frames at /proc/%d/fd/%d\n", getpid(), share.fd);
+
+  struct metrics *metrics = metrics_create();
+
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  for(long long frame = 0; !quit && frame != frames; frame++){
+    long long start = get_timestamp();
+
+    struct share_input input;
+    while(share_input(&share, &input)){
+      movie_inject(movie, cpu, input.addr, input.value);
+    }
+    movie_inject(movie, cpu, 0xfe, rand() % 256);
+    run_until(cpu, &sched, cpu->clock + CYCLES_PER_FRAME);
+
+    // only frames that changed are published
+    if(cpu->visual_dirty){
+      render_screen(cpu, share_frame(&share));
+      share_publish(&share);
+      cpu->visual_dirty = 0;
+    }
+
+    metrics_publish(metrics, cpu);
+
+    long long end = get_timestamp();
+    long long remaining = 1000000 / FRAME_RATE - (end - start);
+    metrics_frame(metrics, end - start, remaining <= 0);
+    if(!unthrottled && remaining > 0){
+      struct timespec t;
+      t.tv_sec = 0;
+      t.tv_nsec = remaining * 1000;
+      nanosleep(&t, NULL);
+      metrics_sleep(metrics, remaining, get_timestamp() - end);
+    }
+  }
+
+  if(movie) movie_finish(movie, cpu);
+  share_destroy(&share);
+  if(metrics) metrics_destroy(metrics);
+  machine_free(machine);
+  return 0;
+}
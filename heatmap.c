@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "heatmap.h"
+#include "video.h"
+
+const char *heat_kind_strings[HEAT_KINDS] = { "reads", "writes", "fetches" };
+
+/*
+ * The heatmap core: the generic core with every access counted against
+ * its address. The region counts of the metered core are kept up too, so
+ * live metrics carry on while a heatmap is taken.
+ */
+static inline void heat_count(struct cpu_info *cpu, enum heat_kind kind, uint16_t addr){
+  cpu->heat->counts[kind][addr]++;
+  if(cpu->counts){
+    if(kind == HEAT_WRITE){
+      cpu->counts->writes[region_by_page[addr >> 8]]++;
+    } else{
+      cpu->counts->reads[region_by_page[addr >> 8]]++;
+    }
+  }
+}
+
+static inline uint8_t heat_read8(struct cpu_info *cpu, uint16_t addr, enum heat_kind kind){
+  heat_count(cpu, kind, addr);
+  return read8(cpu->mem, addr);
+}
+
+static inline uint16_t heat_read16(struct cpu_info *cpu, uint16_t addr, enum heat_kind kind){
+  uint16_t lo = heat_read8(cpu, addr, kind);
+  uint16_t hi = heat_read8(cpu, addr + 1, kind) << 8;
+  return hi | lo;
+}
+
+static inline void heat_write8(struct cpu_info *cpu, uint16_t addr, uint8_t val){
+  heat_count(cpu, HEAT_WRITE, addr);
+  cpu_write8(cpu, addr, val);
+}
+
+#define READ8(cpu, addr) heat_read8((cpu), (addr), HEAT_READ)
+#define READ16(cpu, addr) heat_read16((cpu), (addr), HEAT_READ)
+#define FETCH8(cpu, addr) heat_read8((cpu), (addr), HEAT_FETCH)
+#define FETCH16(cpu, addr) heat_read16((cpu), (addr), HEAT_FETCH)
+#define WRITE8(cpu, addr, val) heat_write8((cpu), (addr), (val))
+
+#define CORE_NAME heatmap
+#include "6502_core.h"
+
+
+struct heatmap *heatmap_create(){
+  return calloc(1, sizeof(struct heatmap));
+}
+
+void heatmap_free(struct heatmap *heat){
+  free(heat);
+}
+
+// counts are added to whatever heat already holds
+int heatmap_start(struct cpu_info *cpu, struct heatmap *heat){
+  if(cpu->plugins) return -1;
+  if(cpu->heat) return 0;
+  heat->resume = cpu->core;
+  cpu->heat = heat;
+  cpu->core = &heatmap_core;
+  return 0;
+}
+
+void heatmap_stop(struct cpu_info *cpu){
+  if(!cpu->heat) return;
+  cpu->core = cpu->heat->resume;
+  cpu->heat = NULL;
+}
+
+void heatmap_regions(const struct heatmap *heat, uint64_t regions[REGION_COUNT][HEAT_KINDS]){
+  memset(regions, 0, sizeof(uint64_t) * REGION_COUNT * HEAT_KINDS);
+  for(int kind = 0; kind < HEAT_KINDS; kind++){
+    for(int addr = 0; addr < 0x10000; addr++){
+      regions[region_by_page[addr >> 8]][kind] += heat->counts[kind][addr];
+    }
+  }
+}
+
+void heatmap_print_regions(const struct heatmap *heat, FILE *out){
+  uint64_t regions[REGION_COUNT][HEAT_KINDS];
+  heatmap_regions(heat, regions);
+  uint64_t total = 0;
+  for(int r = 0; r < REGION_COUNT; r++){
+    for(int kind = 0; kind < HEAT_KINDS; kind++) total += regions[r][kind];
+  }
+
+  fprintf(out, "%-10s %14s %14s %14s %7s\n", "region",
+	  heat_kind_strings[HEAT_READ], heat_kind_strings[HEAT_WRITE],
+	  heat_kind_strings[HEAT_FETCH], "share");
+  for(int r = 0; r < REGION_COUNT; r++){
+    uint64_t sum = regions[r][HEAT_READ] + regions[r][HEAT_WRITE] + regions[r][HEAT_FETCH];
+    fprintf(out, "%-10s %14llu %14llu %14llu %6.2f%%\n", region_strings[r],
+	    (unsigned long long)regions[r][HEAT_READ],
+	    (unsigned long long)regions[r][HEAT_WRITE],
+	    (unsigned long long)regions[r][HEAT_FETCH],
+	    total ? 100.0 * sum / total : 0.0);
+  }
+}
+
+int heatmap_save(const struct heatmap *heat, const char *path){
+  FILE *file = fopen(path, "wb");
+  if(!file){
+    perror(path);
+    return -1;
+  }
+  uint32_t header[2] = { HEATMAP_MAGIC, HEATMAP_VERSION };
+  fwrite(header, sizeof(header), 1, file);
+  fwrite(heat->counts, sizeof(heat->counts), 1, file);
+  if(fclose(file) != 0){
+    perror(path);
+    return -1;
+  }
+  return 0;
+}
+
+int heatmap_render(const struct heatmap *heat, const char *path, int scale){
+  // red, green and blue, by kind
+  static const int shift[HEAT_KINDS] = { [HEAT_READ] = 8, [HEAT_WRITE] = 16, [HEAT_FETCH] = 0 };
+  double top[HEAT_KINDS];
+  for(int kind = 0; kind < HEAT_KINDS; kind++){
+    uint64_t most = 0;
+    for(int addr = 0; addr < 0x10000; addr++){
+      if(heat->counts[kind][addr] > most) most = heat->counts[kind][addr];
+    }
+    top[kind] = log1p(most);
+  }
+
+  int width = 256 * scale;
+  uint32_t *pixels = malloc(sizeof(uint32_t) * width * width);
+  if(!pixels) return -1;
+  for(int addr = 0; addr < 0x10000; addr++){
+    uint32_t pixel = 0xFF000000;
+    for(int kind = 0; kind < HEAT_KINDS; kind++){
+      uint64_t count = heat->counts[kind][addr];
+      if(count) pixel |= (uint32_t)(255 * log1p(count) / top[kind]) << shift[kind];
+    }
+    int x = (addr & 0xFF) * scale, y = (addr >> 8) * scale;
+    for(int dy = 0; dy < scale; dy++){
+      for(int dx = 0; dx < scale; dx++){
+	pixels[(y + dy) * width + x + dx] = pixel;
+      }
+    }
+  }
+
+  struct video video;
+  if(video_open(&video, path, VIDEO_PPM, width, width, 0) < 0){
+    free(pixels);
+    return -1;
+  }
+  int result = video_frame(&video, pixels);
+  if(video_close(&video) < 0) result = -1;
+  free(pixels);
+  return result;
+}
@@ -0,0 +1,59 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "6502.h"
+#include "metrics.h"
+
+/*
+ * A heatmap of memory accesses: how many times each address was read,
+ * written and fetched from as part of an instruction (its opcode or
+ * operand), for tuning how memory is mapped and cached.
+ *
+ * Counting is done by the heatmap core, which heatmap_start() switches the
+ * cpu to and heatmap_stop() switches it back from, so it can be turned on
+ * and off at any point between instructions and costs nothing while off.
+ * Reads made by fetching aren't counted again as reads.
+ */
+
+#define HEATMAP_MAGIC 0x504D4852 // "RHMP"
+#define HEATMAP_VERSION 1
+
+enum heat_kind{ HEAT_READ, HEAT_WRITE, HEAT_FETCH, HEAT_KINDS };
+
+extern const char *heat_kind_strings[HEAT_KINDS];
+
+struct heatmap{
+  uint64_t counts[HEAT_KINDS][0x10000];
+  // the core the cpu was running before heatmap_start()
+  const struct cpu_core *resume;
+};
+
+struct heatmap *heatmap_create();
+void heatmap_free(struct heatmap *heat);
+
+// fails, returning -1, while plugins are attached, as they have a core of their own
+int heatmap_start(struct cpu_info *cpu, struct heatmap *heat);
+void heatmap_stop(struct cpu_info *cpu);
+
+// sums the counts by the regions of metrics.h
+void heatmap_regions(const struct heatmap *heat, uint64_t regions[REGION_COUNT][HEAT_KINDS]);
+void heatmap_print_regions(const struct heatmap *heat, FILE *out);
+
+/*
+ * The dump is a header of HEATMAP_MAGIC and HEATMAP_VERSION (as uint32s)
+ * followed by the counts, each kind in turn, as 64K little endian uint64s;
+ * e.g. numpy.fromfile(path, "<u8", offset=8).reshape(3, 256, 256).
+ */
+int heatmap_save(const struct heatmap *heat, const char *path);
+
+/*
+ * Renders the heatmap as a PPM, a page to a row: 256x256 pixels, each
+ * scale times over. Writes are red, reads green and fetches blue, each on
+ * a log scale up to the busiest address.
+ */
+int heatmap_render(const struct heatmap *heat, const char *path, int scale);
+
+#endif
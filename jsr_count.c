@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "plugin.h"
+
+/*
+ * A sample plugin: counts the calls made to each subroutine, and lists
+ * the most called when it is unloaded. Its argument is how many to list
+ * (20 by default), e.g.
+ *
+ *   ./ricoh -P jsr_count.so:10 binary/snake.bin
+ */
+
+#define JSR 0x20
+
+struct jsr_counts{
+  int top;
+  uint64_t calls;
+  uint64_t counts[0x10000];
+};
+
+static void on_instruction(void *ctx, struct cpu_info *cpu, uint8_t opcode){
+  struct jsr_counts *jsr = ctx;
+  if(opcode != JSR) return;
+  jsr->counts[read16(cpu->mem, cpu->pc + 1)]++;
+  jsr->calls++;
+}
+
+static void on_finish(void *ctx, struct cpu_info *cpu, FILE *out){
+  struct jsr_counts *jsr = ctx;
+  fprintf(out, "%llu subroutine calls\n", (unsigned long long)jsr->calls);
+  // picks the busiest target left each time, which is plenty for a top few
+  for(int i = 0; i < jsr->top; i++){
+    int best = -1;
+    for(int addr = 0; addr < 0x10000; addr++){
+      if(jsr->counts[addr] && (best < 0 || jsr->counts[addr] > jsr->counts[best])){
+	best = addr;
+      }
+    }
+    if(best < 0) break;
+    fprintf(out, "  %04x %12llu %6.2f%%\n", best, (unsigned long long)jsr->counts[best],
+	    100.0 * jsr->counts[best] / jsr->calls);
+    jsr->counts[best] = 0;
+  }
+  free(jsr);
+}
+
+int ricoh_plugin_init(struct ricoh_plugin *plugin, const char *args){
+  if(plugin->abi != RICOH_PLUGIN_ABI) return -1;
+  struct jsr_counts *jsr = calloc(1, sizeof(struct jsr_counts));
+  if(!jsr) return -1;
+  jsr->top = *args ? atoi(args) : 20;
+  plugin->ctx = jsr;
+  plugin->instruction = on_instruction;
+  plugin->finish = on_finish;
+  return 0;
+}
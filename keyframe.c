@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "keyframe.h"
+#include "6502_ops.h"
+
+static void save(struct keyframe *frame, struct movie *movie, struct cpu_info *cpu){
+  frame->clock = cpu->clock;
+  frame->instructions = cpu->instructions;
+  frame->offset = movie_tell(movie);
+  frame->a = cpu->a;
+  frame->x = cpu->x;
+  frame->y = cpu->y;
+  frame->s = cpu->s;
+  frame->pc = cpu->pc;
+  frame->status = STATUS_BYTE(cpu, 0);
+  frame->finished = cpu->finished;
+  mem_read_block(cpu->mem, 0, frame->ram, MOVIE_RAM);
+}
+
+static void restore(struct keyframe *frame, struct cpu_info *cpu){
+  cpu->clock = frame->clock;
+  cpu->instructions = frame->instructions;
+  cpu->cycles = 0;
+  cpu->a = frame->a;
+  cpu->x = frame->x;
+  cpu->y = frame->y;
+  cpu->s = frame->s;
+  cpu->pc = frame->pc;
+  SET_STATUS(cpu, frame->status);
+  cpu->finished = frame->finished;
+  cpu->visual_dirty = 1;
+  mem_write_block(cpu->mem, 0, frame->ram, MOVIE_RAM);
+}
+
+static uint64_t movie_size(struct movie *movie){
+  struct stat st;
+  if(fstat(fileno(movie->file), &st) < 0) return 0;
+  return st.st_size;
+}
+
+/*
+ * Replays the whole of a movie from the start, writing a keyframe to path
+ * every interval frames (and one at the start).
+ */
+int keyframe_build(const char *path, struct movie *movie, struct cpu_info *cpu,
+		   struct scheduler *sched, uint32_t interval){
+  FILE *file = fopen(path, "wb");
+  if(!file){
+    perror(path);
+    return -1;
+  }
+
+  struct keyframe_header header;
+  memcpy(header.magic, KEYFRAME_MAGIC, 4);
+  header.version = KEYFRAME_VERSION;
+  header.interval = interval;
+  header.count = 0;
+  header.movie_size = movie_size(movie);
+  fwrite(&header, sizeof(header), 1, file);
+
+  uint64_t step = (uint64_t)interval * movie->frame_cycles;
+  struct keyframe frame;
+  int status = 0;
+  for(uint64_t at = cpu->clock; ; at += step){
+    if(movie_play(movie, cpu, sched, at) < 0){
+      status = -1;
+      break;
+    }
+    // past the end of the recording
+    if(cpu->clock < at && header.count > 0) break;
+    save(&frame, movie, cpu);
+    fwrite(&frame, sizeof(frame), 1, file);
+    header.count++;
+  }
+
+  header.movie_hash = movie->ended ? movie->end_hash : machine_hash(cpu);
+  rewind(file);
+  fwrite(&header, sizeof(header), 1, file);
+  if(fclose(file) != 0){
+    perror(path);
+    return -1;
+  }
+  return status;
+}
+
+int keyframe_open(struct keyframe_index *index, const char *path, struct movie *movie){
+  int fd = open(path, O_RDONLY);
+  if(fd < 0){
+    perror(path);
+    return -1;
+  }
+  struct stat st;
+  if(fstat(fd, &st) < 0 || st.st_size < sizeof(struct keyframe_header)){
+    fprintf(stderr, "%s: not a keyframe index\n", path);
+    close(fd);
+    return -1;
+  }
+  index->size = st.st_size;
+  index->header = mmap(NULL, index->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(index->header == MAP_FAILED){
+    perror(path);
+    return -1;
+  }
+  index->frames = (struct keyframe *)(index->header + 1);
+
+  struct keyframe_header *header = index->header;
+  if(memcmp(header->magic, KEYFRAME_MAGIC, 4) || header->version != KEYFRAME_VERSION ||
+     index->size < sizeof(*header) + header->count * sizeof(struct keyframe) ||
+     header->count == 0){
+    fprintf(stderr, "%s: not a keyframe index this version can use\n", path);
+    keyframe_close(index);
+    return -1;
+  }
+  if(header->movie_size != movie_size(movie) ||
+     (movie->ended && header->movie_hash != movie->end_hash)){
+    fprintf(stderr, "%s: built from a different movie\n", path);
+    keyframe_close(index);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Puts the machine in the state the recording was in at cycle, restoring
+ * the last keyframe at or before it and replaying from there.
+ */
+int keyframe_seek(struct keyframe_index *index, struct movie *movie, struct cpu_info *cpu,
+		  struct scheduler *sched, uint64_t cycle){
+  struct keyframe *frames = index->frames;
+  int lo = 0, hi = index->header->count - 1;
+  while(lo < hi){
+    int mid = (lo + hi + 1) / 2;
+    if(frames[mid].clock <= cycle) lo = mid;
+    else hi = mid - 1;
+  }
+
+  restore(&frames[lo], cpu);
+  if(movie_seek(movie, frames[lo].offset) < 0){
+    perror("keyframe: seek");
+    return -1;
+  }
+  return movie_play(movie, cpu, sched, cycle);
+}
+
+void keyframe_close(struct keyframe_index *index){
+  munmap(index->header, index->size);
+  index->header = NULL;
+  index->frames = NULL;
+}
@@ -0,0 +1,59 @@
+#ifndef KEYFRAME_H
+#define KEYFRAME_H
+
+#include <stdint.h>
+
+#include "6502.h"
+#include "sched.h"
+#include "movie.h"
+
+/*
+ * A keyframe index lets a replay jump into the middle of a long movie
+ * without replaying it from power on. It is a sidecar file next to the
+ * movie holding the whole machine state every so many frames, along with
+ * where in the movie replaying carries on from. A seek restores the last
+ * keyframe before the cycle it wants and replays only the inputs after it.
+ *
+ * The index is a cache in the host's byte order, mapped straight into
+ * memory to seek; it is tied to the movie it was built from and can be
+ * rebuilt from it at any time.
+ */
+
+#define KEYFRAME_MAGIC "RKEY"
+#define KEYFRAME_VERSION 1
+
+struct keyframe{
+  uint64_t clock;
+  uint64_t instructions;
+  int64_t offset;
+  uint8_t a, x, y, s;
+  uint16_t pc;
+  uint8_t status;
+  uint8_t finished;
+  uint8_t ram[MOVIE_RAM];
+};
+
+struct keyframe_header{
+  char magic[4];
+  uint32_t version;
+  uint32_t interval;
+  uint32_t count;
+  // identifies the movie the index belongs to
+  uint64_t movie_size;
+  uint64_t movie_hash;
+};
+
+struct keyframe_index{
+  size_t size;
+  struct keyframe_header *header;
+  struct keyframe *frames;
+};
+
+int keyframe_build(const char *path, struct movie *movie, struct cpu_info *cpu,
+		   struct scheduler *sched, uint32_t interval);
+int keyframe_open(struct keyframe_index *index, const char *path, struct movie *movie);
+int keyframe_seek(struct keyframe_index *index, struct movie *movie, struct cpu_info *cpu,
+		  struct scheduler *sched, uint64_t cycle);
+void keyframe_close(struct keyframe_index *index);
+
+#endif
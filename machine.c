@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+#include "heatmap.h"
+#include "plugin.h"
+#include "metrics.h"
+
+static size_t machine_size(const struct machine *machine){
+  return sizeof(struct machine) + ((const struct memory *)machine->mem)->size;
+}
+
+// the cpu is aligned to a cache line (see struct cpu_info), so the block is too
+static struct machine *machine_alloc(size_t size){
+  return aligned_alloc(CACHE_LINE, (size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1));
+}
+
+/*
+ * Moves mem (which is freed) into a new machine, with a cpu set up for
+ * it as init_cpu_info does.
+ */
+struct machine *machine_create(struct memory *mem){
+  struct machine *machine = machine_alloc(sizeof(struct machine) + mem->size);
+  if(!machine) return NULL;
+  memcpy(machine->mem, mem, mem->size);
+  free(mem);
+  init_cpu_info(&machine->cpu, (struct memory *)machine->mem);
+  return machine;
+}
+
+// the machine's memory, as it is in the block
+static struct memory *machine_mem(struct machine *machine){
+  return (struct memory *)machine->mem;
+}
+
+// an arena that machines like this one can be cloned into
+struct machine *machine_arena(const struct machine *like){
+  size_t size = machine_size(like);
+  struct machine *arena = machine_alloc(size);
+  // with no memory in it yet, there is nothing to release on the first clone
+  if(arena) memset(arena, 0, size);
+  return arena;
+}
+
+// dst is an arena, or a machine that is thrown away
+void machine_clone(struct machine *dst, const struct machine *src){
+  struct memory *old = machine_mem(dst);
+  if(old->free_I) old->free_I(old);
+  memcpy(dst, src, machine_size(src));
+  dst->cpu.mem = machine_mem(dst);
+  if(dst->cpu.mem->clone_I) dst->cpu.mem->clone_I(dst->cpu.mem);
+  dst->cpu.debug = NULL;
+  heatmap_stop(&dst->cpu);
+  plugins_detach(&dst->cpu);
+  // the counts are the original's, so the clone runs uncounted
+  metrics_stop(&dst->cpu);
+}
+
+void machine_free(struct machine *machine){
+  struct memory *mem = machine_mem(machine);
+  if(mem->free_I) mem->free_I(mem);
+  free(machine);
+}
@@ -0,0 +1,30 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stddef.h>
+
+#include "6502.h"
+#include "memory.h"
+
+/*
+ * A machine is a cpu and its memory (devices included) laid out in one
+ * block, so a whole machine can be cloned with a single memcpy into an
+ * arena allocated for it up front; e.g. to run ahead of the real machine
+ * and throw the result away.
+ *
+ * Anything not part of the machine stays with the original: a clone has
+ * no debugger attached, takes no heatmap, has no plugins watching it and
+ * keeps no access counts.
+ */
+struct machine{
+  struct cpu_info cpu;
+  // the memory, mem.size bytes of it
+  _Alignas(max_align_t) unsigned char mem[];
+};
+
+struct machine *machine_create(struct memory *mem);
+struct machine *machine_arena(const struct machine *like);
+void machine_clone(struct machine *dst, const struct machine *src);
+void machine_free(struct machine *machine);
+
+#endif
@@ -1,30 +1,252 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
 
 #include "6502.h"
+#include "sched.h"
+#include "movie.h"
+#include "counter.h"
+#include "heatmap.h"
+#include "plugin.h"
+#include "screen.h"
+
+/*
+ * A headless runner: loads a program, runs it at full speed until it
+ * stops, then prints where it stopped and the state it was left in.
+ *
+ * Programs are raw binaries, loaded at -l (0x0600 by default, where the
+ * easy 6502 tutorial puts them), or the hex dumps the easy 6502 assembler
+ * makes ("0600: a9 01 8d 00 02 ..."), loaded where they say.
+ *
+ * The memory is the easy 6502's 2k, repeating through the address space,
+ * unless the program needs more: with -r, or anything loaded or started
+ * at 0x800 or above, it is a flat 64k. -M 2k or -M 64k says which.
+ *
+ * The runner stops at a BRK (unless -n says to take it as an interrupt),
+ * at an undefined opcode that jams the cpu, when the pc reaches -p, or
+ * once -c cycles or -i instructions have run.
+ *
+ * With -m the run is also taken as a heatmap of memory accesses, saved
+ * as <prefix>.heat and drawn to <prefix>.ppm, and its counts by region
+ * are printed.
+ *
+ * -P loads a plugin (see plugin.h), as path or path:args, and may be
+ * given more than once. Plugins are told of a frame every
+ * CYCLES_PER_FRAME cycles, and report when the runner stops.
+ */
+
+#define DEFAULT_LOAD 0x0600
+#define IMAGE_MAX 0x10000
+
+enum stop_reason{ STOP_BRK, STOP_BADOP, STOP_PC, STOP_CYCLES, STOP_INSTRUCTIONS };
+
+static const char *stop_strings[] = {
+  [STOP_BRK] = "brk",
+  [STOP_BADOP] = "undefined opcode",
+  [STOP_PC] = "pc",
+  [STOP_CYCLES] = "cycle limit",
+  [STOP_INSTRUCTIONS] = "instruction limit",
+};
+
+static double now(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void usage(const char *name){
+  fprintf(stderr,
+	  "usage: %s [-f bin|hex] [-l load_addr] [-r | -s start_addr] [-n] [-M 2k|64k]\n"
+	  "          [-p stop_pc] [-c max_cycles] [-i max_instructions]\n"
+	  "          [-m heatmap_prefix] [-P plugin.so[:args]]... program\n", name);
+  exit(1);
+}
+
+/*
+ * Reads an easy 6502 hex dump into image, where each "addr:" says where
+ * the bytes after it go. Returns the lowest address written, or -1.
+ */
+static int load_hex(FILE *file, uint8_t *image, uint8_t *used, int load){
+  char token[16];
+  int addr = load, lowest = -1;
+  while(fscanf(file, "%15s", token) == 1){
+    size_t len = strlen(token);
+    char *end;
+    if(token[len - 1] == ':'){
+      addr = strtol(token, &end, 16);
+      if(end != token + len - 1) return -1;
+      continue;
+    }
+    long byte = strtol(token, &end, 16);
+    if(*end || len > 2 || addr >= IMAGE_MAX) return -1;
+    image[addr] = byte;
+    used[addr] = 1;
+    if(lowest < 0 || addr < lowest) lowest = addr;
+    addr++;
+  }
+  return lowest;
+}
 
 int main(int argc, char **argv){
+  int hex = 0;
+  int load = DEFAULT_LOAD;
+  int start = -1;
+  int use_reset = 0;
+  int take_brk = 0;
+  long stop_pc = -1;
+  uint64_t max_cycles = UINT64_MAX;
+  uint64_t max_instructions = UINT64_MAX;
+  const char *heat_prefix = NULL;
+  // 0 until chosen, see above
+  int mem_size = 0;
+  struct plugin_host plugins;
+  plugins_init(&plugins);
+  int opt;
+  while((opt = getopt(argc, argv, "f:l:rs:np:c:i:m:P:M:")) != -1){
+    switch(opt){
+    case 'f':
+      if(!strcmp(optarg, "hex")) hex = 1;
+      else if(strcmp(optarg, "bin")) usage(argv[0]);
+      break;
+    case 'l': load = strtol(optarg, NULL, 16); break;
+    case 'r': use_reset = 1; break;
+    case 's': start = strtol(optarg, NULL, 16); break;
+    case 'n': take_brk = 1; break;
+    case 'p': stop_pc = strtol(optarg, NULL, 16); break;
+    case 'c': max_cycles = strtoull(optarg, NULL, 0); break;
+    case 'i': max_instructions = strtoull(optarg, NULL, 0); break;
+    case 'm': heat_prefix = optarg; break;
+    case 'P':
+      if(plugins_load(&plugins, optarg) < 0) return 1;
+      break;
+    case 'M':
+      if(!strcmp(optarg, "2k")) mem_size = 0x800;
+      else if(!strcmp(optarg, "64k")) mem_size = 0x10000;
+      else usage(argv[0]);
+      break;
+    default: usage(argv[0]);
+    }
+  }
+  if(optind >= argc || load < 0 || load >= IMAGE_MAX) usage(argv[0]);
+  // both run the cpu on a core of their own
+  if(heat_prefix && plugins.count) usage(argv[0]);
 
-  if(argc < 2) return 0;
-  /*
-   * The NES maps the rom to 0x8000 - 0xFFFF
-   * For the easy NES tutorial, The PC begins at 0x0600, so we load the code there.
-   */
-  struct cpu_info cpu;
-  init_cpu_info(&cpu);
-  FILE * file = fopen(argv[1], "r");
-  load_file_to_mem(file, &cpu, 0x0600);
+  FILE *file = fopen(argv[optind], "r");
+  if(!file){
+    perror(argv[optind]);
+    return 1;
+  }
+  static uint8_t image[IMAGE_MAX];
+  static uint8_t used[IMAGE_MAX];
+  if(hex){
+    int lowest = load_hex(file, image, used, load);
+    if(lowest < 0){
+      fprintf(stderr, "%s: not an easy 6502 hex dump\n", argv[optind]);
+      return 1;
+    }
+    load = lowest;
+  } else{
+    int len = fread(image + load, 1, IMAGE_MAX - load, file);
+    memset(used + load, 1, len);
+  }
   fclose(file);
-  cpu.pc = 0x0600;
+
+  int high = use_reset || start >= 0x800;
+  for(int addr = 0x800; addr < IMAGE_MAX && !high; addr++){
+    high = used[addr];
+  }
+  if(!mem_size) mem_size = high ? 0x10000 : 0x800;
+  else if(high && mem_size == 0x800){
+    fprintf(stderr, "%s: uses addresses past 2k, which repeat the first 2k\n", argv[optind]);
+  }
+
+  struct memory *mem = mem_size == 0x800 ? make_flat_2k_mem() : make_flat_64k_mem();
+  struct cpu_info cpu;
+  init_cpu_info(&cpu, mem);
+  for(int addr = 0; addr < IMAGE_MAX; addr++){
+    if(used[addr]) write8(mem, addr, image[addr]);
+  }
+  cpu.pc = use_reset ? read16(mem, RESET_VECTOR) : start >= 0 ? start : load;
   cpu.s = 0xFF;
-  
-  int i = 0;
-  while(!cpu.finished){
-    step(&cpu);
-    i++;
-    getchar();
+  cpu.stop_on_brk = !take_brk;
+
+  struct scheduler sched;
+  init_scheduler(&sched);
+
+  struct heatmap *heat = NULL;
+  if(heat_prefix){
+    heat = heatmap_create();
+    if(!heat){
+      perror("heatmap");
+      return 1;
+    }
+    heatmap_start(&cpu, heat);
   }
+  if(plugins.count) plugins_attach(&plugins, &cpu);
+  // frames are only counted out for plugins that want them
+  uint64_t next_frame = plugins.frame_count ? CYCLES_PER_FRAME : UINT64_MAX;
 
+  int l1d = counter_open_l1d_misses();
+  counter_start(l1d);
+  double began = now();
+  if(stop_pc < 0 && max_instructions == UINT64_MAX){
+    // nothing to check between instructions, so the core can run freely
+    while(!cpu.finished && cpu.clock < max_cycles){
+      run_until(&cpu, &sched, next_frame < max_cycles ? next_frame : max_cycles);
+      if(cpu.clock >= next_frame){
+	plugins_frame(&cpu);
+	next_frame += CYCLES_PER_FRAME;
+      }
+    }
+  } else{
+    while(!cpu.finished && cpu.pc != stop_pc &&
+	  cpu.clock < max_cycles && cpu.instructions < max_instructions){
+      execute_instruction(&cpu);
+      if(cpu.clock >= next_frame){
+	plugins_frame(&cpu);
+	next_frame += CYCLES_PER_FRAME;
+      }
+    }
+  }
+  double elapsed = now() - began;
+  uint64_t misses = counter_stop(l1d);
+  counter_close(l1d);
 
+  enum stop_reason why = cpu.finished == CPU_JAM ? STOP_BADOP :
+    cpu.finished ? STOP_BRK : cpu.pc == stop_pc ? STOP_PC :
+    cpu.clock >= max_cycles ? STOP_CYCLES : STOP_INSTRUCTIONS;
+  printf("stopped on %s at pc %04x\n", stop_strings[why], cpu.pc);
+  printf("a %02x, x %02x, y %02x, s %02x, p %02x, hash %016llx\n",
+	 cpu.a, cpu.x, cpu.y, cpu.s,
+	 cpu.N << 7 | cpu.V << 6 | 1 << 5 | cpu.D << 3 | cpu.I << 2 | cpu.Z << 1 | cpu.C,
+	 (unsigned long long)machine_hash(&cpu));
+  printf("%llu cycles, %llu instructions in %.3fs (%.1f MHz)\n",
+	 (unsigned long long)cpu.clock, (unsigned long long)cpu.instructions,
+	 elapsed, elapsed > 0 ? cpu.clock / elapsed / 1e6 : 0.0);
+  printf("%.1f million instructions/s",
+	 elapsed > 0 ? cpu.instructions / elapsed / 1e6 : 0.0);
+  if(l1d >= 0){
+    printf(", %llu L1d read misses (%.4f per instruction)\n", (unsigned long long)misses,
+	   cpu.instructions ? (double)misses / cpu.instructions : 0.0);
+  } else{
+    printf(", L1d misses not counted (no hardware counters)\n");
+  }
+
+  plugins_unload(&plugins, &cpu, stdout);
+
+  if(heat){
+    heatmap_stop(&cpu);
+    heatmap_print_regions(heat, stdout);
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.heat", heat_prefix);
+    if(heatmap_save(heat, path) < 0) return 1;
+    snprintf(path, sizeof(path), "%s.ppm", heat_prefix);
+    if(heatmap_render(heat, path, 2) < 0) return 1;
+    heatmap_free(heat);
+  }
   return 0;
 }
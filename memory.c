@@ -1,31 +1,49 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "memory.h"
+#include "6502.h"
 
 
-uint8_t read8(struct memory *mem, uint16_t indx){
-  return *decode_address(mem, indx);
+// the bytes from addr to the end of its page, or len if fewer
+static size_t page_chunk(uint16_t addr, size_t len){
+  size_t left = 0x100 - (addr & 0xFF);
+  return len < left ? len : left;
 }
 
-uint16_t read16(struct memory *mem, uint16_t ptr){
-  uint16_t lo = read8(mem, ptr);
-  uint16_t hi = read8(mem, ptr+1) << 8;
-  return hi | lo;
-}
-
-void write8(struct memory *mem, uint16_t indx, uint8_t writing){
-  uint8_t * addr = decode_address(mem, indx);
-  *addr = writing;
-}
-
-void write16(struct memory *mem, uint16_t indx, uint16_t writing){
-  write8(mem, indx, (uint8_t) writing);
-  write8(mem, indx+1, (uint8_t) (writing >>8));
+void mem_read_block(struct memory *mem, uint16_t addr, uint8_t *dst, size_t len){
+  while(len > 0){
+    size_t chunk = page_chunk(addr, len);
+    uint8_t *page = mem_page(mem, addr, 0);
+    if(page){
+      memcpy(dst, page + (addr & 0xFF), chunk);
+    } else {
+      for(size_t i = 0; i < chunk; i++){
+	dst[i] = read8(mem, addr + i);
+      }
+    }
+    addr += chunk;
+    dst += chunk;
+    len -= chunk;
+  }
 }
 
-uint8_t *decode_address(struct memory* mem, uint16_t addr){
-  return mem->decode_address_I(mem, addr);
+void mem_write_block(struct memory *mem, uint16_t addr, const uint8_t *src, size_t len){
+  while(len > 0){
+    size_t chunk = page_chunk(addr, len);
+    uint8_t *page = mem_page(mem, addr, 1);
+    if(page){
+      memcpy(page + (addr & 0xFF), src, chunk);
+    } else {
+      for(size_t i = 0; i < chunk; i++){
+	write8(mem, addr + i, src[i]);
+      }
+    }
+    addr += chunk;
+    src += chunk;
+    len -= chunk;
+  }
 }
 
 
@@ -37,18 +55,95 @@ uint8_t *decode_address(struct memory* mem, uint16_t addr){
 struct flat_2k_mem{
   //IMPORTANT: a valid memory struct has to be the first item in an IFAC
   struct memory mem_iface;
-  uint8_t* mem;
+  uint8_t mem[2048];
 };
 
-uint8_t * decode_flat_2k(struct memory *memory, uint16_t addr){
+static inline uint8_t * flat_2k_at(struct memory *memory, uint16_t addr){
   struct flat_2k_mem * mem_2k = (struct flat_2k_mem *) memory;
   return mem_2k->mem + (addr % 2048);
 }
 
+uint8_t * decode_flat_2k(struct memory *memory, uint16_t addr){
+  return flat_2k_at(memory, addr);
+}
+
+// every page is plain, the 2k repeating through the address space
+static uint8_t * page_flat_2k(struct memory *memory, uint16_t addr, int writing){
+  return flat_2k_at(memory, addr);
+}
+
+/*
+ * The core specialised for this memory, with the decoding above inlined
+ * into every access.
+ */
+#define READ8(cpu, addr) (*flat_2k_at((cpu)->mem, (addr)))
+#define READ16(cpu, addr) read16_flat_2k((cpu)->mem, (addr))
+#define WRITE8(cpu, addr, val) (*flat_2k_at((cpu)->mem, (addr)) = (val))
+
+static inline uint16_t read16_flat_2k(struct memory *mem, uint16_t ptr){
+  uint16_t lo = *flat_2k_at(mem, ptr);
+  uint16_t hi = *flat_2k_at(mem, ptr+1) << 8;
+  return hi | lo;
+}
+
+#define CORE_NAME flat_2k
+#define CORE_SUPERINSTRUCTIONS
+#include "6502_core.h"
+
 struct memory * make_flat_2k_mem(){
-  struct flat_2k_mem * out = malloc(sizeof(struct flat_2k_mem));
-  out->mem = malloc(2048 * sizeof(uint8_t));
+  struct flat_2k_mem * out = calloc(1, sizeof(struct flat_2k_mem));
   out->mem_iface.decode_address_I = decode_flat_2k;
+  out->mem_iface.core_I = &flat_2k_core;
+  out->mem_iface.page_I = page_flat_2k;
+  out->mem_iface.size = sizeof(struct flat_2k_mem);
+
+  return (struct memory*)out;
+}
+
+
+/*
+ * All 64k as ram, with nothing mapped anywhere. This is what the 6502
+ * test suites (see conform.c) expect to run on.
+ */
+struct flat_64k_mem{
+  struct memory mem_iface;
+  uint8_t mem[0x10000];
+};
+
+static inline uint8_t * flat_64k_at(struct memory *memory, uint16_t addr){
+  return ((struct flat_64k_mem *) memory)->mem + addr;
+}
+
+uint8_t * decode_flat_64k(struct memory *memory, uint16_t addr){
+  return flat_64k_at(memory, addr);
+}
+
+static uint8_t * page_flat_64k(struct memory *memory, uint16_t addr, int writing){
+  return flat_64k_at(memory, addr);
+}
+
+#undef READ8
+#undef READ16
+#undef WRITE8
+#define READ8(cpu, addr) (*flat_64k_at((cpu)->mem, (addr)))
+#define READ16(cpu, addr) read16_flat_64k((cpu)->mem, (addr))
+#define WRITE8(cpu, addr, val) (*flat_64k_at((cpu)->mem, (addr)) = (val))
+
+static inline uint16_t read16_flat_64k(struct memory *mem, uint16_t ptr){
+  return *flat_64k_at(mem, ptr) | *flat_64k_at(mem, ptr+1) << 8;
+}
+
+#undef CORE_NAME
+#define CORE_NAME flat_64k
+#define CORE_SUPERINSTRUCTIONS
+#include "6502_core.h"
+
+struct memory * make_flat_64k_mem(){
+  struct flat_64k_mem * out = calloc(1, sizeof(struct flat_64k_mem));
+  out->mem_iface.decode_address_I = decode_flat_64k;
+  out->mem_iface.core_I = &flat_64k_core;
+  out->mem_iface.page_I = page_flat_64k;
+  out->mem_iface.size = sizeof(struct flat_64k_mem);
 
   return (struct memory*)out;
 }
@@ -2,19 +2,81 @@
 #define MEMORY_H
 
 #include <stdint.h>
+#include <stddef.h>
 
+struct cpu_core;
+
+/*
+ * A memory, along with any devices mapped into it, is a single allocation
+ * of size bytes with no pointers into itself, so it can be copied
+ * anywhere with memcpy (see machine.h). One that keeps pages outside of
+ * it (see paged_memory.h) has clone_I and free_I to look after them.
+ */
 struct memory{
   uint8_t* (*decode_address_I)(struct memory*, uint16_t);
+  // optional, a cpu core compiled against this memory (see 6502_core.h).
+  // Leave it NULL to use the generic core.
+  const struct cpu_core *core_I;
+  size_t size;
+  // optional, where the 256 byte page starting at addr is kept, if all of
+  // it is plain memory in order; NULL for a page with devices in it. Bulk
+  // transfers (mem_read_block etc.) copy such pages with memcpy. writing
+  // is nonzero if the page will be written through the pointer.
+  uint8_t* (*page_I)(struct memory*, uint16_t addr, int writing);
+  // optional, told of every write the cpu makes, after it is stored, for
+  // devices that act on being written to. Returns the cycles the cpu is
+  // stalled for (see cpu_write8 in 6502.h), clock being the cpu's.
+  int (*store_I)(struct memory*, uint16_t addr, uint8_t val, uint64_t clock);
+  // optional, called on a memcpy of the memory to give it copies of its
+  // own of whatever it keeps outside the block
+  void (*clone_I)(struct memory*);
+  // optional, releases whatever it keeps outside the block
+  void (*free_I)(struct memory*);
+  // optional, where a write to addr goes, for a memory whose
+  // decode_address_I only gives pointers to be read through
+  uint8_t* (*write_address_I)(struct memory*, uint16_t);
 };
 
 
-void write8(struct memory *mem, uint16_t indx, uint8_t writing);
-void write16(struct memory *mem, uint16_t indx, uint16_t writing);
-uint8_t read8(struct memory *mem, uint16_t indx);
-uint16_t read16(struct memory *mem, uint16_t indx);
+static inline uint8_t *decode_address(struct memory* mem, uint16_t addr){
+  return mem->decode_address_I(mem, addr);
+}
+
+static inline uint8_t read8(struct memory *mem, uint16_t indx){
+  return *decode_address(mem, indx);
+}
+
+static inline uint16_t read16(struct memory *mem, uint16_t ptr){
+  uint16_t lo = read8(mem, ptr);
+  uint16_t hi = read8(mem, ptr+1) << 8;
+  return hi | lo;
+}
+
+static inline void write8(struct memory *mem, uint16_t indx, uint8_t writing){
+  uint8_t * addr = mem->write_address_I ? mem->write_address_I(mem, indx)
+    : decode_address(mem, indx);
+  *addr = writing;
+}
+
+static inline void write16(struct memory *mem, uint16_t indx, uint16_t writing){
+  write8(mem, indx, (uint8_t) writing);
+  write8(mem, indx+1, (uint8_t) (writing >>8));
+}
+
+// the page holding addr if it is plain memory, otherwise NULL
+static inline uint8_t *mem_page(struct memory *mem, uint16_t addr, int writing){
+  return mem->page_I ? mem->page_I(mem, addr & 0xFF00, writing) : NULL;
+}
 
-uint8_t *decode_address(struct memory*, uint16_t);
+/*
+ * Bulk transfers between memory, from addr on (wrapping at 0xFFFF), and a
+ * buffer. Each page is resolved once and copied with memcpy if it is plain
+ * memory, and a byte at a time through the interface if not.
+ */
+void mem_read_block(struct memory *mem, uint16_t addr, uint8_t *dst, size_t len);
+void mem_write_block(struct memory *mem, uint16_t addr, const uint8_t *src, size_t len);
 
 struct memory * make_flat_2k_mem();
+struct memory * make_flat_64k_mem();
 
 #endif
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "metrics.h"
+
+const char *region_strings[REGION_COUNT] = {
+  "zero page", "stack", "screen", "ram", "ppu", "apu/io", "cartridge"
+};
+
+#define PAGES(from, to, region) [from ... to] = region
+
+const uint8_t region_by_page[256] = {
+  PAGES(0x00, 0x00, REGION_ZERO_PAGE),
+  PAGES(0x01, 0x01, REGION_STACK),
+  PAGES(0x02, 0x05, REGION_SCREEN),
+  PAGES(0x06, 0x1F, REGION_RAM),
+  PAGES(0x20, 0x3F, REGION_PPU),
+  PAGES(0x40, 0x40, REGION_APU),
+  PAGES(0x41, 0xFF, REGION_CART),
+};
+
+
+/*
+ * The metered core: the generic core with every access counted by the
+ * region it falls in. Only used while region counts are wanted.
+ */
+static inline uint8_t metered_read8(struct cpu_info *cpu, uint16_t addr){
+  cpu->counts->reads[region_by_page[addr >> 8]]++;
+  return read8(cpu->mem, addr);
+}
+
+static inline uint16_t metered_read16(struct cpu_info *cpu, uint16_t addr){
+  uint16_t lo = metered_read8(cpu, addr);
+  uint16_t hi = metered_read8(cpu, addr + 1) << 8;
+  return hi | lo;
+}
+
+static inline void metered_write8(struct cpu_info *cpu, uint16_t addr, uint8_t val){
+  cpu->counts->writes[region_by_page[addr >> 8]]++;
+  cpu_write8(cpu, addr, val);
+}
+
+#define READ8(cpu, addr) metered_read8((cpu), (addr))
+#define READ16(cpu, addr) metered_read16((cpu), (addr))
+#define WRITE8(cpu, addr, val) metered_write8((cpu), (addr), (val))
+
+#define CORE_NAME metered
+#include "6502_core.h"
+
+
+static void segment_name(char *name, int size, int pid){
+  snprintf(name, size, "/ricoh.%d", pid);
+}
+
+// creates the segment for this process, or returns NULL
+struct metrics *metrics_create(){
+  char name[32];
+  segment_name(name, sizeof(name), getpid());
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0){
+    perror("metrics: shm_open");
+    return NULL;
+  }
+  if(ftruncate(fd, sizeof(struct metrics)) < 0){
+    perror("metrics: ftruncate");
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+  struct metrics *m = mmap(NULL, sizeof(struct metrics), PROT_READ | PROT_WRITE,
+			   MAP_SHARED, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED){
+    perror("metrics: mmap");
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // the segment starts zeroed, which is a valid state for every counter
+  m->pid = getpid();
+  m->version = METRICS_VERSION;
+  atomic_thread_fence(memory_order_release);
+  m->magic = METRICS_MAGIC;
+  return m;
+}
+
+void metrics_destroy(struct metrics *m){
+  char name[32];
+  segment_name(name, sizeof(name), m->pid);
+  munmap(m, sizeof(struct metrics));
+  shm_unlink(name);
+}
+
+// maps the segment of another process read only, or returns NULL
+struct metrics *metrics_open(int pid){
+  char name[32];
+  segment_name(name, sizeof(name), pid);
+  int fd = shm_open(name, O_RDONLY, 0);
+  if(fd < 0) return NULL;
+  struct metrics *m = mmap(NULL, sizeof(struct metrics), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED) return NULL;
+  if(m->magic != METRICS_MAGIC || m->version != METRICS_VERSION){
+    munmap(m, sizeof(struct metrics));
+    return NULL;
+  }
+  return m;
+}
+
+void metrics_close(struct metrics *m){
+  munmap(m, sizeof(struct metrics));
+}
+
+/*
+ * Switches the cpu to the metered core, keeping its access counts in
+ * counts. This costs a little on every access, so it's opt in.
+ */
+void metrics_count_regions(struct cpu_info *cpu, struct access_counts *counts){
+  memset(counts, 0, sizeof(struct access_counts));
+  cpu->counts = counts;
+  cpu->core = &metered_core;
+}
+
+// back to the memory's own core, once any heatmap or plugins are detached
+void metrics_stop(struct cpu_info *cpu){
+  if(!cpu->counts) return;
+  cpu->counts = NULL;
+  cpu->core = cpu->mem->core_I ? cpu->mem->core_I : &generic_core;
+}
+
+#define STORE(field, val) atomic_store_explicit(&(field), (val), memory_order_relaxed)
+#define ADD(field, val) atomic_fetch_add_explicit(&(field), (val), memory_order_relaxed)
+
+// copies the cpu's counters out; called between batches of instructions
+void metrics_publish(struct metrics *m, struct cpu_info *cpu){
+  if(!m) return;
+  STORE(m->instructions, cpu->instructions);
+  STORE(m->cycles, cpu->clock);
+  if(cpu->counts){
+    for(int r = 0; r < REGION_COUNT; r++){
+      STORE(m->reads[r], cpu->counts->reads[r]);
+      STORE(m->writes[r], cpu->counts->writes[r]);
+    }
+  }
+}
+
+void metrics_frame(struct metrics *m, uint64_t frame_us, int dropped){
+  if(!m) return;
+  int bucket = 0;
+  while(bucket < FRAME_TIME_BUCKETS - 1 && (2ULL << bucket) <= frame_us){
+    bucket++;
+  }
+  ADD(m->frames, 1);
+  ADD(m->frame_time[bucket], 1);
+  if(dropped) ADD(m->dropped_frames, 1);
+}
+
+void metrics_sleep(struct metrics *m, uint64_t asked_us, uint64_t slept_us){
+  if(!m) return;
+  uint64_t over = slept_us > asked_us ? slept_us - asked_us : 0;
+  ADD(m->sleeps, 1);
+  ADD(m->sleep_overshoot_us, over);
+  if(over > atomic_load_explicit(&m->max_sleep_overshoot_us, memory_order_relaxed)){
+    STORE(m->max_sleep_overshoot_us, over);
+  }
+}
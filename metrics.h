@@ -0,0 +1,75 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "6502.h"
+
+/*
+ * Live metrics, published in a POSIX shared memory segment named
+ * /ricoh.<pid> so they can be read from outside the process (see stat.c).
+ *
+ * There is one writer, the emulation thread, which only ever does relaxed
+ * atomic stores and adds: nothing here takes a lock. Counters are totals
+ * since the segment was created; readers take differences over time.
+ */
+
+#define METRICS_MAGIC 0x52494353 // "RICS"
+#define METRICS_VERSION 1
+
+// memory regions, for the access counts
+enum region{
+  REGION_ZERO_PAGE, REGION_STACK, REGION_SCREEN, REGION_RAM,
+  REGION_PPU, REGION_APU, REGION_CART, REGION_COUNT
+};
+
+extern const char *region_strings[REGION_COUNT];
+extern const uint8_t region_by_page[256];
+
+// frame times are bucketed by powers of two microseconds
+#define FRAME_TIME_BUCKETS 24
+
+struct metrics{
+  uint32_t magic;
+  uint32_t version;
+  int32_t pid;
+
+  _Atomic uint64_t instructions;
+  _Atomic uint64_t cycles;
+  _Atomic uint64_t reads[REGION_COUNT];
+  _Atomic uint64_t writes[REGION_COUNT];
+
+  _Atomic uint64_t frames;
+  _Atomic uint64_t dropped_frames;
+  _Atomic uint64_t frame_time[FRAME_TIME_BUCKETS];
+
+  // how much longer than asked the frame pacing sleeps took
+  _Atomic uint64_t sleeps;
+  _Atomic uint64_t sleep_overshoot_us;
+  _Atomic uint64_t max_sleep_overshoot_us;
+};
+
+/*
+ * The counts kept by the metered core, which the cpu updates without
+ * atomics; metrics_publish() copies them out.
+ */
+struct access_counts{
+  uint64_t reads[REGION_COUNT];
+  uint64_t writes[REGION_COUNT];
+};
+
+extern const struct cpu_core metered_core;
+
+struct metrics *metrics_create();
+void metrics_destroy(struct metrics *m);
+struct metrics *metrics_open(int pid);
+void metrics_close(struct metrics *m);
+
+void metrics_count_regions(struct cpu_info *cpu, struct access_counts *counts);
+void metrics_stop(struct cpu_info *cpu);
+void metrics_publish(struct metrics *m, struct cpu_info *cpu);
+void metrics_frame(struct metrics *m, uint64_t frame_us, int dropped);
+void metrics_sleep(struct metrics *m, uint64_t asked_us, uint64_t slept_us);
+
+#endif
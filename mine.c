@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "6502.h"
+#include "sched.h"
+#include "movie.h"
+#include "screen.h"
+
+/*
+ * ricoh-mine: finds the opcode sequences worth making superinstructions.
+ *
+ * Programs (easy 6502 binaries, loaded at 0x0600 and given a new random
+ * number every frame like gui does) and recorded movies (-r) are run one
+ * instruction at a time while every pair and triple of opcodes executed
+ * in a row is counted. The sequences that would save the most dispatches
+ * are listed, and with -o written out as the 6502_super.h the cores
+ * include (see 6502_core.h), which is their dispatch table: every opcode
+ * has a case there, and the chosen sequences continue from theirs:
+ *
+ *    ./ricoh-mine -r snake.rmv -o 6502_super.h binary/snake.bin ...
+ *
+ * A sequence of n instructions saves n - 1 dispatches each time it runs,
+ * which is what they are ranked by. Sequences overlap, so the opcodes run
+ * are kept and matched against the chosen ones the way the core would,
+ * to report how many dispatches they really save.
+ */
+
+#define DEFAULT_LOAD 0x0600
+#define DEFAULT_CYCLES 10000000ULL
+#define DEFAULT_SEQUENCES 16
+#define MAX_SOURCES 64
+
+// triples are sparse, so are kept in a small open addressed table
+#define TRIPLE_SLOTS (1 << 16)
+
+struct triple{
+  uint32_t key;   // opcodes as 0x01aabbcc, 0 for an empty slot
+  uint64_t count;
+};
+
+struct profile{
+  uint64_t total;
+  uint64_t pairs[256][256];
+  struct triple triples[TRIPLE_SLOTS];
+  // the last opcodes run, newest in the low byte, and how many of them
+  uint32_t history;
+  int seen;
+  // every opcode run, with a 0x100 where a program starts
+  uint16_t *stream;
+  size_t stream_len, stream_size;
+};
+
+struct sequence{
+  uint8_t opcodes[3];
+  int len;
+  uint64_t count;
+};
+
+static void count_triple(struct profile *p, uint32_t opcodes){
+  uint32_t key = 0x01000000 | opcodes;
+  uint32_t slot = (opcodes * 2654435761u) >> 16;
+  while(p->triples[slot].key && p->triples[slot].key != key){
+    slot = (slot + 1) % TRIPLE_SLOTS;
+  }
+  p->triples[slot].key = key;
+  p->triples[slot].count++;
+}
+
+static void stream_add(struct profile *p, uint16_t value){
+  if(p->stream_len == p->stream_size){
+    p->stream_size = p->stream_size ? p->stream_size * 2 : 1 << 20;
+    p->stream = realloc(p->stream, p->stream_size * sizeof(uint16_t));
+  }
+  p->stream[p->stream_len++] = value;
+}
+
+static void profile_opcode(struct profile *p, uint8_t opcode){
+  stream_add(p, opcode);
+  p->history = (p->history << 8 | opcode) & 0xFFFFFF;
+  p->total++;
+  if(p->seen < 3) p->seen++;
+  if(p->seen >= 2) p->pairs[(p->history >> 8) & 0xFF][opcode]++;
+  if(p->seen >= 3) count_triple(p, p->history);
+}
+
+// a sequence starts afresh with each program
+static void profile_restart(struct profile *p){
+  p->history = 0;
+  p->seen = 0;
+  stream_add(p, 0x100);
+}
+
+static void profile_step(struct profile *p, struct cpu_info *cpu){
+  profile_opcode(p, read8(cpu->mem, cpu->pc));
+  execute_instruction(cpu);
+}
+
+static void new_machine(struct cpu_info *cpu, struct memory *mem){
+  memset(decode_address(mem, 0), 0, MOVIE_RAM);
+  init_cpu_info(cpu, mem);
+  cpu->s = 0xFF;
+}
+
+static int profile_program(struct profile *p, struct memory *mem, const char *path,
+			   uint64_t max_cycles){
+  FILE *file = fopen(path, "rb");
+  if(!file){
+    perror(path);
+    return -1;
+  }
+  static uint8_t image[0x10000 - DEFAULT_LOAD];
+  size_t len = fread(image, 1, sizeof(image), file);
+  fclose(file);
+
+  struct cpu_info cpu;
+  new_machine(&cpu, mem);
+  for(size_t i = 0; i < len; i++){
+    write8(mem, DEFAULT_LOAD + i, image[i]);
+  }
+  cpu.pc = DEFAULT_LOAD;
+
+  profile_restart(p);
+  while(!cpu.finished && cpu.clock < max_cycles){
+    write8(mem, 0xFE, rand() % 256);
+    uint64_t frame_end = cpu.clock + CYCLES_PER_FRAME;
+    while(!cpu.finished && cpu.clock < frame_end) profile_step(p, &cpu);
+  }
+  fprintf(stderr, "%s: %llu instructions\n", path, (unsigned long long)cpu.instructions);
+  return 0;
+}
+
+/*
+ * A movie is played one instruction at a time, so its input still lands
+ * on the cycles it was recorded at.
+ */
+static int profile_movie(struct profile *p, struct memory *mem, const char *path){
+  struct movie movie;
+  if(movie_open(&movie, path) < 0) return -1;
+  if(movie.machine != MOVIE_EASY6502){
+    fprintf(stderr, "%s: unknown machine %d\n", path, movie.machine);
+    movie_close(&movie);
+    return -1;
+  }
+  struct cpu_info cpu;
+  new_machine(&cpu, mem);
+  for(int i = 0; i < movie.image_len; i++){
+    write8(mem, movie.load + i, movie.image[i]);
+  }
+  cpu.pc = movie.pc;
+  struct scheduler sched;
+  init_scheduler(&sched);
+
+  profile_restart(p);
+  while(!cpu.finished){
+    uint8_t opcode = read8(mem, cpu.pc);
+    uint64_t before = cpu.instructions;
+    if(movie_play(&movie, &cpu, &sched, cpu.clock + 1) < 0) break;
+    // the movie has ended
+    if(cpu.instructions == before) break;
+    profile_opcode(p, opcode);
+  }
+  fprintf(stderr, "%s: %llu instructions\n", path, (unsigned long long)cpu.instructions);
+  movie_close(&movie);
+  return 0;
+}
+
+static int saves(const struct sequence *s){
+  return s->len - 1;
+}
+
+static int by_savings(const void *a, const void *b){
+  const struct sequence *x = a, *y = b;
+  uint64_t sx = x->count * saves(x), sy = y->count * saves(y);
+  return sx < sy ? 1 : sx > sy ? -1 : 0;
+}
+
+static int by_opcodes(const void *a, const void *b){
+  const struct sequence *x = a, *y = b;
+  for(int i = 0; i < 3; i++){
+    int ox = i < x->len ? x->opcodes[i] : -1;
+    int oy = i < y->len ? y->opcodes[i] : -1;
+    if(ox != oy) return ox - oy;
+  }
+  return 0;
+}
+
+static int usable(uint8_t opcode){
+  return decode_table[opcode].op != BADOP;
+}
+
+// every pair and triple that ran, most dispatches saved first
+static struct sequence *candidates(struct profile *p, int *count){
+  struct sequence *list = malloc(sizeof(struct sequence) * (256 * 256 + TRIPLE_SLOTS));
+  int n = 0;
+  for(int a = 0; a < 256; a++){
+    for(int b = 0; b < 256; b++){
+      if(!p->pairs[a][b] || !usable(a) || !usable(b)) continue;
+      list[n++] = (struct sequence){ { a, b, 0 }, 2, p->pairs[a][b] };
+    }
+  }
+  for(int i = 0; i < TRIPLE_SLOTS; i++){
+    uint32_t key = p->triples[i].key;
+    if(!key) continue;
+    struct sequence s = { { key >> 16, key >> 8, key }, 3, p->triples[i].count };
+    if(usable(s.opcodes[0]) && usable(s.opcodes[1]) && usable(s.opcodes[2])){
+      list[n++] = s;
+    }
+  }
+  qsort(list, n, sizeof(struct sequence), by_savings);
+  *count = n;
+  return list;
+}
+
+/*
+ * The dispatches the run would have taken with the chosen sequences: at
+ * each dispatch the longest chosen sequence matching what ran next is
+ * taken, as the core's run loop does.
+ */
+static uint64_t dispatches(struct profile *p, const struct sequence *chosen, int count){
+  static uint8_t first[256], second[256][256];
+  memset(first, 0, sizeof(first));
+  memset(second, 0, sizeof(second));
+  for(int i = 0; i < count; i++){
+    first[chosen[i].opcodes[0]] = 1;
+    second[chosen[i].opcodes[0]][chosen[i].opcodes[1]] = 1;
+  }
+  uint64_t taken = 0;
+  size_t i = 0;
+  while(i < p->stream_len){
+    const uint16_t *at = p->stream + i;
+    size_t left = p->stream_len - i;
+    if(at[0] > 0xFF){
+      i++;
+      continue;
+    }
+    int len = 1;
+    if(first[at[0]] && left > 1 && at[1] <= 0xFF && second[at[0]][at[1]]){
+      len = 2;
+      for(int j = 0; j < count && left > 2 && at[2] <= 0xFF; j++){
+	if(chosen[j].len == 3 && chosen[j].opcodes[0] == at[0] &&
+	   chosen[j].opcodes[1] == at[1] && chosen[j].opcodes[2] == at[2]){
+	  len = 3;
+	  break;
+	}
+      }
+    }
+    taken++;
+    i += len;
+  }
+  return taken;
+}
+
+static void describe(FILE *out, const struct sequence *s){
+  for(int i = 0; i < s->len; i++){
+    uint8_t op = s->opcodes[i];
+    fprintf(out, "%s%s %s", i ? ", " : "", opcode_strings[decode_table[op].op],
+	    addressMode_strings[decode_table[op].mode]);
+  }
+}
+
+static void emit_step(FILE *out, const char *macro, uint8_t op, int depth){
+  fprintf(out, "%*s%s(0x%02x, %s, %s, %d, %d, %d)", depth * 2, "", macro, op,
+	  opcode_strings[decode_table[op].op], addressMode_strings[decode_table[op].mode],
+	  decode_table[op].cycles, decode_table[op].width, decode_table[op].penalties);
+}
+
+/*
+ * The dispatch table: a case for every opcode, each with the chosen
+ * sequences that start with it nested under it as a trie.
+ */
+static void emit(FILE *out, const struct sequence *sequences, int wanted, uint64_t total,
+		 char **sources, int source_count){
+  fprintf(out, "/*\n * Superinstructions, generated by ricoh-mine from a profile of\n *\n");
+  for(int i = 0; i < source_count; i++) fprintf(out, " *   %s\n", sources[i]);
+  fprintf(out, " *\n * do not edit (see 6502_core.h for what the macros do).\n */\n");
+
+  struct sequence chosen[256 + wanted];
+  int count = 0;
+  for(int op = 0; op < 256; op++){
+    if(usable(op)) chosen[count++] = (struct sequence){ { op, 0, 0 }, 1, 0 };
+  }
+  memcpy(chosen + count, sequences, wanted * sizeof(struct sequence));
+  count += wanted;
+
+  qsort(chosen, count, sizeof(struct sequence), by_opcodes);
+  for(int i = 0; i < count; i++){
+    struct sequence *s = &chosen[i];
+    struct sequence *prev = i ? &chosen[i - 1] : NULL;
+    // how much of this one is shared with the sequence before it
+    int shared = 0;
+    while(prev && shared < prev->len && shared < s->len &&
+	  prev->opcodes[shared] == s->opcodes[shared]) shared++;
+    // close what the last sequence opened beyond that
+    if(prev){
+      for(int depth = prev->len - 1; depth >= shared; depth--){
+	fprintf(out, "%*sSUPER_END\n", depth * 2, "");
+      }
+    }
+    if(!shared) fprintf(out, "\n");
+    for(int depth = shared; depth < s->len; depth++){
+      emit_step(out, depth ? "SUPER_NEXT" : "SUPER_FIRST", s->opcodes[depth], depth);
+      if(depth == s->len - 1 && depth){
+	fprintf(out, " // %.2f%%: ", 100.0 * s->count * s->len / total);
+	describe(out, s);
+      }
+      fprintf(out, "\n");
+    }
+  }
+  if(count){
+    for(int depth = chosen[count - 1].len - 1; depth >= 0; depth--){
+      fprintf(out, "%*sSUPER_END\n", depth * 2, "");
+    }
+  }
+}
+
+static void usage(const char *name){
+  fprintf(stderr, "usage: %s [-c max_cycles] [-n sequences] [-r movie]... [-o header]"
+	  " [program...]\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv){
+  uint64_t max_cycles = DEFAULT_CYCLES;
+  int wanted = DEFAULT_SEQUENCES;
+  const char *out_path = NULL;
+  char *movies[MAX_SOURCES];
+  int movie_count = 0;
+  int opt;
+  while((opt = getopt(argc, argv, "c:n:r:o:")) != -1){
+    switch(opt){
+    case 'c': max_cycles = strtoull(optarg, NULL, 0); break;
+    case 'n': wanted = atoi(optarg); break;
+    case 'r':
+      if(movie_count == MAX_SOURCES) usage(argv[0]);
+      movies[movie_count++] = optarg;
+      break;
+    case 'o': out_path = optarg; break;
+    default: usage(argv[0]);
+    }
+  }
+  if((optind >= argc && !movie_count) || wanted < 0) usage(argv[0]);
+
+  // a fixed seed, so the same programs always give the same sequences
+  srand(1);
+  struct profile *profile = calloc(1, sizeof(struct profile));
+  struct memory *mem = make_flat_2k_mem();
+  char *sources[MAX_SOURCES * 2];
+  int source_count = 0;
+  for(int i = 0; i < movie_count; i++){
+    if(profile_movie(profile, mem, movies[i]) < 0) return 1;
+    if(source_count < MAX_SOURCES * 2) sources[source_count++] = movies[i];
+  }
+  for(int i = optind; i < argc; i++){
+    if(profile_program(profile, mem, argv[i], max_cycles) < 0) return 1;
+    if(source_count < MAX_SOURCES * 2) sources[source_count++] = argv[i];
+  }
+  if(!profile->total){
+    fprintf(stderr, "nothing ran\n");
+    return 1;
+  }
+
+  int count;
+  struct sequence *list = candidates(profile, &count);
+  if(wanted > count) wanted = count;
+
+  printf("%llu instructions; the best sequences:\n", (unsigned long long)profile->total);
+  for(int i = 0; i < count && i < wanted + 8; i++){
+    printf("%c %12llu %6.2f%%  ", i < wanted ? '*' : ' ',
+	   (unsigned long long)list[i].count,
+	   100.0 * list[i].count * list[i].len / profile->total);
+    describe(stdout, &list[i]);
+    printf("\n");
+  }
+  uint64_t taken = dispatches(profile, list, wanted);
+  printf("the %d marked * take %llu dispatches, saving %.1f%%\n", wanted,
+	 (unsigned long long)taken, 100.0 * (profile->total - taken) / profile->total);
+
+  if(out_path){
+    FILE *out = fopen(out_path, "w");
+    if(!out){
+      perror(out_path);
+      return 1;
+    }
+    emit(out, list, wanted, profile->total, sources, source_count);
+    fclose(out);
+  }
+  free(list);
+  free(profile->stream);
+  free(profile);
+  free(mem);
+  return 0;
+}
@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "movie.h"
+#include "6502_ops.h"
+
+static void put16(FILE *file, uint16_t val){
+  fputc(val & 0xFF, file);
+  fputc(val >> 8, file);
+}
+
+static void put64(FILE *file, uint64_t val){
+  for(int i = 0; i < 8; i++){
+    fputc((val >> (i * 8)) & 0xFF, file);
+  }
+}
+
+static void put32(FILE *file, uint32_t val){
+  put16(file, val & 0xFFFF);
+  put16(file, val >> 16);
+}
+
+static int get16(FILE *file, uint16_t *val){
+  int lo = fgetc(file);
+  int hi = fgetc(file);
+  if(hi == EOF) return 0;
+  *val = lo | (hi << 8);
+  return 1;
+}
+
+static int get32(FILE *file, uint32_t *val){
+  uint16_t lo, hi;
+  if(!get16(file, &lo) || !get16(file, &hi)) return 0;
+  *val = lo | (uint32_t)hi << 16;
+  return 1;
+}
+
+static int get64(FILE *file, uint64_t *val){
+  *val = 0;
+  for(int i = 0; i < 8; i++){
+    int c = fgetc(file);
+    if(c == EOF) return 0;
+    *val |= (uint64_t)c << (i * 8);
+  }
+  return 1;
+}
+
+
+/*
+ * ============================================
+ * RECORDING
+ * ============================================
+ */
+
+int movie_record(struct movie *movie, const char *path,
+		 const uint8_t *image, int image_len, uint16_t load, uint16_t pc,
+		 uint32_t frame_cycles){
+  memset(movie, 0, sizeof(struct movie));
+  movie->file = fopen(path, "wb");
+  if(!movie->file){
+    perror(path);
+    return -1;
+  }
+  movie->recording = 1;
+  movie->machine = MOVIE_EASY6502;
+  movie->load = load;
+  movie->pc = pc;
+  movie->frame_cycles = frame_cycles;
+
+  fwrite(MOVIE_MAGIC, 1, 4, movie->file);
+  put16(movie->file, MOVIE_VERSION);
+  put16(movie->file, movie->machine);
+  put16(movie->file, load);
+  put16(movie->file, pc);
+  put32(movie->file, frame_cycles);
+  put16(movie->file, image_len);
+  fwrite(image, 1, image_len, movie->file);
+  return 0;
+}
+
+/*
+ * Writes value to addr from outside the cpu, recording it if we are
+ * recording. Every input to the machine has to go through here.
+ */
+void movie_inject(struct movie *movie, struct cpu_info *cpu, uint16_t addr, uint8_t value){
+  write8(cpu->mem, addr, value);
+  if(!movie || !movie->recording) return;
+
+  fputc(MOVIE_RECORD_WRITE, movie->file);
+  put64(movie->file, cpu->clock);
+  put16(movie->file, addr);
+  fputc(value, movie->file);
+}
+
+void movie_finish(struct movie *movie, struct cpu_info *cpu){
+  fputc(MOVIE_RECORD_END, movie->file);
+  put64(movie->file, cpu->clock);
+  put64(movie->file, machine_hash(cpu));
+  fclose(movie->file);
+  movie->file = NULL;
+}
+
+
+/*
+ * ============================================
+ * REPLAYING
+ * ============================================
+ */
+
+int movie_open(struct movie *movie, const char *path){
+  memset(movie, 0, sizeof(struct movie));
+  movie->file = fopen(path, "rb");
+  if(!movie->file){
+    perror(path);
+    return -1;
+  }
+
+  char magic[4];
+  uint16_t version, machine, load, pc, len;
+  uint32_t frame_cycles;
+  if(fread(magic, 1, 4, movie->file) != 4 || memcmp(magic, MOVIE_MAGIC, 4) ||
+     !get16(movie->file, &version) || version != MOVIE_VERSION ||
+     !get16(movie->file, &machine) || !get16(movie->file, &load) ||
+     !get16(movie->file, &pc) || !get32(movie->file, &frame_cycles) ||
+     !get16(movie->file, &len)){
+    fprintf(stderr, "%s: not a movie this version can play\n", path);
+    movie_close(movie);
+    return -1;
+  }
+
+  movie->machine = machine;
+  movie->load = load;
+  movie->pc = pc;
+  movie->frame_cycles = frame_cycles;
+  movie->image_len = len;
+  movie->image = malloc(len);
+  if(fread(movie->image, 1, len, movie->file) != len){
+    fprintf(stderr, "%s: truncated image\n", path);
+    movie_close(movie);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Reads the next injected write. Returns 0 at the end of the movie, after
+ * filling in the end record if there is one (a recording that was cut
+ * short won't have it).
+ */
+int movie_next(struct movie *movie, struct movie_event *event){
+  int tag = fgetc(movie->file);
+  if(tag == MOVIE_RECORD_WRITE){
+    int value;
+    if(get64(movie->file, &event->cycle) && get16(movie->file, &event->addr) &&
+       (value = fgetc(movie->file)) != EOF){
+      event->value = value;
+      return 1;
+    }
+  } else if(tag == MOVIE_RECORD_END){
+    movie->ended = get64(movie->file, &movie->end_cycle) &&
+      get64(movie->file, &movie->end_hash);
+  }
+  return 0;
+}
+
+/*
+ * Replays the movie up to cycle until: runs to each recorded write and
+ * repeats it, then on to until. Writes recorded at until itself are left
+ * for the next call, so the machine is in the state the recording was in
+ * when it reached until. Past the last write it runs no further than the
+ * recording did. Returns -1 if the replay desyncs from the recording.
+ */
+int movie_play(struct movie *movie, struct cpu_info *cpu, struct scheduler *sched, uint64_t until){
+  for(;;){
+    if(!movie->pending){
+      movie->next_offset = ftell(movie->file);
+      movie->pending = movie_next(movie, &movie->next);
+      if(!movie->pending){
+	// nothing more was recorded
+	uint64_t end = movie->ended ? movie->end_cycle : cpu->clock;
+	if(until > end) until = end;
+	break;
+      }
+    }
+    if(movie->next.cycle >= until) break;
+
+    run_until(cpu, sched, movie->next.cycle);
+    if(cpu->clock != movie->next.cycle && !cpu->finished){
+      fprintf(stderr, "desynced: input for cycle %llu arrived at %llu\n",
+	      (unsigned long long)movie->next.cycle, (unsigned long long)cpu->clock);
+      return -1;
+    }
+    movie_inject(NULL, cpu, movie->next.addr, movie->next.value);
+    movie->pending = 0;
+  }
+  if(cpu->clock < until) run_until(cpu, sched, until);
+  return 0;
+}
+
+// where the next record movie_play will use starts
+long movie_tell(struct movie *movie){
+  return movie->pending ? movie->next_offset : ftell(movie->file);
+}
+
+int movie_seek(struct movie *movie, long offset){
+  movie->pending = 0;
+  return fseek(movie->file, offset, SEEK_SET);
+}
+
+void movie_close(struct movie *movie){
+  if(movie->file) fclose(movie->file);
+  free(movie->image);
+  movie->file = NULL;
+  movie->image = NULL;
+}
+
+
+// an FNV-1a hash of the registers and RAM
+uint64_t machine_hash(struct cpu_info *cpu){
+  uint64_t hash = 0xCBF29CE484222325ULL;
+#define HASH(byte) hash = (hash ^ (uint8_t)(byte)) * 0x100000001B3ULL
+  HASH(cpu->a); HASH(cpu->x); HASH(cpu->y); HASH(cpu->s);
+  HASH(cpu->pc); HASH(cpu->pc >> 8);
+  HASH(STATUS_BYTE(cpu, 0));
+  for(int i = 0; i < MOVIE_RAM; i++){
+    HASH(read8(cpu->mem, i));
+  }
+#undef HASH
+  return hash;
+}
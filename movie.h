@@ -0,0 +1,81 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "6502.h"
+#include "sched.h"
+
+/*
+ * Movies: recordings of everything from outside that went into a run, so
+ * it can be re-executed exactly, headless and at full speed.
+ *
+ * A movie starts with a header and the program image, followed by one
+ * record per injected write (key presses, random numbers), keyed by the
+ * cpu clock it happened at. Injections only happen between batches of
+ * instructions, and those always end on the same clock values for the
+ * same inputs, so replaying runs to each record's clock and repeats the
+ * write. A closing record holds the final clock and machine_hash(), which
+ * the replay checks. The header also says how many cycles the recording
+ * ran each frame for, so a replay can count in frames.
+ *
+ * All values are little endian.
+ */
+
+#define MOVIE_MAGIC "RMOV"
+#define MOVIE_VERSION 2
+
+// the machines a movie can be recorded on
+#define MOVIE_EASY6502 0
+
+// the RAM both of them have at 0x0000, which is all of their state
+#define MOVIE_RAM 0x800
+
+#define MOVIE_RECORD_WRITE 'W'
+#define MOVIE_RECORD_END 'E'
+
+struct movie_event{
+  uint64_t cycle;
+  uint16_t addr;
+  uint8_t value;
+};
+
+struct movie{
+  FILE *file;
+  int recording;
+
+  int machine;
+  uint16_t load;
+  uint16_t pc;
+  uint32_t frame_cycles;
+  int image_len;
+  uint8_t *image;
+
+  // a write read ahead by movie_play, and where its record starts
+  int pending;
+  struct movie_event next;
+  long next_offset;
+
+  // filled in once the end record has been read
+  int ended;
+  uint64_t end_cycle;
+  uint64_t end_hash;
+};
+
+int movie_record(struct movie *movie, const char *path,
+		 const uint8_t *image, int image_len, uint16_t load, uint16_t pc,
+		 uint32_t frame_cycles);
+void movie_inject(struct movie *movie, struct cpu_info *cpu, uint16_t addr, uint8_t value);
+void movie_finish(struct movie *movie, struct cpu_info *cpu);
+
+int movie_open(struct movie *movie, const char *path);
+int movie_next(struct movie *movie, struct movie_event *event);
+int movie_play(struct movie *movie, struct cpu_info *cpu, struct scheduler *sched, uint64_t until);
+long movie_tell(struct movie *movie);
+int movie_seek(struct movie *movie, long offset);
+void movie_close(struct movie *movie);
+
+uint64_t machine_hash(struct cpu_info *cpu);
+
+#endif
@@ -1,12 +1,17 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "nes_memory.h"
+#include "6502.h"
 
 struct nes_memory{
   struct memory mem_iface;
-  uint8_t *ram;
-  uint8_t *ppu;
-  
+  uint8_t ram[2048];
+  uint8_t ppu[8];
+  // sprite memory, filled by OAM DMA
+  uint8_t oam[256];
+  // what unmapped addresses read as, and where writes to them go
+  uint8_t open_bus;
 };
 
 
@@ -16,7 +21,12 @@ struct nes_memory{
 #define APU_DISABLED_END 0x401F
 #define CART_END 0xFFFF
 
-uint8_t * decode_nes(struct memory *memory, uint16_t addr){
+// the ppu register sprite memory is written at
+#define OAM_ADDR 3
+// writing a page number here copies that page into sprite memory
+#define OAM_DMA 0x4014
+
+static inline uint8_t * nes_at(struct memory *memory, uint16_t addr){
   struct nes_memory * mem_nes = (struct nes_memory*) memory;
 
   if(addr <= RAM_END){
@@ -25,17 +35,85 @@ uint8_t * decode_nes(struct memory *memory, uint16_t addr){
 
   } else if(addr <= PPU_END){
     //address PPU registers
+    return mem_nes->ppu + (addr & 0x7);
   } else if(addr <= APU_END){
     //address APU/IO registers
   } else if(addr <= APU_DISABLED_END){
   } else{
     //address cartridge
   }
+  return &mem_nes->open_bus;
+}
+
+uint8_t * decode_nes(struct memory *memory, uint16_t addr){
+  return nes_at(memory, addr);
+}
+
+// only ram pages are plain memory
+static uint8_t * page_nes(struct memory *memory, uint16_t addr, int writing){
+  if(addr > RAM_END) return NULL;
+  return nes_at(memory, addr);
+}
+
+/*
+ * OAM DMA: copies the page into sprite memory as 256 writes to OAMDATA
+ * would, starting at OAMADDR and wrapping around. Returns the cycles it
+ * stalls the cpu for: 513, and one more to line up with the ppu when the
+ * clock the write leaves is odd.
+ */
+static int nes_oam_dma(struct memory *memory, uint8_t page, uint64_t clock){
+  struct nes_memory *mem_nes = (struct nes_memory*) memory;
+  uint8_t buf[0x100];
+  const uint8_t *src = mem_page(memory, page << 8, 0);
+  if(!src){
+    mem_read_block(memory, page << 8, buf, sizeof(buf));
+    src = buf;
+  }
+  uint8_t start = mem_nes->ppu[OAM_ADDR];
+  memcpy(mem_nes->oam + start, src, 0x100 - start);
+  memcpy(mem_nes->oam, src + 0x100 - start, start);
+  return 513 + (clock & 1);
+}
+
+static int store_nes(struct memory *memory, uint16_t addr, uint8_t val, uint64_t clock){
+  return addr == OAM_DMA ? nes_oam_dma(memory, val, clock) : 0;
+}
+
+/*
+ * The core specialised for the NES memory map, with the decoding above
+ * inlined into every access.
+ */
+#define READ8(cpu, addr) (*nes_at((cpu)->mem, (addr)))
+#define READ16(cpu, addr) read16_nes((cpu)->mem, (addr))
+#define WRITE8(cpu, addr, val) write8_nes((cpu), (addr), (val))
+
+static inline uint16_t read16_nes(struct memory *mem, uint16_t ptr){
+  uint16_t lo = *nes_at(mem, ptr);
+  uint16_t hi = *nes_at(mem, ptr+1) << 8;
+  return hi | lo;
+}
+
+// store_nes inlined; for a constant address the check folds away
+static inline void write8_nes(struct cpu_info *cpu, uint16_t addr, uint8_t val){
+  *nes_at(cpu->mem, addr) = val;
+  if(addr == OAM_DMA) cpu->clock += nes_oam_dma(cpu->mem, val, cpu->clock);
+}
+
+#define CORE_NAME nes
+#define CORE_SUPERINSTRUCTIONS
+#include "6502_core.h"
+
+uint8_t *nes_oam(struct memory *mem){
+  return ((struct nes_memory*) mem)->oam;
 }
 
 struct memory* make_nes_mem(){
-  struct nes_memory* out = malloc(sizeof(struct nes_memory));
+  struct nes_memory* out = calloc(1, sizeof(struct nes_memory));
   out->mem_iface.decode_address_I = decode_nes;
+  out->mem_iface.core_I = &nes_core;
+  out->mem_iface.page_I = page_nes;
+  out->mem_iface.store_I = store_nes;
+  out->mem_iface.size = sizeof(struct nes_memory);
 
   return (struct memory*)out;
 }
@@ -4,5 +4,7 @@
 #include "memory.h"
 
 struct memory* make_nes_mem();
+// the 256 bytes of sprite memory
+uint8_t *nes_oam(struct memory *mem);
 
 #endif
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "paged_memory.h"
+#include "6502.h"
+
+#define PAGE_SIZE 0x100
+// pages the pool takes from malloc at a time
+#define POOL_SLAB 64
+
+struct page_image{
+  size_t size;
+  _Alignas(64) uint8_t data[];
+};
+
+struct paged_mem{
+  struct memory mem_iface;
+  const struct page_image *image;
+  // the address space's size, less one
+  uint16_t mask;
+  // a bit for each page that is our own rather than the image's
+  uint64_t owned[4];
+  // where each page is
+  uint8_t *pages[];
+};
+
+
+/*
+ * The pool of pages for memories to take as their own. Free pages are
+ * kept in a list, linked through their first bytes, and the pool grows
+ * a slab at a time; slabs are never given back.
+ */
+struct page_pool{
+  uint8_t *free;
+};
+
+static __thread struct page_pool pool;
+
+static uint8_t *pool_get(void){
+  if(!pool.free){
+    uint8_t *slab = aligned_alloc(64, PAGE_SIZE * POOL_SLAB);
+    if(!slab){
+      // a cpu write has nowhere to report this to
+      perror("page pool");
+      exit(1);
+    }
+    for(int i = 0; i < POOL_SLAB; i++){
+      uint8_t *next = i + 1 < POOL_SLAB ? slab + (i + 1) * PAGE_SIZE : NULL;
+      memcpy(slab + i * PAGE_SIZE, &next, sizeof(next));
+    }
+    pool.free = slab;
+  }
+  uint8_t *page = pool.free;
+  memcpy(&pool.free, page, sizeof(pool.free));
+  return page;
+}
+
+static void pool_put(uint8_t *page){
+  memcpy(page, &pool.free, sizeof(pool.free));
+  pool.free = page;
+}
+
+
+struct page_image *page_image_create(size_t size, uint16_t load,
+				     const uint8_t *program, size_t len){
+  struct page_image *image = aligned_alloc(64, sizeof(struct page_image) + size);
+  if(!image) return NULL;
+  image->size = size;
+  memset(image->data, 0, size);
+  for(size_t i = 0; i < len; i++){
+    image->data[(load + i) & (size - 1)] = program[i];
+  }
+  return image;
+}
+
+void page_image_free(struct page_image *image){
+  free(image);
+}
+
+
+static inline int paged_is_owned(struct paged_mem *mem, int page){
+  return mem->owned[page >> 6] >> (page & 63) & 1;
+}
+
+// the page becomes our own, a copy of what it was
+static __attribute__((noinline)) void paged_own(struct paged_mem *mem, int page){
+  uint8_t *copy = pool_get();
+  memcpy(copy, mem->pages[page], PAGE_SIZE);
+  mem->pages[page] = copy;
+  mem->owned[page >> 6] |= 1ULL << (page & 63);
+}
+
+static inline const uint8_t * paged_read_at(struct memory *memory, uint16_t addr){
+  struct paged_mem *mem = (struct paged_mem *) memory;
+  addr &= mem->mask;
+  return mem->pages[addr >> 8] + (addr & 0xFF);
+}
+
+static inline uint8_t * paged_write_at(struct memory *memory, uint16_t addr){
+  struct paged_mem *mem = (struct paged_mem *) memory;
+  addr &= mem->mask;
+  int page = addr >> 8;
+  if(!paged_is_owned(mem, page)) paged_own(mem, page);
+  return mem->pages[page] + (addr & 0xFF);
+}
+
+// only read through, writes go through write_paged
+static uint8_t * decode_paged(struct memory *memory, uint16_t addr){
+  return (uint8_t *)paged_read_at(memory, addr);
+}
+
+static uint8_t * write_paged(struct memory *memory, uint16_t addr){
+  return paged_write_at(memory, addr);
+}
+
+static uint8_t * page_paged(struct memory *memory, uint16_t addr, int writing){
+  // only written through when writing, so a read is fine with the image's
+  return writing ? paged_write_at(memory, addr) : (uint8_t *)paged_read_at(memory, addr);
+}
+
+// a clone starts out sharing our pages, so takes copies of them
+static void clone_paged(struct memory *memory){
+  struct paged_mem *mem = (struct paged_mem *) memory;
+  int count = (mem->mask + 1) / PAGE_SIZE;
+  for(int page = 0; page < count; page++){
+    if(paged_is_owned(mem, page)){
+      uint8_t *copy = pool_get();
+      memcpy(copy, mem->pages[page], PAGE_SIZE);
+      mem->pages[page] = copy;
+    }
+  }
+}
+
+static void free_paged(struct memory *memory){
+  struct paged_mem *mem = (struct paged_mem *) memory;
+  int count = (mem->mask + 1) / PAGE_SIZE;
+  for(int page = 0; page < count; page++){
+    if(paged_is_owned(mem, page)){
+      pool_put(mem->pages[page]);
+      mem->pages[page] = (uint8_t *)mem->image->data + page * PAGE_SIZE;
+    }
+  }
+  memset(mem->owned, 0, sizeof(mem->owned));
+}
+
+/*
+ * The core specialised for this memory: reads come straight from the page
+ * table, and only writes check whether the page is our own.
+ */
+#define READ8(cpu, addr) (*paged_read_at((cpu)->mem, (addr)))
+#define READ16(cpu, addr) read16_paged((cpu)->mem, (addr))
+#define WRITE8(cpu, addr, val) (*paged_write_at((cpu)->mem, (addr)) = (val))
+
+static inline uint16_t read16_paged(struct memory *mem, uint16_t ptr){
+  return *paged_read_at(mem, ptr) | *paged_read_at(mem, ptr+1) << 8;
+}
+
+#define CORE_NAME paged
+#define CORE_SUPERINSTRUCTIONS
+#include "6502_core.h"
+
+struct memory *make_paged_mem(const struct page_image *image){
+  int count = image->size / PAGE_SIZE;
+  size_t size = sizeof(struct paged_mem) + count * sizeof(uint8_t *);
+  struct paged_mem *out = calloc(1, size);
+  if(!out) return NULL;
+  out->mem_iface.decode_address_I = decode_paged;
+  out->mem_iface.write_address_I = write_paged;
+  out->mem_iface.core_I = &paged_core;
+  out->mem_iface.size = size;
+  out->mem_iface.page_I = page_paged;
+  out->mem_iface.clone_I = clone_paged;
+  out->mem_iface.free_I = free_paged;
+  out->image = image;
+  out->mask = image->size - 1;
+  for(int page = 0; page < count; page++){
+    // never written through, see paged_write_at
+    out->pages[page] = (uint8_t *)image->data + page * PAGE_SIZE;
+  }
+  return (struct memory *)out;
+}
+
+int paged_mem_owned(struct memory *memory){
+  struct paged_mem *mem = (struct paged_mem *) memory;
+  int owned = 0;
+  for(int i = 0; i < 4; i++){
+    owned += __builtin_popcountll(mem->owned[i]);
+  }
+  return owned;
+}
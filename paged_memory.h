@@ -0,0 +1,40 @@
+#ifndef PAGED_MEMORY_H
+#define PAGED_MEMORY_H
+
+#include "memory.h"
+
+/*
+ * Copy-on-write memory, for running many instances of one program.
+ *
+ * A page image is the program (or ROM) laid out once, read only, and
+ * shared by every memory made from it. A memory starts out with each page
+ * of its page table pointing into the image, and only gets a page of its
+ * own the first time that page is written, so an instance costs its page
+ * table and the pages it has written. Pages of its own come from a pool
+ * kept by each thread, and go back to the pool of the thread freeing them.
+ *
+ * Like the flat memories, the address space is a power of two bytes that
+ * repeats through the 64k: 2k for an easy 6502 machine, up to the whole
+ * 64k.
+ *
+ * The memory has a core of its own, which reads without copying, and so
+ * do read8() and decode_address(): a pointer from decode_address() must
+ * only be read through. write8() is what makes a page the memory's own.
+ */
+
+struct page_image;
+
+/*
+ * An image of size bytes (a power of two, from 256 to 0x10000), zeroed,
+ * with len bytes of program copied to load. NULL if it is out of memory.
+ */
+struct page_image *page_image_create(size_t size, uint16_t load,
+				     const uint8_t *program, size_t len);
+void page_image_free(struct page_image *image);
+
+// the image must outlive every memory made from it
+struct memory *make_paged_mem(const struct page_image *image);
+// the number of pages the memory has of its own
+int paged_mem_owned(struct memory *mem);
+
+#endif
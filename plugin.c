@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "plugin.h"
+
+/*
+ * The plugin cores: the generic core with the hooks for instruction
+ * events, memory events or both compiled in, each dispatching to just
+ * the plugins that subscribed.
+ */
+static inline void plugin_instruction(struct cpu_info *cpu, uint8_t opcode){
+  struct plugin_host *host = cpu->plugins;
+  for(int i = 0; i < host->instruction_count; i++){
+    host->instruction[i]->instruction(host->instruction[i]->ctx, cpu, opcode);
+  }
+}
+
+static inline void plugin_access(struct cpu_info *cpu, uint16_t addr, uint8_t value,
+				 enum plugin_access kind){
+  struct plugin_host *host = cpu->plugins;
+  for(int i = 0; i < host->access_count; i++){
+    host->access[i]->access(host->access[i]->ctx, cpu, addr, value, kind);
+  }
+}
+
+static inline uint8_t plugin_read8(struct cpu_info *cpu, uint16_t addr, enum plugin_access kind){
+  uint8_t value = read8(cpu->mem, addr);
+  plugin_access(cpu, addr, value, kind);
+  return value;
+}
+
+static inline uint16_t plugin_read16(struct cpu_info *cpu, uint16_t addr, enum plugin_access kind){
+  uint16_t lo = plugin_read8(cpu, addr, kind);
+  uint16_t hi = plugin_read8(cpu, addr + 1, kind) << 8;
+  return hi | lo;
+}
+
+static inline void plugin_write8(struct cpu_info *cpu, uint16_t addr, uint8_t val){
+  cpu_write8(cpu, addr, val);
+  plugin_access(cpu, addr, val, PLUGIN_WRITE);
+}
+
+// instruction events only
+#define READ8(cpu, addr) read8((cpu)->mem, (addr))
+#define READ16(cpu, addr) read16((cpu)->mem, (addr))
+#define WRITE8(cpu, addr, val) cpu_write8((cpu), (addr), (val))
+#define CORE_BEFORE_INSTRUCTION plugin_instruction
+#define CORE_NAME plugin_i
+#include "6502_core.h"
+
+#undef READ8
+#undef READ16
+#undef WRITE8
+#undef CORE_BEFORE_INSTRUCTION
+#undef CORE_NAME
+
+// memory events only
+#define READ8(cpu, addr) plugin_read8((cpu), (addr), PLUGIN_READ)
+#define READ16(cpu, addr) plugin_read16((cpu), (addr), PLUGIN_READ)
+#define FETCH8(cpu, addr) plugin_read8((cpu), (addr), PLUGIN_FETCH)
+#define FETCH16(cpu, addr) plugin_read16((cpu), (addr), PLUGIN_FETCH)
+#define WRITE8(cpu, addr, val) plugin_write8((cpu), (addr), (val))
+#define CORE_NAME plugin_m
+#include "6502_core.h"
+
+#undef CORE_NAME
+
+// both
+#define CORE_BEFORE_INSTRUCTION plugin_instruction
+#define CORE_NAME plugin_im
+#include "6502_core.h"
+
+
+void plugins_init(struct plugin_host *host){
+  memset(host, 0, sizeof(struct plugin_host));
+}
+
+int plugins_load(struct plugin_host *host, const char *spec){
+  if(host->count == MAX_PLUGINS){
+    fprintf(stderr, "%s: too many plugins\n", spec);
+    return -1;
+  }
+  char path[4096];
+  snprintf(path, sizeof(path), "%s", spec);
+  char *colon = strchr(path, ':');
+  const char *args = "";
+  if(colon){
+    *colon = 0;
+    args = colon + 1;
+  }
+  // dlopen only looks in the library path for names without a '/'
+  char local[4096 + 2];
+  if(!strchr(path, '/')){
+    snprintf(local, sizeof(local), "./%s", path);
+  } else{
+    snprintf(local, sizeof(local), "%s", path);
+  }
+
+  void *handle = dlopen(local, RTLD_NOW | RTLD_LOCAL);
+  if(!handle){
+    fprintf(stderr, "%s\n", dlerror());
+    return -1;
+  }
+  int (*init)(struct ricoh_plugin*, const char*) =
+    (int (*)(struct ricoh_plugin*, const char*))dlsym(handle, RICOH_PLUGIN_INIT);
+  if(!init){
+    fprintf(stderr, "%s: no %s\n", path, RICOH_PLUGIN_INIT);
+    dlclose(handle);
+    return -1;
+  }
+  struct ricoh_plugin *plugin = &host->plugins[host->count];
+  memset(plugin, 0, sizeof(struct ricoh_plugin));
+  plugin->abi = RICOH_PLUGIN_ABI;
+  if(init(plugin, args) < 0){
+    fprintf(stderr, "%s: failed to start\n", path);
+    dlclose(handle);
+    return -1;
+  }
+  host->handles[host->count++] = handle;
+
+  if(plugin->instruction) host->instruction[host->instruction_count++] = plugin;
+  if(plugin->access) host->access[host->access_count++] = plugin;
+  if(plugin->interrupt) host->interrupt[host->interrupt_count++] = plugin;
+  if(plugin->frame) host->frame[host->frame_count++] = plugin;
+  return 0;
+}
+
+// switches the cpu to the core with just the hooks the plugins want
+int plugins_attach(struct plugin_host *host, struct cpu_info *cpu){
+  if(cpu->heat) return -1;
+  if(cpu->plugins) return 0;
+  host->resume = cpu->core;
+  cpu->plugins = host;
+  if(host->instruction_count && host->access_count){
+    cpu->core = &plugin_im_core;
+  } else if(host->instruction_count){
+    cpu->core = &plugin_i_core;
+  } else if(host->access_count){
+    cpu->core = &plugin_m_core;
+  }
+  return 0;
+}
+
+void plugins_detach(struct cpu_info *cpu){
+  if(!cpu->plugins) return;
+  cpu->core = cpu->plugins->resume;
+  cpu->plugins = NULL;
+}
+
+void plugins_unload(struct plugin_host *host, struct cpu_info *cpu, FILE *out){
+  if(cpu->plugins == host) plugins_detach(cpu);
+  for(int i = 0; i < host->count; i++){
+    if(host->plugins[i].finish) host->plugins[i].finish(host->plugins[i].ctx, cpu, out);
+    dlclose(host->handles[i]);
+  }
+  plugins_init(host);
+}
+
+void plugins_interrupt(struct cpu_info *cpu, uint16_t vector){
+  struct plugin_host *host = cpu->plugins;
+  for(int i = 0; i < host->interrupt_count; i++){
+    host->interrupt[i]->interrupt(host->interrupt[i]->ctx, cpu, vector);
+  }
+}
+
+void plugins_frame(struct cpu_info *cpu){
+  struct plugin_host *host = cpu->plugins;
+  if(!host) return;
+  for(int i = 0; i < host->frame_count; i++){
+    host->frame[i]->frame(host->frame[i]->ctx, cpu, host->frames);
+  }
+  host->frames++;
+}
@@ -0,0 +1,86 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "6502.h"
+
+/*
+ * Plugins: shared objects loaded with dlopen that watch the emulation
+ * (tracing, coverage, cheat search, counters ...) without the core
+ * having to know about them. A plugin exports
+ *
+ *   int ricoh_plugin_init(struct ricoh_plugin *plugin, const char *args);
+ *
+ * which is handed a zeroed struct ricoh_plugin with abi set, and fills in
+ * the callbacks for the events it wants, returning 0 (or -1 to refuse to
+ * load, e.g. when abi isn't RICOH_PLUGIN_ABI). args is whatever followed
+ * a ':' in the plugin's path on the command line, or "".
+ *
+ * Events cost nothing unless a plugin subscribes to them. Instruction
+ * and memory events are delivered by a core compiled with just the hooks
+ * asked for, which the cpu is switched to while plugins are attached;
+ * without them the cpu keeps its own core (and the plugin cores don't
+ * keep the region counts of metrics.h). Interrupt and frame events are
+ * rare enough to be dispatched from a list.
+ *
+ * Plugins see struct cpu_info as this build lays it out, and read and
+ * write memory through memory.h, so RICOH_PLUGIN_ABI is bumped whenever
+ * either changes.
+ */
+
+#define RICOH_PLUGIN_ABI 2
+#define RICOH_PLUGIN_INIT "ricoh_plugin_init"
+
+enum plugin_access{ PLUGIN_READ, PLUGIN_WRITE, PLUGIN_FETCH };
+
+struct ricoh_plugin{
+  int abi;
+  // the plugin's own, passed back to every callback
+  void *ctx;
+  // before each instruction, with the pc still at its opcode
+  void (*instruction)(void *ctx, struct cpu_info *cpu, uint8_t opcode);
+  // after each access the cpu makes, with the value read or written
+  void (*access)(void *ctx, struct cpu_info *cpu, uint16_t addr, uint8_t value,
+		 enum plugin_access kind);
+  // after an NMI or IRQ is taken, with the vector it went through
+  void (*interrupt)(void *ctx, struct cpu_info *cpu, uint16_t vector);
+  // at the end of every frame
+  void (*frame)(void *ctx, struct cpu_info *cpu, uint64_t frame);
+  // when the plugin is unloaded, to report to out and free ctx
+  void (*finish)(void *ctx, struct cpu_info *cpu, FILE *out);
+};
+
+#define MAX_PLUGINS 16
+
+struct plugin_host{
+  int count;
+  struct ricoh_plugin plugins[MAX_PLUGINS];
+  void *handles[MAX_PLUGINS];
+
+  // the subscribers to each event, so dispatching skips the rest
+  int instruction_count, access_count, interrupt_count, frame_count;
+  struct ricoh_plugin *instruction[MAX_PLUGINS];
+  struct ricoh_plugin *access[MAX_PLUGINS];
+  struct ricoh_plugin *interrupt[MAX_PLUGINS];
+  struct ricoh_plugin *frame[MAX_PLUGINS];
+
+  uint64_t frames;
+  // the core the cpu was running before plugins_attach()
+  const struct cpu_core *resume;
+};
+
+void plugins_init(struct plugin_host *host);
+// loads "path" or "path:args", returning -1 (having said why) on failure
+int plugins_load(struct plugin_host *host, const char *spec);
+// fails, returning -1, while a heatmap is being taken, as it has a core of its own
+int plugins_attach(struct plugin_host *host, struct cpu_info *cpu);
+void plugins_detach(struct cpu_info *cpu);
+// detaches, finishes and dlcloses every plugin
+void plugins_unload(struct plugin_host *host, struct cpu_info *cpu, FILE *out);
+
+void plugins_interrupt(struct cpu_info *cpu, uint16_t vector);
+void plugins_frame(struct cpu_info *cpu);
+
+#endif
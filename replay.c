@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "6502.h"
+#include "sched.h"
+#include "movie.h"
+#include "keyframe.h"
+#include "screen.h"
+#include "video.h"
+
+/*
+ * Replays a movie recorded with 'gui -r', headless and as fast as the
+ * machine can run, then checks the machine ended up in the state it was
+ * recorded in. Exits 0 if it did, 2 if it didn't, 1 if it can't tell.
+ *
+ * With -k the replay also writes a keyframe index, which later replays
+ * can -s seek to a frame with instead of replaying up to it.
+ *
+ * With -o every frame of the replay is written to a file or pipe (- for
+ * stdout), in the -f format (raw, ppm, y4m or hash).
+ */
+
+#define DEFAULT_INTERVAL 600
+
+static double now(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void usage(const char *name){
+  fprintf(stderr, "usage: %s [-q] [-k index [-i frames]] [-s frame] [-o video [-f format]] movie\n",
+	  name);
+  exit(1);
+}
+
+static void print_state(struct cpu_info *cpu){
+  printf("a %x, x %x, y %x, pc %x, s %x, hash %016llx\n",
+	 cpu->a, cpu->x, cpu->y, cpu->pc, cpu->s, (unsigned long long)machine_hash(cpu));
+}
+
+/*
+ * Replays the whole movie a frame at a time, writing each frame out. The
+ * screen is only redrawn when the program has drawn to it.
+ */
+static int capture(const char *path, int format, struct movie *movie,
+		   struct cpu_info *cpu, struct scheduler *sched){
+  struct video video;
+  if(video_open(&video, path, format, SCREEN_WIDTH, SCREEN_HEIGHT, FRAME_RATE) < 0) return -1;
+
+  uint32_t pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+  int status = 0;
+  for(uint64_t frame = 1; ; frame++){
+    uint64_t until = frame * movie->frame_cycles;
+    if(movie_play(movie, cpu, sched, until) < 0){
+      status = -1;
+      break;
+    }
+    if(cpu->visual_dirty){
+      render_screen(cpu, pixels);
+      cpu->visual_dirty = 0;
+    }
+    if(video_frame(&video, pixels) < 0){
+      status = -1;
+      break;
+    }
+    // the recording (or the program) has ended
+    if(cpu->clock < until) break;
+  }
+
+  if(video_close(&video) < 0) status = -1;
+  fprintf(stderr, "%llu frames, hash %016llx\n",
+	  (unsigned long long)video.frames, (unsigned long long)video.hash);
+  return status;
+}
+
+int main(int argc, char **argv){
+  int quiet = 0;
+  const char *index_path = NULL;
+  uint32_t interval = DEFAULT_INTERVAL;
+  int64_t seek_frame = -1;
+  const char *video_path = NULL;
+  int format = VIDEO_Y4M;
+  int opt;
+  while((opt = getopt(argc, argv, "qk:i:s:o:f:")) != -1){
+    switch(opt){
+    case 'q': quiet = 1; break;
+    case 'k': index_path = optarg; break;
+    case 'i': interval = strtoul(optarg, NULL, 0); break;
+    case 's': seek_frame = strtoll(optarg, NULL, 0); break;
+    case 'o': video_path = optarg; break;
+    case 'f': format = video_format_by_name(optarg); break;
+    default: usage(argv[0]);
+    }
+  }
+  if(optind >= argc || interval == 0 || format < 0) usage(argv[0]);
+  if(video_path && (index_path || seek_frame >= 0)) usage(argv[0]);
+  // keep stdout for the video
+  if(video_path && !strcmp(video_path, "-")) quiet = 1;
+
+  struct movie movie;
+  if(movie_open(&movie, argv[optind]) < 0) return 1;
+  if(movie.machine != MOVIE_EASY6502){
+    fprintf(stderr, "%s: unknown machine %d\n", argv[optind], movie.machine);
+    return 1;
+  }
+
+  // the same machine gui starts with
+  struct memory *mem = make_flat_2k_mem();
+  struct cpu_info cpu;
+  init_cpu_info(&cpu, mem);
+  for(int i = 0; i < movie.image_len; i++){
+    write8(mem, movie.load + i, movie.image[i]);
+  }
+  cpu.pc = movie.pc;
+  cpu.s = 0xFF;
+
+  struct scheduler sched;
+  init_scheduler(&sched);
+
+  if(seek_frame >= 0){
+    uint64_t cycle = seek_frame * movie.frame_cycles;
+    double start = now();
+    int status;
+    if(index_path){
+      struct keyframe_index index;
+      if(keyframe_open(&index, index_path, &movie) < 0) return 1;
+      status = keyframe_seek(&index, &movie, &cpu, &sched, cycle);
+      keyframe_close(&index);
+    } else{
+      status = movie_play(&movie, &cpu, &sched, cycle);
+    }
+    double elapsed = now() - start;
+    if(status < 0) return 2;
+    if(!quiet){
+      print_state(&cpu);
+      printf("frame %lld (cycle %llu) reached in %.2fms\n", (long long)seek_frame,
+	     (unsigned long long)cpu.clock, elapsed * 1000);
+    }
+    movie_close(&movie);
+    return 0;
+  }
+
+  double start = now();
+  int status;
+  if(index_path){
+    status = keyframe_build(index_path, &movie, &cpu, &sched, interval);
+  } else if(video_path){
+    status = capture(video_path, format, &movie, &cpu, &sched);
+  } else{
+    status = movie_play(&movie, &cpu, &sched, UINT64_MAX);
+  }
+  double elapsed = now() - start;
+  if(status < 0) return 2;
+
+  uint64_t hash = machine_hash(&cpu);
+  if(!quiet){
+    print_state(&cpu);
+    printf("%llu cycles, %llu instructions in %.3fs (%.1f MHz)\n",
+	   (unsigned long long)cpu.clock, (unsigned long long)cpu.instructions,
+	   elapsed, cpu.clock / elapsed / 1e6);
+  }
+
+  status = 0;
+  if(!movie.ended){
+    fprintf(stderr, "the movie has no end record (was the recording cut short?)\n");
+    status = 1;
+  } else if(cpu.clock != movie.end_cycle || hash != movie.end_hash){
+    fprintf(stderr, "mismatch: recorded hash %016llx at cycle %llu\n",
+	    (unsigned long long)movie.end_hash, (unsigned long long)movie.end_cycle);
+    status = 2;
+  } else if(!quiet){
+    printf("matches the recording\n");
+  }
+  movie_close(&movie);
+  return status;
+}
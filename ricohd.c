@@ -0,0 +1,557 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "6502.h"
+#include "sched.h"
+#include "machine.h"
+#include "movie.h"
+#include "screen.h"
+
+/*
+ * ricohd hosts any number of easy 6502 machines (sessions) for clients on
+ * a Unix socket. The protocol is a line per command, answered with a line
+ * starting "ok" or "err":
+ *
+ *   new                        -> ok <session>
+ *   free <s>
+ *   load <s> <addr> <hex>      copies the bytes to addr, and resets the
+ *                              cpu to run from there
+ *   run <s> <cycles>           -> ok <clock> <instructions> <finished>
+ *   read <s> <addr> <len>      -> ok <hex>
+ *   write <s> <addr> <hex>
+ *   regs <s>                   -> ok <a> <x> <y> <s> <pc> <p> <clock>
+ *   snapshot <s>               -> ok <session>, a new session copying s
+ *   restore <s> <from>         makes s a copy of session from
+ *   hash <s>                   -> ok <machine hash> <frame hash>
+ *
+ * Numbers are hex, except cycles and session ids. A run's <finished> is
+ * why the cpu stopped (enum cpu_stop in 6502.h): 0 if it can run on, 1
+ * at a BRK, 2 at an opcode that jams it. A stopped cpu runs no further,
+ * so a run never holds a worker for more than its cycles.
+ *
+ * One thread multiplexes the connections with epoll; commands run on a
+ * fixed pool of workers. A connection has at most one command running at
+ * a time, so its replies come back in order. The workers hand replies
+ * back through a list and an eventfd. Machines are never freed, only put
+ * back in a pool, so a new session is a memcpy from a blank machine.
+ */
+
+#define DEFAULT_SOCKET "/tmp/ricohd.sock"
+#define MAX_EVENTS 64
+// enough for a whole 64K image in hex
+#define MAX_LINE (1 << 18)
+#define READ_CHUNK 65536
+
+struct session{
+  int id;
+  int live;
+  pthread_mutex_t lock;
+  struct machine *machine;
+  struct scheduler sched;
+};
+
+struct conn{
+  int fd;
+  char *in;
+  size_t in_len;
+  char *out;
+  size_t out_len, out_cap;
+
+  // a command is out with a worker
+  int busy;
+  int hung_up;
+  // the client has finished sending
+  int eof;
+  char *line;
+  char *reply;
+  size_t reply_len, reply_cap;
+  struct conn *next;
+};
+
+static struct machine *blank;
+
+// sessions, and the pool of sessions not in use
+static pthread_mutex_t sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct session **sessions;
+static int session_count, session_capacity;
+static struct session **pool;
+static int pooled;
+
+// commands waiting for a worker, and replies waiting to be sent
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static struct conn *queue_head, *queue_tail;
+static struct conn *done;
+static int done_fd;
+
+static volatile sig_atomic_t quit = 0;
+
+static void stop(int sig){
+  quit = 1;
+}
+
+
+/*
+ * ============================================
+ * SESSIONS
+ * ============================================
+ */
+
+/*
+ * A new session, a copy of from. A session's lock is only ever taken
+ * while holding another session's lock in order of their ids (see
+ * restore), or here, where no one else can be waiting on the new one.
+ */
+static struct session *session_new(const struct machine *from){
+  pthread_mutex_lock(&sessions_lock);
+  struct session *session;
+  if(pooled > 0){
+    session = pool[--pooled];
+  } else{
+    session = malloc(sizeof(struct session));
+    session->machine = machine_arena(blank);
+    pthread_mutex_init(&session->lock, NULL);
+    init_scheduler(&session->sched);
+    if(session_count == session_capacity){
+      session_capacity = session_capacity ? session_capacity * 2 : 64;
+      sessions = realloc(sessions, session_capacity * sizeof(struct session *));
+      pool = realloc(pool, session_capacity * sizeof(struct session *));
+    }
+    session->id = session_count;
+    sessions[session_count++] = session;
+  }
+  pthread_mutex_unlock(&sessions_lock);
+
+  pthread_mutex_lock(&session->lock);
+  machine_clone(session->machine, from);
+  session->live = 1;
+  pthread_mutex_unlock(&session->lock);
+  return session;
+}
+
+// finds a live session and locks it
+static struct session *session_get(int id){
+  struct session *session = NULL;
+  pthread_mutex_lock(&sessions_lock);
+  if(id >= 0 && id < session_count) session = sessions[id];
+  pthread_mutex_unlock(&sessions_lock);
+  if(!session) return NULL;
+  pthread_mutex_lock(&session->lock);
+  if(!session->live){
+    pthread_mutex_unlock(&session->lock);
+    return NULL;
+  }
+  return session;
+}
+
+static void session_put(struct session *session){
+  pthread_mutex_unlock(&session->lock);
+}
+
+// frees a session got with session_get
+static void session_free(struct session *session){
+  session->live = 0;
+  pthread_mutex_unlock(&session->lock);
+  pthread_mutex_lock(&sessions_lock);
+  pool[pooled++] = session;
+  pthread_mutex_unlock(&sessions_lock);
+}
+
+
+/*
+ * ============================================
+ * COMMANDS
+ * ============================================
+ */
+
+static void reply(struct conn *conn, const char *fmt, ...){
+  va_list args;
+  for(;;){
+    va_start(args, fmt);
+    int n = vsnprintf(conn->reply + conn->reply_len, conn->reply_cap - conn->reply_len,
+		      fmt, args);
+    va_end(args);
+    if(conn->reply_len + n < conn->reply_cap){
+      conn->reply_len += n;
+      return;
+    }
+    conn->reply_cap = (conn->reply_len + n) * 2;
+    conn->reply = realloc(conn->reply, conn->reply_cap);
+  }
+}
+
+static int hex_digit(char c){
+  if(c >= '0' && c <= '9') return c - '0';
+  if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// writes hex to the machine from addr, returning the number of bytes or -1
+static int write_hex(struct cpu_info *cpu, uint16_t addr, const char *hex){
+  int len = strlen(hex);
+  if(len % 2) return -1;
+  for(int i = 0; i < len; i += 2){
+    int hi = hex_digit(hex[i]), lo = hex_digit(hex[i + 1]);
+    if(hi < 0 || lo < 0) return -1;
+    write8(cpu->mem, addr + i / 2, hi << 4 | lo);
+  }
+  return len / 2;
+}
+
+static void execute(struct conn *conn){
+  char *save;
+  char *cmd = strtok_r(conn->line, " \t\r", &save);
+  char *args[3];
+  int argc = 0;
+  while(argc < 3 && (args[argc] = strtok_r(NULL, " \t\r", &save))) argc++;
+
+  if(!cmd){
+    reply(conn, "err empty command\n");
+    return;
+  }
+  if(!strcmp(cmd, "new")){
+    reply(conn, "ok %d\n", session_new(blank)->id);
+    return;
+  }
+  if(!strcmp(cmd, "restore") && argc == 2){
+    int to_id = atoi(args[0]), from_id = atoi(args[1]);
+    int first_id = to_id < from_id ? to_id : from_id;
+    int second_id = to_id < from_id ? from_id : to_id;
+    struct session *first = NULL, *second = NULL;
+    if(to_id != from_id && (first = session_get(first_id)) &&
+       (second = session_get(second_id))){
+      struct session *to = to_id == first_id ? first : second;
+      struct session *from = to_id == first_id ? second : first;
+      machine_clone(to->machine, from->machine);
+      reply(conn, "ok\n");
+    } else{
+      reply(conn, "err can't restore %s from %s\n", args[0], args[1]);
+    }
+    if(second) session_put(second);
+    if(first) session_put(first);
+    return;
+  }
+
+  if(argc < 1){
+    reply(conn, "err %s needs a session\n", cmd);
+    return;
+  }
+  struct session *session = session_get(atoi(args[0]));
+  if(!session){
+    reply(conn, "err no session %s\n", args[0]);
+    return;
+  }
+  struct cpu_info *cpu = &session->machine->cpu;
+
+  if(!strcmp(cmd, "free")){
+    session_free(session);
+    reply(conn, "ok\n");
+    return;
+  } else if(!strcmp(cmd, "load") && argc == 3){
+    uint16_t addr = strtoul(args[1], NULL, 16);
+    machine_clone(session->machine, blank);
+    if(write_hex(cpu, addr, args[2]) < 0){
+      reply(conn, "err bad hex\n");
+    } else{
+      cpu->pc = addr;
+      cpu->s = 0xFF;
+      reply(conn, "ok\n");
+    }
+  } else if(!strcmp(cmd, "run") && argc == 2){
+    run_until(cpu, &session->sched, cpu->clock + strtoull(args[1], NULL, 10));
+    reply(conn, "ok %llu %llu %d\n", (unsigned long long)cpu->clock,
+	  (unsigned long long)cpu->instructions, cpu->finished);
+  } else if(!strcmp(cmd, "read") && argc == 3){
+    uint16_t addr = strtoul(args[1], NULL, 16);
+    long len = strtol(args[2], NULL, 16);
+    if(len < 0 || len > 0x10000) len = 0;
+    reply(conn, "ok ");
+    for(long i = 0; i < len; i++){
+      reply(conn, "%02x", read8(cpu->mem, addr + i));
+    }
+    reply(conn, "\n");
+  } else if(!strcmp(cmd, "write") && argc == 3){
+    if(write_hex(cpu, strtoul(args[1], NULL, 16), args[2]) < 0){
+      reply(conn, "err bad hex\n");
+    } else{
+      reply(conn, "ok\n");
+    }
+  } else if(!strcmp(cmd, "regs")){
+    reply(conn, "ok %x %x %x %x %x %x %llu\n", cpu->a, cpu->x, cpu->y, cpu->s, cpu->pc,
+	  cpu->N << 7 | cpu->V << 6 | cpu->D << 3 | cpu->I << 2 | cpu->Z << 1 | cpu->C,
+	  (unsigned long long)cpu->clock);
+  } else if(!strcmp(cmd, "snapshot")){
+    reply(conn, "ok %d\n", session_new(session->machine)->id);
+  } else if(!strcmp(cmd, "hash")){
+    uint32_t pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+    render_screen(cpu, pixels);
+    reply(conn, "ok %016llx %016llx\n", (unsigned long long)machine_hash(cpu),
+	  (unsigned long long)frame_hash(pixels, SCREEN_WIDTH * SCREEN_HEIGHT));
+  } else{
+    reply(conn, "err bad command %s\n", cmd);
+  }
+  session_put(session);
+}
+
+static void *worker(void *arg){
+  for(;;){
+    pthread_mutex_lock(&queue_lock);
+    while(!queue_head){
+      pthread_cond_wait(&queue_ready, &queue_lock);
+    }
+    struct conn *conn = queue_head;
+    queue_head = conn->next;
+    if(!queue_head) queue_tail = NULL;
+    pthread_mutex_unlock(&queue_lock);
+
+    conn->reply_len = 0;
+    execute(conn);
+
+    pthread_mutex_lock(&queue_lock);
+    conn->next = done;
+    done = conn;
+    pthread_mutex_unlock(&queue_lock);
+    uint64_t one = 1;
+    if(write(done_fd, &one, sizeof(one)) < 0) perror("ricohd: eventfd");
+  }
+  return NULL;
+}
+
+
+/*
+ * ============================================
+ * CONNECTIONS
+ * ============================================
+ */
+
+static void conn_close(int epoll_fd, struct conn *conn){
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+  close(conn->fd);
+  free(conn->in);
+  free(conn->out);
+  free(conn->line);
+  free(conn->reply);
+  free(conn);
+}
+
+// sends what output we can, returning -1 if the connection is broken
+static int conn_flush(struct conn *conn){
+  size_t sent = 0;
+  while(sent < conn->out_len){
+    ssize_t n = write(conn->fd, conn->out + sent, conn->out_len - sent);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN) break;
+      return -1;
+    }
+    sent += n;
+  }
+  memmove(conn->out, conn->out + sent, conn->out_len - sent);
+  conn->out_len -= sent;
+  return 0;
+}
+
+// reads what input there is, returning -1 if the connection is broken
+static int conn_read(struct conn *conn){
+  while(!conn->eof && conn->in_len <= MAX_LINE){
+    ssize_t n = read(conn->fd, conn->in + conn->in_len, READ_CHUNK);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN) break;
+      return -1;
+    }
+    if(n == 0) conn->eof = 1;
+    conn->in_len += n;
+  }
+  // a line longer than any command could be
+  if(conn->in_len > MAX_LINE && !memchr(conn->in, '\n', conn->in_len)) return -1;
+  return 0;
+}
+
+/*
+ * Hands the next whole line to the workers if the connection is idle, and
+ * waits for whatever it can do next. Returns -1 once the connection is
+ * finished with: the client has stopped sending, and every command it
+ * sent has been answered.
+ */
+static int conn_update(int epoll_fd, struct conn *conn){
+  char *end;
+  if(!conn->busy && (end = memchr(conn->in, '\n', conn->in_len))){
+    size_t len = end - conn->in;
+    conn->line = realloc(conn->line, len + 1);
+    memcpy(conn->line, conn->in, len);
+    conn->line[len] = 0;
+    memmove(conn->in, end + 1, conn->in_len - len - 1);
+    conn->in_len -= len + 1;
+
+    conn->busy = 1;
+    conn->next = NULL;
+    pthread_mutex_lock(&queue_lock);
+    if(queue_tail) queue_tail->next = conn;
+    else queue_head = conn;
+    queue_tail = conn;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+  }
+  if(conn->eof && !conn->busy && !conn->out_len) return -1;
+
+  // stop reading while the buffer is full, until a command is taken out
+  struct epoll_event ev;
+  ev.events = (!conn->eof && conn->in_len <= MAX_LINE ? EPOLLIN : 0) |
+    (conn->out_len ? EPOLLOUT : 0);
+  ev.data.ptr = conn;
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+  return 0;
+}
+
+static int listen_on(const char *path){
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if(fd < 0){
+    perror("ricohd: socket");
+    return -1;
+  }
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  unlink(path);
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 128) < 0){
+    perror(path);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char **argv){
+  const char *path = DEFAULT_SOCKET;
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+  while((opt = getopt(argc, argv, "s:j:")) != -1){
+    switch(opt){
+    case 's': path = optarg; break;
+    case 'j': workers = atoi(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-s socket] [-j workers]\n", argv[0]);
+      return 1;
+    }
+  }
+  if(workers < 1) workers = 1;
+
+  blank = machine_create(make_flat_2k_mem());
+
+  int listen_fd = listen_on(path);
+  if(listen_fd < 0) return 1;
+  done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = &listen_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+  ev.data.ptr = &done_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, done_fd, &ev);
+
+  // the workers leave signals to this thread, so they interrupt epoll_wait
+  sigset_t stops, old;
+  sigemptyset(&stops);
+  sigaddset(&stops, SIGINT);
+  sigaddset(&stops, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stops, &old);
+  for(int i = 0; i < workers; i++){
+    pthread_t thread;
+    pthread_create(&thread, NULL, worker, NULL);
+    pthread_detach(thread);
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  fprintf(stderr, "ricohd: listening on %s with %ld workers\n", path, workers);
+
+  struct epoll_event events[MAX_EVENTS];
+  while(!quit){
+    int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      perror("ricohd: epoll_wait");
+      break;
+    }
+    for(int i = 0; i < n; i++){
+      void *ptr = events[i].data.ptr;
+      if(ptr == &listen_fd){
+	int fd;
+	while((fd = accept(listen_fd, NULL, NULL)) >= 0){
+	  fcntl(fd, F_SETFL, O_NONBLOCK);
+	  struct conn *conn = calloc(1, sizeof(struct conn));
+	  conn->fd = fd;
+	  conn->in = malloc(MAX_LINE + READ_CHUNK);
+	  ev.events = EPOLLIN;
+	  ev.data.ptr = conn;
+	  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+	}
+      } else if(ptr == &done_fd){
+	uint64_t count;
+	if(read(done_fd, &count, sizeof(count)) < 0 && errno != EAGAIN){
+	  perror("ricohd: eventfd");
+	}
+	pthread_mutex_lock(&queue_lock);
+	struct conn *list = done;
+	done = NULL;
+	pthread_mutex_unlock(&queue_lock);
+
+	while(list){
+	  struct conn *conn = list;
+	  list = conn->next;
+	  conn->busy = 0;
+	  if(conn->hung_up){
+	    conn_close(epoll_fd, conn);
+	    continue;
+	  }
+	  if(conn->out_len + conn->reply_len > conn->out_cap){
+	    conn->out_cap = (conn->out_len + conn->reply_len) * 2;
+	    conn->out = realloc(conn->out, conn->out_cap);
+	  }
+	  memcpy(conn->out + conn->out_len, conn->reply, conn->reply_len);
+	  conn->out_len += conn->reply_len;
+	  if(conn_flush(conn) < 0 || conn_update(epoll_fd, conn) < 0){
+	    conn_close(epoll_fd, conn);
+	  }
+	}
+      } else{
+	struct conn *conn = ptr;
+	uint32_t got = events[i].events;
+	int broken = (got & EPOLLERR) || (got & EPOLLHUP) ||
+	  ((got & EPOLLOUT) && conn_flush(conn) < 0) ||
+	  ((got & EPOLLIN) && conn_read(conn) < 0);
+	if(broken){
+	  // a worker may still have it, in which case it's closed when it's done
+	  if(conn->busy){
+	    conn->hung_up = 1;
+	    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	  } else{
+	    conn_close(epoll_fd, conn);
+	  }
+	} else if(conn_update(epoll_fd, conn) < 0){
+	  conn_close(epoll_fd, conn);
+	}
+      }
+    }
+  }
+
+  unlink(path);
+  return 0;
+}
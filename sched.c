@@ -0,0 +1,144 @@
+#include <stdlib.h>
+
+#include "sched.h"
+#include "gdbstub.h"
+
+
+void init_sched_event(struct sched_event *ev,
+		      void (*fire)(struct cpu_info*, struct sched_event*),
+		      void *ctx){
+  ev->when = SCHED_NEVER;
+  ev->fire = fire;
+  ev->ctx = ctx;
+  ev->slot = -1;
+}
+
+void init_scheduler(struct scheduler *sched){
+  sched->count = 0;
+  sched->capacity = 16;
+  sched->heap = malloc(sched->capacity * sizeof(struct sched_event*));
+}
+
+void free_scheduler(struct scheduler *sched){
+  for(int i = 0; i < sched->count; i++){
+    sched->heap[i]->slot = -1;
+  }
+  free(sched->heap);
+  sched->heap = NULL;
+  sched->count = 0;
+  sched->capacity = 0;
+}
+
+
+static void place(struct scheduler *sched, struct sched_event *ev, int slot){
+  sched->heap[slot] = ev;
+  ev->slot = slot;
+}
+
+static void sift_up(struct scheduler *sched, int slot){
+  struct sched_event *ev = sched->heap[slot];
+  while(slot > 0){
+    int parent = (slot - 1) / 2;
+    if(sched->heap[parent]->when <= ev->when) break;
+    place(sched, sched->heap[parent], slot);
+    slot = parent;
+  }
+  place(sched, ev, slot);
+}
+
+static void sift_down(struct scheduler *sched, int slot){
+  struct sched_event *ev = sched->heap[slot];
+  for(;;){
+    int child = slot * 2 + 1;
+    if(child >= sched->count) break;
+    if(child + 1 < sched->count &&
+       sched->heap[child + 1]->when < sched->heap[child]->when){
+      child++;
+    }
+    if(ev->when <= sched->heap[child]->when) break;
+    place(sched, sched->heap[child], slot);
+    slot = child;
+  }
+  place(sched, ev, slot);
+}
+
+/*
+ * Schedules ev to fire once the cpu clock reaches when. If ev is already
+ * scheduled it is moved to the new time.
+ */
+void sched_add(struct scheduler *sched, struct sched_event *ev, uint64_t when){
+  if(ev->slot >= 0){
+    uint64_t old = ev->when;
+    ev->when = when;
+    if(when < old){
+      sift_up(sched, ev->slot);
+    } else{
+      sift_down(sched, ev->slot);
+    }
+    return;
+  }
+
+  if(sched->count == sched->capacity){
+    sched->capacity *= 2;
+    sched->heap = realloc(sched->heap,
+			  sched->capacity * sizeof(struct sched_event*));
+  }
+  ev->when = when;
+  place(sched, ev, sched->count++);
+  sift_up(sched, ev->slot);
+}
+
+void sched_cancel(struct scheduler *sched, struct sched_event *ev){
+  int slot = ev->slot;
+  if(slot < 0) return;
+
+  ev->slot = -1;
+  sched->count--;
+  if(slot == sched->count) return;
+
+  // move the last event into the hole and restore the heap from there
+  place(sched, sched->heap[sched->count], slot);
+  if(slot > 0 && sched->heap[(slot - 1) / 2]->when > sched->heap[slot]->when){
+    sift_up(sched, slot);
+  } else{
+    sift_down(sched, slot);
+  }
+}
+
+// the clock value of the earliest event, or SCHED_NEVER
+uint64_t sched_next(struct scheduler *sched){
+  return sched->count ? sched->heap[0]->when : SCHED_NEVER;
+}
+
+/*
+ * Fires every event that is due. An event is unscheduled before it fires,
+ * so its handler is free to add it again (e.g. for periodic timers).
+ */
+void sched_dispatch(struct scheduler *sched, struct cpu_info *cpu){
+  while(sched->count && sched->heap[0]->when <= cpu->clock){
+    struct sched_event *ev = sched->heap[0];
+    sched_cancel(sched, ev);
+    ev->fire(cpu, ev);
+  }
+}
+
+/*
+ * Runs the cpu until its clock reaches until, or it finishes. Instructions
+ * are executed back to back up to the next deadline; events are only
+ * looked at once that deadline has been passed. If a debugger is watching
+ * the instructions go through its slow path instead, and we return early
+ * if it stops the program.
+ */
+void run_until(struct cpu_info *cpu, struct scheduler *sched, uint64_t until){
+  while(!cpu->finished && cpu->clock < until){
+    uint64_t deadline = sched_next(sched);
+    if(deadline > until) deadline = until;
+
+    if(cpu->debug){
+      if(debug_run(cpu, deadline)) return;
+    } else{
+      cpu->core->run(cpu, deadline);
+    }
+    sched_dispatch(sched, cpu);
+  }
+}
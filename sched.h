@@ -0,0 +1,51 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+#include "6502.h"
+
+/*
+ * A scheduler for timed events (vblank NMI, mapper IRQs, APU frame IRQ,
+ * timers, ...). Events are kept in a binary min-heap ordered by the cpu
+ * clock value they are due at, so the run loop can execute instructions
+ * straight up to the next deadline instead of polling devices every step.
+ *
+ * Events are owned by the device that schedules them; the scheduler only
+ * stores pointers. Each event remembers its slot in the heap so it can be
+ * cancelled or rescheduled in O(log n).
+ */
+
+#define SCHED_NEVER UINT64_MAX
+
+struct sched_event{
+  // the cpu clock value this event is due at
+  uint64_t when;
+  void (*fire)(struct cpu_info*, struct sched_event*);
+  // free for the owning device to use
+  void *ctx;
+  // position in the heap, or -1 if not scheduled
+  int slot;
+};
+
+struct scheduler{
+  struct sched_event **heap;
+  int count;
+  int capacity;
+};
+
+void init_sched_event(struct sched_event *ev,
+		      void (*fire)(struct cpu_info*, struct sched_event*),
+		      void *ctx);
+
+void init_scheduler(struct scheduler *sched);
+void free_scheduler(struct scheduler *sched);
+
+void sched_add(struct scheduler *sched, struct sched_event *ev, uint64_t when);
+void sched_cancel(struct scheduler *sched, struct sched_event *ev);
+uint64_t sched_next(struct scheduler *sched);
+void sched_dispatch(struct scheduler *sched, struct cpu_info *cpu);
+
+void run_until(struct cpu_info *cpu, struct scheduler *sched, uint64_t until);
+
+#endif
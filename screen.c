@@ -0,0 +1,36 @@
+#include "screen.h"
+#include "blit.h"
+
+const uint32_t screen_palette[16] = {
+  0xff000000, 0xffffffff, 0xff880000, 0xffaaffee,
+  0xffcc44cc, 0xff00cc55, 0xff0000aa, 0xffeeee77,
+  0xffdd8855, 0xff664400, 0xffff7777, 0xff333333,
+  0xff777777, 0xffaaff66, 0xff0088ff, 0xffbbbbbb
+};
+
+/*
+ * Draws the screen into pixels, SCREEN_WIDTH * SCREEN_HEIGHT of them.
+ * Each page of the screen is converted in one go, straight from memory
+ * if it is plain and from a copy if not.
+ */
+void render_screen(struct cpu_info *cpu, uint32_t *pixels){
+  const struct blit *blit = blit_best();
+  for(int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i += 0x100){
+    uint8_t copy[0x100];
+    const uint8_t *page = mem_page(cpu->mem, SCREEN_START + i, 0);
+    if(!page){
+      mem_read_block(cpu->mem, SCREEN_START + i, copy, sizeof(copy));
+      page = copy;
+    }
+    blit->convert(page, pixels + i, 0x100, screen_palette, 0x0f);
+  }
+}
+
+// an FNV-1a hash of a frame's colours, ignoring alpha
+uint64_t frame_hash(const uint32_t *pixels, int count){
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for(int i = 0; i < count; i++){
+    hash = (hash ^ (pixels[i] & 0xFFFFFF)) * 0x100000001B3ULL;
+  }
+  return hash;
+}
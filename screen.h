@@ -0,0 +1,31 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdint.h>
+
+#include "6502.h"
+
+/*
+ * The easy 6502 screen: 32x32 pixels, one byte each at 0x200 - 0x5FF,
+ * the low nibble picking one of 16 colours.
+ */
+#define SCREEN_WIDTH 32
+#define SCREEN_HEIGHT 32
+#define SCREEN_START 0x200
+
+/*
+ * The cpu is run in frame sized batches. The easy 6502 programs (snake in
+ * particular) expect a slow machine, so a frame is only a few hundred
+ * cycles, which keeps them at the speed they used to run at when gui
+ * stepped one cycle at a time.
+ */
+#define FRAME_RATE 60
+#define CYCLES_PER_FRAME 266
+
+// 0xAARRGGBB
+extern const uint32_t screen_palette[16];
+
+void render_screen(struct cpu_info *cpu, uint32_t *pixels);
+uint64_t frame_hash(const uint32_t *pixels, int count);
+
+#endif
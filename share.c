@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "share.h"
+
+#define LOAD(field, order) atomic_load_explicit(&(field), memory_order_##order)
+#define STORE(field, val, order) atomic_store_explicit(&(field), (val), memory_order_##order)
+
+static size_t frame_pixels(struct share_header *header){
+  return (size_t)header->width * header->height;
+}
+
+static int futex(_Atomic uint32_t *word, int op, uint32_t val, const struct timespec *timeout){
+  return syscall(SYS_futex, word, op, val, timeout, NULL, 0);
+}
+
+static int map(struct share *share){
+  share->header = mmap(NULL, share->size, PROT_READ | PROT_WRITE, MAP_SHARED, share->fd, 0);
+  if(share->header == MAP_FAILED){
+    perror("share: mmap");
+    close(share->fd);
+    return -1;
+  }
+  share->frames = (uint32_t *)(share->header + 1);
+  return 0;
+}
+
+
+/*
+ * ============================================
+ * THE EMULATOR'S SIDE
+ * ============================================
+ */
+
+int share_create(struct share *share, int width, int height){
+  share->fd = memfd_create("ricoh-frames", MFD_CLOEXEC);
+  if(share->fd < 0){
+    perror("share: memfd_create");
+    return -1;
+  }
+  share->size = sizeof(struct share_header) +
+    (size_t)SHARE_SLOTS * width * height * sizeof(uint32_t);
+  if(ftruncate(share->fd, share->size) < 0){
+    perror("share: ftruncate");
+    close(share->fd);
+    return -1;
+  }
+  if(map(share) < 0) return -1;
+
+  // the memfd starts zeroed, which is a valid state for everything else
+  struct share_header *header = share->header;
+  header->pid = getpid();
+  header->version = SHARE_VERSION;
+  header->width = width;
+  header->height = height;
+  header->slots = SHARE_SLOTS;
+  atomic_thread_fence(memory_order_release);
+  header->magic = SHARE_MAGIC;
+  return 0;
+}
+
+// the frame buffer to draw the next frame into
+uint32_t *share_frame(struct share *share){
+  uint32_t next = LOAD(share->header->seq, relaxed) + 1;
+  return share->frames + (next % SHARE_SLOTS) * frame_pixels(share->header);
+}
+
+// makes the frame drawn into share_frame() the newest
+void share_publish(struct share *share){
+  struct share_header *header = share->header;
+  STORE(header->seq, LOAD(header->seq, relaxed) + 1, release);
+  if(LOAD(header->waiters, seq_cst)){
+    futex(&header->seq, FUTEX_WAKE, INT32_MAX, NULL);
+  }
+}
+
+// takes the next write a viewer sent, returning 0 if there are none
+int share_input(struct share *share, struct share_input *input){
+  struct share_header *header = share->header;
+  uint32_t tail = LOAD(header->input_tail, relaxed);
+  if(tail == LOAD(header->input_head, acquire)) return 0;
+  *input = header->input[tail % SHARE_INPUTS];
+  STORE(header->input_tail, tail + 1, release);
+  return 1;
+}
+
+void share_destroy(struct share *share){
+  STORE(share->header->closed, 1, release);
+  futex(&share->header->seq, FUTEX_WAKE, INT32_MAX, NULL);
+  share_close(share);
+}
+
+
+/*
+ * ============================================
+ * THE VIEWER'S SIDE
+ * ============================================
+ */
+
+// maps a share from its /proc/<pid>/fd/<fd> path
+int share_open(struct share *share, const char *path){
+  share->fd = open(path, O_RDWR | O_CLOEXEC);
+  if(share->fd < 0){
+    perror(path);
+    return -1;
+  }
+  struct stat st;
+  if(fstat(share->fd, &st) < 0 || st.st_size < sizeof(struct share_header)){
+    fprintf(stderr, "%s: not a frame share\n", path);
+    close(share->fd);
+    return -1;
+  }
+  share->size = st.st_size;
+  if(map(share) < 0) return -1;
+
+  struct share_header *header = share->header;
+  if(header->magic != SHARE_MAGIC || header->version != SHARE_VERSION ||
+     share->size < sizeof(struct share_header) +
+     (size_t)header->slots * frame_pixels(header) * sizeof(uint32_t)){
+    fprintf(stderr, "%s: not a frame share this version can use\n", path);
+    share_close(share);
+    return -1;
+  }
+  return 0;
+}
+
+// the newest frame, or NULL if there hasn't been one yet
+const uint32_t *share_latest(struct share *share, uint32_t *seq){
+  struct share_header *header = share->header;
+  *seq = LOAD(header->seq, acquire);
+  if(*seq == 0) return NULL;
+  return share->frames + (*seq % header->slots) * frame_pixels(header);
+}
+
+/*
+ * Sleeps until there is a frame newer than seen, or for timeout_ms.
+ * Returns -1 once the emulator has gone.
+ */
+int share_wait(struct share *share, uint32_t seen, int timeout_ms){
+  struct share_header *header = share->header;
+  struct timespec timeout;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+  atomic_fetch_add(&header->waiters, 1);
+  if(LOAD(header->seq, seq_cst) == seen && !LOAD(header->closed, acquire)){
+    futex(&header->seq, FUTEX_WAIT, seen, &timeout);
+  }
+  atomic_fetch_sub(&header->waiters, 1);
+  return LOAD(header->closed, acquire) ? -1 : 0;
+}
+
+// asks the emulator to write value to addr, returning -1 if it's behind
+int share_send(struct share *share, uint16_t addr, uint8_t value){
+  struct share_header *header = share->header;
+  uint32_t head = LOAD(header->input_head, relaxed);
+  if(head - LOAD(header->input_tail, acquire) == SHARE_INPUTS) return -1;
+  header->input[head % SHARE_INPUTS].addr = addr;
+  header->input[head % SHARE_INPUTS].value = value;
+  STORE(header->input_head, head + 1, release);
+  return 0;
+}
+
+void share_close(struct share *share){
+  munmap(share->header, share->size);
+  close(share->fd);
+  share->header = NULL;
+  share->frames = NULL;
+}
@@ -0,0 +1,75 @@
+#ifndef SHARE_H
+#define SHARE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * Sharing frames with another process (see view.c). The emulator draws
+ * each frame straight into a ring of frame buffers in a memfd, then bumps
+ * a sequence number, waking any viewer sleeping on it with a futex. A
+ * viewer maps the memfd through /proc/<pid>/fd/<fd> and reads frames out
+ * of it in place; nothing is copied or serialised on either side.
+ *
+ * A reader takes the newest frame, seq % slots. The writer could come
+ * round to that slot again while it is being read, so a reader that
+ * wants a whole frame checks seq hasn't moved on by slots - 1 after.
+ *
+ * It also carries input back the other way: a ring of writes a viewer
+ * wants made to the machine (key presses), which the emulator makes
+ * between frames. There is one writer each way.
+ */
+
+#define SHARE_MAGIC 0x52494646 // "RIFF"
+#define SHARE_VERSION 1
+
+#define SHARE_SLOTS 4
+#define SHARE_INPUTS 64
+
+struct share_input{
+  uint16_t addr;
+  uint8_t value;
+};
+
+struct share_header{
+  uint32_t magic;
+  uint32_t version;
+  int32_t pid;
+  uint32_t width, height;
+  uint32_t slots;
+
+  // frames published so far, also the futex viewers sleep on
+  _Atomic uint32_t seq;
+  // how many viewers are asleep, so the writer only wakes them if needed
+  _Atomic uint32_t waiters;
+  _Atomic uint32_t closed;
+
+  _Atomic uint32_t input_head;
+  _Atomic uint32_t input_tail;
+  struct share_input input[SHARE_INPUTS];
+};
+
+struct share{
+  int fd;
+  size_t size;
+  struct share_header *header;
+  // slots frames of width * height 0xAARRGGBB pixels
+  uint32_t *frames;
+};
+
+// the emulator's side
+int share_create(struct share *share, int width, int height);
+uint32_t *share_frame(struct share *share);
+void share_publish(struct share *share);
+int share_input(struct share *share, struct share_input *input);
+void share_destroy(struct share *share);
+
+// the viewer's side
+int share_open(struct share *share, const char *path);
+const uint32_t *share_latest(struct share *share, uint32_t *seq);
+int share_wait(struct share *share, uint32_t seen, int timeout_ms);
+int share_send(struct share *share, uint16_t addr, uint8_t value);
+void share_close(struct share *share);
+
+#endif
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+/*
+ * ricoh-stat: prints the live metrics of a running emulator, like vmstat.
+ *
+ *    ricoh-stat [-r] [pid] [interval [count]]
+ *
+ * Without a pid the first emulator found in /dev/shm is used. Each line
+ * covers one interval; -r adds a line of memory accesses per region.
+ */
+
+#define LOAD(field) atomic_load_explicit(&(field), memory_order_relaxed)
+
+struct snapshot{
+  uint64_t instructions;
+  uint64_t cycles;
+  uint64_t reads[REGION_COUNT];
+  uint64_t writes[REGION_COUNT];
+  uint64_t frames;
+  uint64_t dropped_frames;
+  uint64_t frame_time[FRAME_TIME_BUCKETS];
+  uint64_t sleeps;
+  uint64_t sleep_overshoot_us;
+};
+
+static void take(struct metrics *m, struct snapshot *s){
+  s->instructions = LOAD(m->instructions);
+  s->cycles = LOAD(m->cycles);
+  for(int r = 0; r < REGION_COUNT; r++){
+    s->reads[r] = LOAD(m->reads[r]);
+    s->writes[r] = LOAD(m->writes[r]);
+  }
+  s->frames = LOAD(m->frames);
+  s->dropped_frames = LOAD(m->dropped_frames);
+  for(int b = 0; b < FRAME_TIME_BUCKETS; b++){
+    s->frame_time[b] = LOAD(m->frame_time[b]);
+  }
+  s->sleeps = LOAD(m->sleeps);
+  s->sleep_overshoot_us = LOAD(m->sleep_overshoot_us);
+}
+
+// the upper bound, in ms, of the bucket holding the given percentile
+static double percentile(uint64_t *buckets, uint64_t total, double p){
+  if(!total) return 0;
+  uint64_t want = total * p;
+  uint64_t seen = 0;
+  for(int b = 0; b < FRAME_TIME_BUCKETS; b++){
+    seen += buckets[b];
+    if(seen > want) return (2ULL << b) / 1000.0;
+  }
+  return (2ULL << (FRAME_TIME_BUCKETS - 1)) / 1000.0;
+}
+
+static int find_emulator(){
+  DIR *dir = opendir("/dev/shm");
+  if(!dir) return 0;
+  struct dirent *entry;
+  int pid = 0;
+  while(!pid && (entry = readdir(dir))){
+    // skip segments left behind by emulators that were killed
+    if(!strncmp(entry->d_name, "ricoh.", 6) && kill(atoi(entry->d_name + 6), 0) == 0){
+      pid = atoi(entry->d_name + 6);
+    }
+  }
+  closedir(dir);
+  return pid;
+}
+
+static void header(int regions){
+  printf("%10s %8s %10s %10s %5s %5s %6s %6s %8s\n",
+	 "instr/s", "MHz", "reads/s", "writes/s", "fps", "drop", "p50ms", "p99ms", "oversleep");
+  if(regions){
+    printf("  per region reads/writes per second:");
+    for(int r = 0; r < REGION_COUNT; r++){
+      printf(" %s", region_strings[r]);
+    }
+    printf("\n");
+  }
+}
+
+int main(int argc, char **argv){
+  int regions = 0;
+  int opt;
+  while((opt = getopt(argc, argv, "r")) != -1){
+    switch(opt){
+    case 'r': regions = 1; break;
+    default:
+      fprintf(stderr, "usage: %s [-r] [pid] [interval [count]]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  int pid = 0;
+  double interval = 1;
+  int count = -1;
+  if(optind < argc && !strchr(argv[optind], '.')){
+    // a lone number is a pid if there is an emulator with it
+    struct metrics *m = metrics_open(atoi(argv[optind]));
+    if(m){
+      metrics_close(m);
+      pid = atoi(argv[optind++]);
+    }
+  }
+  if(optind < argc) interval = atof(argv[optind++]);
+  if(optind < argc) count = atoi(argv[optind++]);
+  if(!pid) pid = find_emulator();
+
+  struct metrics *m = pid ? metrics_open(pid) : NULL;
+  if(!m){
+    fprintf(stderr, "%s: no running emulator found\n", argv[0]);
+    return 1;
+  }
+
+  struct snapshot before, after;
+  take(m, &before);
+  for(int line = 0; count < 0 || line < count; line++){
+    if(line % 20 == 0) header(regions);
+    usleep(interval * 1e6);
+    if(kill(pid, 0) < 0){
+      fprintf(stderr, "%s: emulator %d has exited\n", argv[0], pid);
+      break;
+    }
+    take(m, &after);
+
+    uint64_t reads = 0, writes = 0;
+    for(int r = 0; r < REGION_COUNT; r++){
+      reads += after.reads[r] - before.reads[r];
+      writes += after.writes[r] - before.writes[r];
+    }
+    uint64_t frames = after.frames - before.frames;
+    uint64_t sleeps = after.sleeps - before.sleeps;
+    uint64_t buckets[FRAME_TIME_BUCKETS];
+    for(int b = 0; b < FRAME_TIME_BUCKETS; b++){
+      buckets[b] = after.frame_time[b] - before.frame_time[b];
+    }
+
+    printf("%10.0f %8.3f %10.0f %10.0f %5.0f %5llu %6.2f %6.2f %6.0fus\n",
+	   (after.instructions - before.instructions) / interval,
+	   (after.cycles - before.cycles) / interval / 1e6,
+	   reads / interval, writes / interval,
+	   frames / interval,
+	   (unsigned long long)(after.dropped_frames - before.dropped_frames),
+	   percentile(buckets, frames, 0.5),
+	   percentile(buckets, frames, 0.99),
+	   sleeps ? (double)(after.sleep_overshoot_us - before.sleep_overshoot_us) / sleeps : 0);
+    if(regions){
+      printf("  ");
+      for(int r = 0; r < REGION_COUNT; r++){
+	printf(" %.0f/%.0f", (after.reads[r] - before.reads[r]) / interval,
+	       (after.writes[r] - before.writes[r]) / interval);
+      }
+      printf("\n");
+    }
+    fflush(stdout);
+    before = after;
+  }
+
+  metrics_close(m);
+  return 0;
+}
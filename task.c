@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "task.h"
+#include "6502_ops.h"
+
+int task_runner_init(struct task_runner *runner, uint64_t slice, size_t ram_len){
+  memset(runner, 0, sizeof(struct task_runner));
+  runner->slice = slice;
+  runner->ram_len = ram_len;
+  if(ram_len){
+    runner->scratch = malloc(ram_len);
+    if(!runner->scratch) return -1;
+  }
+  return 0;
+}
+
+void task_runner_free(struct task_runner *runner){
+  free(runner->scratch);
+  runner->scratch = NULL;
+}
+
+void task_init(struct task *task, struct cpu_info *cpu, struct scheduler *sched, int priority){
+  memset(task, 0, sizeof(struct task));
+  task->cpu = cpu;
+  task->sched = sched;
+  task->priority = priority;
+  task->until = SCHED_NEVER;
+  task->state = TASK_DETACHED;
+}
+
+void task_add_input(struct task *task, uint16_t addr){
+  if(task->input_count < TASK_INPUTS) task->inputs[task->input_count++] = addr;
+}
+
+
+/*
+ * The ready tasks are a ring, so the one after the last run is always
+ * runner->ready; the parked ones are a plain list.
+ */
+static void ready_link(struct task_runner *runner, struct task *task){
+  task->state = TASK_READY;
+  if(!runner->ready){
+    task->prev = task->next = task;
+    runner->ready = task;
+  } else{
+    // at the back, the turn before runner->ready
+    task->next = runner->ready;
+    task->prev = runner->ready->prev;
+    task->prev->next = task;
+    runner->ready->prev = task;
+  }
+  runner->ready_count++;
+}
+
+static void ready_unlink(struct task_runner *runner, struct task *task){
+  if(task->next == task){
+    runner->ready = NULL;
+  } else{
+    task->prev->next = task->next;
+    task->next->prev = task->prev;
+    if(runner->ready == task) runner->ready = task->next;
+  }
+  runner->ready_count--;
+}
+
+static void parked_link(struct task_runner *runner, struct task *task){
+  task->state = TASK_PARKED;
+  task->prev = NULL;
+  task->next = runner->parked;
+  if(runner->parked) runner->parked->prev = task;
+  runner->parked = task;
+  runner->parked_count++;
+}
+
+static void parked_unlink(struct task_runner *runner, struct task *task){
+  if(task->prev) task->prev->next = task->next;
+  else runner->parked = task->next;
+  if(task->next) task->next->prev = task->prev;
+  runner->parked_count--;
+}
+
+void task_add(struct task_runner *runner, struct task *task){
+  ready_link(runner, task);
+}
+
+void task_remove(struct task_runner *runner, struct task *task){
+  if(task->state == TASK_READY) ready_unlink(runner, task);
+  else if(task->state == TASK_PARKED) parked_unlink(runner, task);
+  task->state = TASK_DETACHED;
+  free(task->spin);
+  task->spin = NULL;
+}
+
+void task_wake(struct task_runner *runner, struct task *task){
+  if(task->state != TASK_PARKED) return;
+  parked_unlink(runner, task);
+  ready_link(runner, task);
+  task->spun = 0;
+  task->hashed = 0;
+}
+
+void task_input(struct task_runner *runner, struct task *task, uint16_t addr, uint8_t value){
+  int changed = read8(task->cpu->mem, addr) != value;
+  write8(task->cpu->mem, addr, value);
+  if(changed) task_wake(runner, task);
+}
+
+
+static void save_regs(struct cpu_info *cpu, uint8_t *regs){
+  regs[0] = cpu->a;
+  regs[1] = cpu->x;
+  regs[2] = cpu->y;
+  regs[3] = cpu->s;
+  regs[4] = cpu->pc;
+  regs[5] = cpu->pc >> 8;
+  regs[6] = STATUS_BYTE(cpu, 0);
+}
+
+// instructions a task is stepped on looking for where its last turn ended
+#define SPIN_STEPS 32
+
+// a hash of memory, eight bytes at a time in four independent lanes
+static uint64_t ram_hash(const uint8_t *ram, size_t len){
+  uint64_t lanes[4] = { 1, 2, 3, 4 };
+  size_t i = 0;
+  for(; i + 32 <= len; i += 32){
+    for(int l = 0; l < 4; l++){
+      uint64_t word;
+      memcpy(&word, ram + i + l * 8, 8);
+      lanes[l] = (lanes[l] ^ word) * 0x100000001B3ULL;
+    }
+  }
+  for(; i < len; i++){
+    lanes[0] = (lanes[0] ^ ram[i]) * 0x100000001B3ULL;
+  }
+  return lanes[0] ^ lanes[1] * 3 ^ lanes[2] * 5 ^ lanes[3] * 7;
+}
+
+/*
+ * Whether the task comes back round, within SPIN_STEPS instructions, to
+ * where its last turn ended, with memory as it was apart from its inputs.
+ * Where it is now is kept to compare the next turn's end with. Memory is
+ * only looked at once the registers match, and the cycles spent stepping
+ * are taken off the task's next turn.
+ */
+static int spinning(struct task_runner *runner, struct task *task){
+  struct cpu_info *cpu = task->cpu;
+  uint8_t regs[7];
+  if(task->spun){
+    uint64_t began = cpu->clock;
+    for(int i = 0; i < SPIN_STEPS && !cpu->finished; i++){
+      save_regs(cpu, regs);
+      if(!memcmp(regs, task->spin_regs, sizeof(regs))) break;
+      execute_instruction(cpu);
+    }
+    task->stepped = cpu->clock - began;
+  }
+  if(cpu->finished) return 0;
+  save_regs(cpu, regs);
+
+  if(!task->spun || memcmp(regs, task->spin_regs, sizeof(regs))){
+    // not back where it was, so there's no need to look at memory yet
+    free(task->spin);
+    task->spin = NULL;
+    task->spun = 1;
+    task->hashed = 0;
+    memcpy(task->spin_regs, regs, sizeof(regs));
+    return 0;
+  }
+
+  uint8_t *now = runner->scratch;
+  mem_read_block(cpu->mem, 0, now, runner->ram_len);
+  for(int i = 0; i < task->input_count; i++){
+    if(task->inputs[i] < runner->ram_len) now[task->inputs[i]] = 0;
+  }
+  uint64_t hash = ram_hash(now, runner->ram_len);
+  int same = task->hashed && hash == task->spin_hash;
+  if(same && task->spin && !memcmp(task->spin, now, runner->ram_len)){
+    free(task->spin);
+    task->spin = NULL;
+    return 1;
+  }
+
+  if(same){
+    if(!task->spin) task->spin = malloc(runner->ram_len);
+    if(task->spin) memcpy(task->spin, now, runner->ram_len);
+  } else{
+    free(task->spin);
+    task->spin = NULL;
+  }
+  task->hashed = 1;
+  task->spin_hash = hash;
+  return 0;
+}
+
+// gives the task at the front its turn, and moves the ring on
+static void turn(struct task_runner *runner){
+  struct task *task = runner->ready;
+  struct cpu_info *cpu = task->cpu;
+  runner->ready = task->next;
+
+  if(task->resume) task->resume(task);
+  uint64_t slice = runner->slice * task->priority;
+  slice -= task->stepped < slice ? task->stepped : slice;
+  task->stepped = 0;
+  uint64_t until = cpu->clock + slice;
+  if(until > task->until) until = task->until;
+  run_until(cpu, task->sched, until);
+
+  int parks = !cpu->finished && cpu->clock < task->until && runner->ram_len &&
+    sched_next(task->sched) == SCHED_NEVER && spinning(runner, task);
+  if(parks){
+    ready_unlink(runner, task);
+    parked_link(runner, task);
+  } else if(cpu->finished || cpu->clock >= task->until){
+    ready_unlink(runner, task);
+    task->state = TASK_DONE;
+  }
+}
+
+uint64_t task_run(struct task_runner *runner, uint64_t turns){
+  uint64_t given = 0;
+  for(; given < turns && runner->ready; given++){
+    turn(runner);
+  }
+  return given;
+}
@@ -0,0 +1,95 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "6502.h"
+#include "sched.h"
+
+/*
+ * Cooperative time slicing of many machines on one thread.
+ *
+ * Each machine is a task: a resumable run of its cpu, which the runner
+ * takes turns through round-robin. A turn is a budget of cycles, the
+ * runner's slice times the task's priority, so a task of priority 2 gets
+ * twice the cycles of one of priority 1 each time round.
+ *
+ * A task that comes back round to the state it ended its last turn in
+ * (the registers, and the first ram_len bytes of memory) is spinning in a
+ * loop that nothing but outside input can get it out of, so it is parked,
+ * and isn't run again until task_input() changes one of its bytes or it
+ * is woken. A turn may end anywhere in the loop, so the task is stepped
+ * on a few instructions to where the last one ended before comparing;
+ * those cycles are taken off its next turn. Memory is only looked at once
+ * the registers match, and is compared by a hash, and only once that
+ * matches is a copy taken, to be sure of it at the end of the next turn.
+ * Bytes the host writes (the inputs, e.g. keys and random numbers) are
+ * left out of the comparison. A parked machine's clock stands still, and
+ * a task with events scheduled is never parked.
+ */
+
+#define TASK_INPUTS 4
+
+// a task is detached until it is added to a runner, and after it is removed
+enum task_state{ TASK_DETACHED, TASK_READY, TASK_PARKED, TASK_DONE };
+
+struct task{
+  struct cpu_info *cpu;
+  struct scheduler *sched;
+  // the turn is this many slices
+  int priority;
+  // the task is done once its clock reaches this (SCHED_NEVER by default)
+  uint64_t until;
+  // optional, called before each turn, e.g. to give the machine new input
+  void (*resume)(struct task *);
+  void *ctx;
+  // addresses the host writes to (see above)
+  uint16_t inputs[TASK_INPUTS];
+  int input_count;
+
+  enum task_state state;
+  // the ring of ready tasks, or the list of parked ones
+  struct task *prev, *next;
+  // the registers the last turn ended with, if spun, and the hash of
+  // memory, if hashed (only taken when the registers came round again)
+  int spun, hashed;
+  uint8_t spin_regs[7];
+  uint64_t spin_hash;
+  // cycles stepped on past the end of the last turn, see above
+  uint64_t stepped;
+  // a copy of memory, while the task looks to be spinning
+  uint8_t *spin;
+};
+
+struct task_runner{
+  // the ready task to run next, in a ring
+  struct task *ready;
+  struct task *parked;
+  int ready_count, parked_count;
+  uint64_t slice;
+  // memory compared to find spinning tasks, from address 0; 0 never parks
+  size_t ram_len;
+  uint8_t *scratch;
+};
+
+int task_runner_init(struct task_runner *runner, uint64_t slice, size_t ram_len);
+void task_runner_free(struct task_runner *runner);
+
+void task_init(struct task *task, struct cpu_info *cpu, struct scheduler *sched, int priority);
+// addr is written by the host, see above
+void task_add_input(struct task *task, uint16_t addr);
+void task_add(struct task_runner *runner, struct task *task);
+void task_remove(struct task_runner *runner, struct task *task);
+
+// writes value to addr for the host, waking the task if it was parked and it changes
+void task_input(struct task_runner *runner, struct task *task, uint16_t addr, uint8_t value);
+void task_wake(struct task_runner *runner, struct task *task);
+
+/*
+ * Gives up to turns turns, stopping early once no task is ready. Returns
+ * the turns given.
+ */
+uint64_t task_run(struct task_runner *runner, uint64_t turns);
+
+#endif
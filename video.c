@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "video.h"
+#include "screen.h"
+
+// how much output is gathered before it's written
+#define VIDEO_BLOCK (1 << 20)
+
+static const char *format_names[] = {
+  [VIDEO_RAW] = "raw",
+  [VIDEO_PPM] = "ppm",
+  [VIDEO_Y4M] = "y4m",
+  [VIDEO_HASH] = "hash",
+};
+
+int video_format_by_name(const char *name){
+  for(int i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++){
+    if(!strcmp(name, format_names[i])) return i;
+  }
+  return -1;
+}
+
+static int flush(struct video *video){
+  size_t done = 0;
+  while(done < video->len){
+    ssize_t n = write(video->fd, video->buf + done, video->len - done);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      perror("video: write");
+      return -1;
+    }
+    done += n;
+  }
+  video->len = 0;
+  return 0;
+}
+
+// room for len more bytes in the buffer
+static uint8_t *reserve(struct video *video, size_t len){
+  if(video->len + len > video->cap && flush(video) < 0) return NULL;
+  if(len > video->cap){
+    free(video->buf);
+    video->cap = len;
+    video->buf = malloc(len);
+  }
+  uint8_t *at = video->buf + video->len;
+  video->len += len;
+  return at;
+}
+
+static int put_string(struct video *video, const char *string){
+  size_t len = strlen(string);
+  uint8_t *at = reserve(video, len);
+  if(!at) return -1;
+  memcpy(at, string, len);
+  return 0;
+}
+
+/*
+ * Opens path ("-" for stdout) for a stream of width x height frames, fps
+ * of them a second.
+ */
+int video_open(struct video *video, const char *path, enum video_format format,
+	       int width, int height, int fps){
+  memset(video, 0, sizeof(struct video));
+  if(!strcmp(path, "-")){
+    video->fd = STDOUT_FILENO;
+  } else{
+    video->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(video->fd < 0){
+      perror(path);
+      return -1;
+    }
+  }
+  video->format = format;
+  video->width = width;
+  video->height = height;
+  video->fps = fps;
+  video->hash = 0xCBF29CE484222325ULL;
+  video->cap = VIDEO_BLOCK;
+  video->buf = malloc(video->cap);
+
+  if(format == VIDEO_Y4M){
+    char header[64];
+    snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+	     width, height, fps);
+    return put_string(video, header);
+  }
+  return 0;
+}
+
+static void to_rgb(uint8_t *out, const uint32_t *pixels, int count){
+  for(int i = 0; i < count; i++){
+    out[i * 3] = pixels[i] >> 16;
+    out[i * 3 + 1] = pixels[i] >> 8;
+    out[i * 3 + 2] = pixels[i];
+  }
+}
+
+// BT.601, studio range, full resolution chroma
+static void to_yuv(uint8_t *out, const uint32_t *pixels, int count){
+  uint8_t *y = out, *u = out + count, *v = out + 2 * count;
+  for(int i = 0; i < count; i++){
+    int r = (pixels[i] >> 16) & 0xFF;
+    int g = (pixels[i] >> 8) & 0xFF;
+    int b = pixels[i] & 0xFF;
+    y[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    u[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    v[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+  }
+}
+
+int video_frame(struct video *video, const uint32_t *pixels){
+  int count = video->width * video->height;
+  uint64_t hash = frame_hash(pixels, count);
+  video->hash = (video->hash ^ hash) * 0x100000001B3ULL;
+
+  char header[64];
+  uint8_t *at;
+  switch(video->format){
+  case VIDEO_RAW:
+    if(!(at = reserve(video, count * 3))) return -1;
+    to_rgb(at, pixels, count);
+    break;
+  case VIDEO_PPM:
+    snprintf(header, sizeof(header), "P6\n%d %d\n255\n", video->width, video->height);
+    if(put_string(video, header) < 0 || !(at = reserve(video, count * 3))) return -1;
+    to_rgb(at, pixels, count);
+    break;
+  case VIDEO_Y4M:
+    if(put_string(video, "FRAME\n") < 0 || !(at = reserve(video, count * 3))) return -1;
+    to_yuv(at, pixels, count);
+    break;
+  case VIDEO_HASH:
+    snprintf(header, sizeof(header), "%llu %016llx\n",
+	     (unsigned long long)video->frames, (unsigned long long)hash);
+    if(put_string(video, header) < 0) return -1;
+    break;
+  }
+  video->frames++;
+  return 0;
+}
+
+int video_close(struct video *video){
+  int status = flush(video);
+  if(video->fd != STDOUT_FILENO && close(video->fd) < 0){
+    perror("video: close");
+    status = -1;
+  }
+  free(video->buf);
+  video->buf = NULL;
+  return status;
+}
@@ -0,0 +1,42 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * A headless video sink: frames (0xAARRGGBB pixels) go to a file or pipe
+ * as raw RGB24, a stream of binary PPMs, or a YUV4MPEG2 (4:4:4) stream;
+ * or, for regression checks, as just a line per frame with its hash.
+ * Output is gathered into large blocks before being written.
+ */
+
+enum video_format{
+  VIDEO_RAW,
+  VIDEO_PPM,
+  VIDEO_Y4M,
+  VIDEO_HASH,
+};
+
+struct video{
+  int fd;
+  enum video_format format;
+  int width, height;
+  int fps;
+
+  uint8_t *buf;
+  size_t len;
+  size_t cap;
+
+  uint64_t frames;
+  // the hash of every frame so far
+  uint64_t hash;
+};
+
+int video_format_by_name(const char *name);
+int video_open(struct video *video, const char *path, enum video_format format,
+	       int width, int height, int fps);
+int video_frame(struct video *video, const uint32_t *pixels);
+int video_close(struct video *video);
+
+#endif
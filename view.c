@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "screen.h"
+#include "share.h"
+#include "blit.h"
+
+/*
+ * Shows the frames ricoh-headless instances share, any number of them
+ * tiled in one window, reading each frame straight out of the shared
+ * memory. Key presses go to the instance last clicked on (the first, to
+ * start with); q quits.
+ */
+
+#define TILE 256
+
+static Display *dis;
+static Window win;
+static GC gc;
+
+struct instance{
+  const char *path;
+  struct share share;
+  uint32_t shown;
+  int gone;
+};
+
+// an image for a tile to be scaled into, remade when the tiles change size
+static XImage *tile_image(int width, int height){
+  static XImage *image;
+  if(width < 1 || height < 1) return NULL;
+  if(!image || image->width != width || image->height != height){
+    if(image) XDestroyImage(image);
+    char *data = malloc(sizeof(uint32_t) * width * height);
+    int screen = DefaultScreen(dis);
+    image = XCreateImage(dis, DefaultVisual(dis, screen), DefaultDepth(dis, screen),
+			 ZPixmap, 0, data, width, height, 32, 0);
+    if(!image) free(data);
+  }
+  return image;
+}
+
+static void draw(struct instance *in, int tile, int cols, int size){
+  uint32_t seq;
+  const uint32_t *pixels = share_latest(&in->share, &seq);
+  if(!pixels) return;
+
+  struct share_header *header = in->share.header;
+  int w_scale = size / header->width;
+  int h_scale = size / header->height;
+  int x0 = (tile % cols) * size;
+  int y0 = (tile / cols) * size;
+  int width = header->width * w_scale;
+  int height = header->height * h_scale;
+  XImage *image = tile_image(width, height);
+  if(!image) return;
+  blit_scale(blit_best(), pixels, header->width, header->height, (uint32_t *)image->data,
+	     image->bytes_per_line / sizeof(uint32_t), w_scale, h_scale);
+  XPutImage(dis, win, gc, image, 0, 0, x0, y0, width, height);
+
+  // it was written over while we drew it, so draw it again next time
+  if(atomic_load(&header->seq) - seq >= header->slots - 1){
+    in->shown = seq - 1;
+  } else{
+    in->shown = seq;
+  }
+}
+
+int main(int argc, char **argv){
+  if(argc < 2){
+    fprintf(stderr, "usage: %s /proc/<pid>/fd/<fd>...\n", argv[0]);
+    return 1;
+  }
+  int count = argc - 1;
+  struct instance *instances = calloc(count, sizeof(struct instance));
+  for(int i = 0; i < count; i++){
+    instances[i].path = argv[i + 1];
+    if(share_open(&instances[i].share, argv[i + 1]) < 0) return 1;
+  }
+  int cols = ceil(sqrt(count));
+  int rows = (count + cols - 1) / cols;
+
+  dis = XOpenDisplay(NULL);
+  if(!dis){
+    fprintf(stderr, "can't open the display\n");
+    return 1;
+  }
+  int screen = DefaultScreen(dis);
+  win = XCreateSimpleWindow(dis, DefaultRootWindow(dis), 0, 0, cols * TILE, rows * TILE, 0,
+			    WhitePixel(dis, screen), BlackPixel(dis, screen));
+  XSetStandardProperties(dis, win, "6502 view", "6502 view", None, NULL, 0, NULL);
+  XSelectInput(dis, win, ExposureMask | ButtonPressMask | KeyPressMask);
+  gc = XCreateGC(dis, win, 0, 0);
+  XMapRaised(dis, win);
+
+  int selected = 0;
+  int alive = count;
+  int quit = 0;
+  while(!quit && alive > 0){
+    XWindowAttributes wa;
+    XGetWindowAttributes(dis, win, &wa);
+    int size = (wa.width / cols < wa.height / rows) ? wa.width / cols : wa.height / rows;
+    if(size < 1) size = 1;
+
+    XEvent event;
+    KeySym key;
+    char text[16];
+    while(XPending(dis)){
+      XNextEvent(dis, &event);
+      if(event.type == Expose && event.xexpose.count == 0){
+	for(int i = 0; i < count; i++) instances[i].shown = 0;
+      } else if(event.type == ButtonPress){
+	int tile = (event.xbutton.y / size) * cols + event.xbutton.x / size;
+	if(tile < count) selected = tile;
+      } else if(event.type == KeyPress &&
+		XLookupString(&event.xkey, text, sizeof(text), &key, 0) == 1){
+	if(text[0] == 'q'){
+	  quit = 1;
+	} else if(strchr("wasd", text[0]) && !instances[selected].gone){
+	  share_send(&instances[selected].share, 0xff, text[0]);
+	}
+      }
+    }
+
+    for(int i = 0; i < count; i++){
+      struct instance *in = &instances[i];
+      if(in->gone) continue;
+      if(atomic_load(&in->share.header->closed)){
+	in->gone = 1;
+	alive--;
+	continue;
+      }
+      if(atomic_load(&in->share.header->seq) != in->shown){
+	draw(in, i, cols, size);
+      }
+    }
+    XFlush(dis);
+
+    // sleep until the first live instance has a new frame, or a frame's time
+    struct instance *first = NULL;
+    for(int i = 0; i < count && !first; i++){
+      if(!instances[i].gone) first = &instances[i];
+    }
+    if(first){
+      share_wait(&first->share, first->shown, 1000 / FRAME_RATE);
+    }
+  }
+
+  for(int i = 0; i < count; i++){
+    share_close(&instances[i].share);
+  }
+  XFreeGC(dis, gc);
+  XDestroyWindow(dis, win);
+  XCloseDisplay(dis);
+  return 0;
+}